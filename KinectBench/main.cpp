@@ -0,0 +1,1106 @@
+// Microbenchmarks for the matcher, the stability detector, library I/O, the recording codec, frame sharing and streaming.
+// Everything runs on generated poses, no sensor and no window, so it builds with KSIM and KT_HEADLESS on any OS.
+// Results go to kinectbench.csv (or --out) as csv, one line per benchmark, the console only shows progress:
+//   bench,poses,mask,joints,iterations,median_ns,min_ns,ops_per_s
+// Lines starting with # describe the run. Compare two runs by joining on (bench, poses, mask).
+
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// my classes
+#include "MySkeleton.h"
+#include "MyPoseLibrary.h"
+#include "MyPoseIndex.h"
+#include "MyStabilityDetector.h"
+#include "MySyntheticSource.h"
+#include "MyFrameCodec.h"
+#include "MyRecorder.h"
+#include "MySharedRing.h"
+#include "MySharedReader.h"
+#include "MyNetPublisher.h"
+#include "MyNetReceiver.h"
+#include "MyMemorySink.h"
+
+static const int REPEATS = 5;				// batches timed per benchmark, the median is reported
+static const size_t QUERIES = 256;			// skeletons cycled through by the matching benchmarks
+static const size_t SEQUENCE = 1024;		// frames cycled through by the stability benchmarks
+static const float THRESH = 0.5f;
+static const uint16_t NET_PORT = 9101;		// loopback port of the streaming benchmark
+static const size_t SIZES[] = { 10, 100, 1000, 10000, 100000 };
+
+struct options {
+	bool quick;				// shorter batches, for a smoke test
+	size_t maxPoses;
+	const char* out;
+	const char* dir;		// where the library files are written
+	const char* filter;		// only benchmarks whose name contains this
+};
+
+struct mask {
+	const char* name;
+	std::array<bool, JOINTS> joints;
+};
+
+static FILE* output = nullptr;
+static options settings = { false, 100000, "kinectbench.csv", ".", nullptr };
+static volatile int sink = 0;		// keeps results alive so nothing is optimized away
+static int failures = 0;			// checks that failed, the exit code says whether there were any
+
+/*************************************************************************************************/
+/*                                         Measuring                                             */
+/*************************************************************************************************/
+static int Enabled(const std::array<bool, JOINTS>& joints)
+{
+	int count = 0;
+	for (int j = 0; j < JOINTS; ++j)
+		count += joints[j] ? 1 : 0;
+	return count;
+}
+
+// correctness checks ride along with the benchmarks, a failure is reported on stderr and in the results
+static void Check(bool ok, const char* what)
+{
+	if (ok)
+		return;
+	++failures;
+	fprintf(stderr, "FAILED: %s\n", what);
+	fprintf(output, "# failed %s\n", what);
+}
+
+static bool Selected(const char* name)
+{
+	return !settings.filter || strstr(name, settings.filter);
+}
+
+// runs fn(iterations) in batches long enough to time, then reports the median and fastest batch per operation
+template <typename F>
+static void Measure(const char* name, size_t poses, const mask& joints, F fn)
+{
+	const uint64_t target = settings.quick ? 2000000 : 50000000;	// nanoseconds per batch
+
+	// warm up and find a batch size, at least one call
+	uint64_t iterations = 1;
+	while (true)
+	{
+		const uint64_t begin = Now();
+		fn(iterations);
+		const uint64_t elapsed = Now() - begin;
+		if (elapsed >= target / 4 || iterations >= ((uint64_t)1 << 32))
+		{
+			if (elapsed < target && elapsed > 0)
+				iterations = std::max<uint64_t>(1, (uint64_t)((double)iterations * target / elapsed));
+			break;
+		}
+		iterations *= elapsed < target / 64 ? 16 : 4;
+	}
+
+	std::array<double, REPEATS> perOp;
+	for (int r = 0; r < REPEATS; ++r)
+	{
+		const uint64_t begin = Now();
+		fn(iterations);
+		perOp[r] = (double)(Now() - begin) / iterations;
+	}
+	std::sort(perOp.begin(), perOp.end());
+
+	const double median = perOp[REPEATS / 2];
+	fprintf(output, "%s,%zu,%s,%d,%llu,%.1f,%.1f,%.0f\n", name, poses, joints.name, Enabled(joints.joints),
+		(unsigned long long)iterations, median, perOp[0], median > 0.0 ? 1e9 / median : 0.0);
+	fflush(output);
+	fprintf(stderr, "%-16s %7zu poses  %-8s %12.1f ns/op\n", name, poses, joints.name, median);
+}
+
+/*************************************************************************************************/
+/*                                         Test data                                             */
+/*************************************************************************************************/
+static std::vector<mask> Masks()
+{
+	// sensor neutral: every joint, the first half, every fourth, a single one
+	std::vector<mask> masks(4);
+	masks[0].name = "all";
+	masks[1].name = "half";
+	masks[2].name = "quarter";
+	masks[3].name = "single";
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		masks[0].joints[j] = true;
+		masks[1].joints[j] = j < JOINTS / 2;
+		masks[2].joints[j] = j % 4 == 0;
+		masks[3].joints[j] = j == 0;
+	}
+	return masks;
+}
+
+static void RandomLibrary(MyPoseLibrary& library, size_t poses, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	float orientations[JOINTS][4];
+	bool tracked[JOINTS];
+	for (int j = 0; j < JOINTS; ++j)
+		tracked[j] = true;
+
+	library.Clear();
+	for (size_t p = 0; p < poses; ++p)
+	{
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			// uniform on the unit sphere, w >= 0 like the sensor reports
+			float q[4], length = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = normal(random);
+				length += q[c] * q[c];
+			}
+			length = std::sqrt(length);
+			const float sign = q[0] < 0.0f ? -1.0f : 1.0f;
+			for (int c = 0; c < 4; ++c)
+				orientations[j][c] = sign * q[c] / length;
+		}
+		library.Append(orientations, tracked, 'A' + (int)(p % 26));
+	}
+}
+
+// frames of one body from the synthetic source, near the library poses when one is given
+static std::vector<skeleton_data> Generate(size_t count, const MyPoseLibrary* library, float holdMs, float transitionMs, uint32_t seed)
+{
+	MySyntheticSource::settings config = MySyntheticSource::Defaults();
+	config.realtime = false;
+	config.hz = 120.0f;
+	config.holdMs = holdMs;
+	config.transitionMs = transitionMs;
+	config.seed = seed;
+
+	MySyntheticSource source(config, library && library->size() ? library : nullptr);
+	source.Open();
+
+	std::vector<skeleton_data> skeletons;
+	skeletons.reserve(count);
+	frame_data frame;
+	while (skeletons.size() < count)
+	{
+		if (source.Acquire(frame, 0) == SOURCE_FRAME && frame.count > 0)
+			skeletons.push_back(frame.bodies[0].skeleton);
+	}
+	source.Close();
+	return skeletons;
+}
+
+// whole frames with every body slot filled, what the codec, the shared ring and the network carry
+static std::vector<frame_data> Frames(size_t count, uint32_t seed)
+{
+	MySyntheticSource::settings config = MySyntheticSource::Defaults();
+	config.realtime = false;
+	config.bodies = MAX_BODIES;
+	config.seed = seed;
+
+	MySyntheticSource source(config);
+	source.Open();
+
+	std::vector<frame_data> frames(count);
+	for (frame_data& frame : frames)
+	{
+		while (source.Acquire(frame, 0) != SOURCE_FRAME)
+			;
+	}
+	source.Close();
+	return frames;
+}
+
+/*************************************************************************************************/
+/*                                         Benchmarks                                            */
+/*************************************************************************************************/
+static void BenchCompare(const std::vector<mask>& masks)
+{
+	// held pose against a jittered copy of itself checks every enabled joint, two random poses stop early
+	MyPoseLibrary library;
+	RandomLibrary(library, QUERIES, 11);
+	const std::vector<skeleton_data> held = Generate(QUERIES + 1, nullptr, 1e9f, 0.0f, 12);
+	const std::vector<skeleton_data> moving = Generate(QUERIES + 1, &library, 0.0f, 0.001f, 13);
+
+	MySkeleton* skeleton = new MySkeleton();
+	for (const mask& joints : masks)
+	{
+		skeleton->setCheckList(joints.joints);
+
+		if (Selected("compare_near"))
+		{
+			Measure("compare_near", 1, joints, [&](uint64_t iterations) {
+				int failed = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					const size_t k = i % QUERIES;
+					failed += skeleton->CompareJoint(held[k], held[k + 1]);
+				}
+				sink = failed;
+			});
+		}
+		if (Selected("compare_far"))
+		{
+			Measure("compare_far", 1, joints, [&](uint64_t iterations) {
+				int failed = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					const size_t k = i % QUERIES;
+					failed += skeleton->CompareJoint(moving[k], moving[k + 1]);
+				}
+				sink = failed;
+			});
+		}
+	}
+	delete skeleton;
+}
+
+// every body of a synthetic source starts on one of the library poses, the last one as often as the others
+static void BenchSynthetic()
+{
+	if (!Selected("synthetic"))
+		return;
+
+	MyPoseLibrary library;
+	RandomLibrary(library, 2, 14);
+	int starts[2] = { 0, 0 };
+	for (uint32_t seed = 0; seed < 8; ++seed)
+	{
+		MySyntheticSource::settings config = MySyntheticSource::Defaults();
+		config.realtime = false;
+		config.bodies = MAX_BODIES;
+		config.jitter = 0.0f;
+		config.holdMs = 1e9f;
+		config.seed = 90 + seed;
+		MySyntheticSource source(config, &library);
+		source.Open();
+		frame_data frame;
+		while (source.Acquire(frame, 0) != SOURCE_FRAME)
+			;
+		source.Close();
+
+		// the pose a body holds is the one its joints are closest to
+		for (int b = 0; b < frame.count; ++b)
+		{
+			float closeness[2] = { 0.0f, 0.0f };
+			for (int j = 0; j < JOINTS; ++j)
+			{
+				float q[4], p[4];
+				GetJointOrientation(frame.bodies[b].skeleton, j, q);
+				for (size_t pose = 0; pose < 2; ++pose)
+				{
+					library.getOrientation(pose, j, p);
+					closeness[pose] += std::fabs(q[0] * p[0] + q[1] * p[1] + q[2] * p[2] + q[3] * p[3]);
+				}
+			}
+			++starts[closeness[1] > closeness[0] ? 1 : 0];
+		}
+	}
+	fprintf(output, "# synthetic first=%d last=%d\n", starts[0], starts[1]);
+	Check(starts[0] > 0 && starts[1] > 0, "synthetic: bodies start on every library pose, the last one too");
+}
+
+// the code written against the sensor traits, run on the five joint test sensor: a stick figure whose bones
+// are known, so the comparison, the bone lengths, the ghosts and the quantizer can be checked by hand
+static void BenchSensors()
+{
+	typedef sensor_traits<test_sensor> traits;
+	if (!Selected("sensor"))
+		return;
+
+	// root at 2 m, spine and head straight up, the arms turned a quarter left and right around z
+	const float s = std::sqrt(0.5f);
+	const float orientations[traits::JOINTS][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 0.0f }, { s, 0.0f, 0.0f, s }, { s, 0.0f, 0.0f, -s }
+	};
+	const float expected[traits::JOINTS][3] = {
+		{ 0.0f, 0.0f, 2.0f }, { 0.0f, 0.5f, 2.0f }, { 0.0f, 0.7f, 2.0f }, { -0.3f, 0.5f, 2.0f }, { 0.3f, 0.5f, 2.0f }
+	};
+	traits::skeleton figure;
+	for (int j = 0; j < traits::JOINTS; ++j)
+	{
+		traits::SetTracked(figure, j, true);
+		traits::SetOrientation(figure, j, orientations[j]);
+		traits::SetPosition(figure, j, expected[j]);
+	}
+
+	float lengths[traits::JOINTS] = {};
+	BoneLengths<test_sensor>(figure, lengths);
+	Check(std::fabs(lengths[1] - 0.5f) < 1e-5f && std::fabs(lengths[2] - 0.2f) < 1e-5f &&
+		std::fabs(lengths[3] - 0.3f) < 1e-5f && std::fabs(lengths[4] - 0.3f) < 1e-5f, "test sensor bone lengths");
+
+	float positions[traits::JOINTS][3];
+	GhostPositions<test_sensor>(orientations, expected[traits::ROOT], lengths, positions);
+	float ghost = 0.0f;
+	for (int j = 0; j < traits::JOINTS; ++j)
+	{
+		for (int c = 0; c < 3; ++c)
+			ghost = std::max(ghost, std::fabs(positions[j][c] - expected[j][c]));
+	}
+	Check(ghost < 1e-5f, "test sensor ghost rebuilds the figure");
+
+	// the first joint in order that turned or was lost fails, unchecked joints are skipped
+	const int order[traits::JOINTS] = { 4, 3, 2, 1, 0 };
+	bool checkList[traits::JOINTS] = { true, true, true, true, true };
+	traits::skeleton other = figure;
+	const float turned[4] = { s, s, 0.0f, 0.0f };
+	traits::SetOrientation(other, 1, turned);
+	traits::SetTracked(other, 2, false);
+	int evaluated = 0;
+	Check(CompareJoints<test_sensor>(figure, figure, order, checkList, 0.1f, evaluated) == -1 && evaluated == traits::JOINTS,
+		"test sensor compares equal to itself");
+	Check(CompareJoints<test_sensor>(figure, other, order, checkList, 0.1f, evaluated) == 2 && evaluated == 3,
+		"test sensor fails on the lost joint");
+	checkList[2] = false;
+	Check(CompareJoints<test_sensor>(figure, other, order, checkList, 0.1f, evaluated) == 1 && evaluated == 3,
+		"test sensor fails on the turned joint");
+	checkList[1] = false;
+	Check(CompareJoints<test_sensor>(figure, other, order, checkList, 0.1f, evaluated) == -1 && evaluated == 3,
+		"test sensor skips unchecked joints");
+
+	// the codec rows, one per joint, back within a quantization step
+	int32_t values[traits::JOINTS][MyFrameCodec::CHANNELS];
+	MyFrameCodec::Quantize<test_sensor>(other, values);
+	traits::skeleton decoded;
+	MyFrameCodec::Dequantize<test_sensor>(values, decoded);
+	float error = 0.0f;
+	bool states = true;
+	for (int j = 0; j < traits::JOINTS; ++j)
+	{
+		float a[4];
+		float b[4];
+		traits::Orientation(other, j, a);
+		traits::Orientation(decoded, j, b);
+		for (int c = 0; c < 4; ++c)
+			error = std::max(error, std::fabs(a[c] - b[c]) * MyFrameCodec::ORIENTATION_SCALE);
+		traits::Position(other, j, a);
+		traits::Position(decoded, j, b);
+		for (int c = 0; c < 3; ++c)
+			error = std::max(error, std::fabs(a[c] - b[c]) * MyFrameCodec::POSITION_SCALE);
+		states = states && traits::Tracked(other, j) == traits::Tracked(decoded, j);
+	}
+	Check(error <= 0.51f && states, "test sensor quantizer round trip");
+
+	// the pose library on the figure, and a file that keeps the sensor it was saved for
+	typedef MyBasicPoseLibrary<test_sensor> test_library;
+	test_library library;
+	library.Append(figure, 'F');
+	library.Append(other, 'O');
+	std::array<bool, traits::JOINTS> all;
+	all.fill(true);
+	const test_library::match found = library.Match(figure, all, 0.1f);
+	const test_library::match lost = library.Match(other, all, 0.1f);
+	Check(found.pose == 0 && lost.pose == -1 && lost.failed == 2, "test sensor library finds the figure and the lost joint");
+
+	const std::string path = std::string(settings.dir) + "/kinectbench_test_sensor.kpl";
+	test_library loaded;
+	MyPoseLibrary active;
+	const bool saved = library.Export(path.c_str()) && loaded.Import(path.c_str());
+	Check(saved && loaded.size() == 2 && loaded.getKey(1) == 'O' && !loaded.isTracked(1, 2) && loaded.Match(figure, all, 0.1f).pose == 0,
+		"test sensor library file round trip");
+	Check(!active.Import(path.c_str()) && active.size() == 0, "test sensor library file is refused by the build's sensor");
+	loaded.Clear();
+	remove(path.c_str());
+
+	fprintf(output, "# sensor name=%s joints=%d bones=%d ghost_error=%.6f quantize_steps=%.3f\n", traits::NAME, traits::JOINTS, traits::BONES,
+		ghost, error);
+}
+
+static void BenchStability(const std::vector<mask>& masks)
+{
+	// what RECORD mode runs per body and frame: a steady hold, and a body that never settles
+	MyPoseLibrary library;
+	RandomLibrary(library, 64, 21);
+	const std::vector<skeleton_data> steady = Generate(SEQUENCE, nullptr, 1e9f, 0.0f, 22);
+	const std::vector<skeleton_data> moving = Generate(SEQUENCE, &library, 0.0f, 50.0f, 23);
+	const uint64_t step = 8333;		// microseconds, 120 Hz
+
+	for (const mask& joints : masks)
+	{
+		const char* names[] = { "stability_hold", "stability_move" };
+		const std::vector<skeleton_data>* sequences[] = { &steady, &moving };
+		for (int s = 0; s < 2; ++s)
+		{
+			if (!Selected(names[s]))
+				continue;
+
+			MyStabilityDetector* detector = new MyStabilityDetector();
+			detector->setHoldTime(1000.0f);
+			uint64_t timestamp = 0;
+			Measure(names[s], 1, joints, [&](uint64_t iterations) {
+				int held = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					timestamp += step;
+					held += detector->Push((*sequences[s])[i % SEQUENCE], timestamp, joints.joints, THRESH) ? 1 : 0;
+				}
+				sink = held;
+			});
+			delete detector;
+		}
+	}
+}
+
+static void BenchMatch(const std::vector<mask>& masks, size_t poses)
+{
+	MyPoseLibrary library;
+	RandomLibrary(library, poses, 31);
+	const std::vector<skeleton_data> queries = Generate(QUERIES, &library, 100.0f, 100.0f, 32);
+
+	for (const mask& joints : masks)
+	{
+		if (Selected("match_library"))
+		{
+			Measure("match_library", poses, joints, [&](uint64_t iterations) {
+				int found = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+					found += library.Match(queries[i % QUERIES], joints.joints, THRESH).pose;
+				sink = found;
+			});
+		}
+		if (Selected("match_index"))
+		{
+			// the index of a pose saved on top, built as Save builds it, from the index it had
+			MyPoseIndex index;
+			index.Build(library, joints.joints);
+			MyPoseLibrary grown;
+			grown.CopyFrom(library);
+			grown.Append(queries[0], 'X');
+			MyPoseIndex full;
+			full.Build(grown, joints.joints);
+			MyPoseIndex extended;
+			extended.Build(grown, joints.joints, &index);
+
+			// the same poses as the scan, from both
+			MyPoseIndex::usage use = { 0, 0.0f, 0 };
+			MyPoseLibrary::scratch work;
+			size_t mismatches = 0;
+			for (const skeleton_data& query : queries)
+			{
+				const int expected = grown.Match(query, joints.joints, THRESH).pose;
+				for (const MyPoseIndex* built : { &full, &extended })
+				{
+					const bool useTree = built->Prepare(grown, use);
+					mismatches += built->Match(grown, query, joints.joints, THRESH, useTree, work).pose != expected ? 1 : 0;
+					built->Merge(grown, work, use);
+				}
+			}
+			Check(mismatches == 0 && extended.isBuiltFor(grown, joints.joints), "match_index: the index finds the pose the scan finds");
+
+			Measure("match_index", poses, joints, [&](uint64_t iterations) {
+				int found = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					const bool useTree = index.Prepare(library, use);
+					found += index.Match(library, queries[i % QUERIES], joints.joints, THRESH, useTree, work).pose;
+					index.Merge(library, work, use);
+				}
+				sink = found;
+			});
+		}
+	}
+}
+
+static void BenchKernels(const std::vector<mask>& masks)
+{
+	static const size_t POSES = 1000;
+	if (!Selected("kernel"))
+		return;
+
+	// near the library, so poses match, and random, so blocks are left early
+	MyPoseLibrary library;
+	RandomLibrary(library, POSES, 91);
+	std::vector<skeleton_data> queries = Generate(QUERIES, &library, 100.0f, 100.0f, 92);
+	const std::vector<skeleton_data> far = Generate(QUERIES, nullptr, 100.0f, 100.0f, 93);
+	queries.insert(queries.end(), far.begin(), far.end());
+
+	// every kernel must find what the scalar one finds, distances may differ in rounding only (FMA)
+	const int active = MyPoseLibrary::getKernel();
+	std::vector<MyPoseLibrary::match> expected(masks.size() * queries.size());
+	std::string available;
+	size_t mismatches = 0;
+	for (int kernel = 0; kernel < KERNEL_COUNT; ++kernel)
+	{
+		if (!MyPoseLibrary::setKernel(kernel))
+			continue;
+		available += std::string(available.empty() ? "" : ",") + MyPoseLibrary::getKernelName(kernel);
+
+		for (size_t m = 0; m < masks.size(); ++m)
+		{
+			for (size_t q = 0; q < queries.size(); ++q)
+			{
+				const MyPoseLibrary::match result = library.Match(queries[q], masks[m].joints, THRESH);
+				MyPoseLibrary::match& scalar = expected[m * queries.size() + q];
+				if (kernel == KERNEL_SCALAR)
+				{
+					scalar = result;
+					continue;
+				}
+				if (result.pose != scalar.pose || result.closest != scalar.closest || result.failed != scalar.failed ||
+					std::fabs(result.distance - scalar.distance) > 1e-4f)
+				{
+					++mismatches;
+				}
+			}
+		}
+
+		const std::string name = std::string("kernel_") + MyPoseLibrary::getKernelName(kernel);
+		Measure(name.c_str(), POSES, masks.front(), [&](uint64_t iterations) {
+			int found = 0;
+			for (uint64_t i = 0; i < iterations; ++i)
+				found += library.Match(queries[i % QUERIES], masks.front().joints, THRESH).pose;
+			sink = found;
+		});
+	}
+	MyPoseLibrary::setKernel(active);
+
+	size_t matched = 0;
+	for (const MyPoseLibrary::match& result : expected)
+		matched += result.pose >= 0 ? 1 : 0;
+	fprintf(output, "# kernels available=%s active=%s comparisons=%zu matched=%zu mismatches=%zu\n",
+		available.c_str(), MyPoseLibrary::getKernelName(active), expected.size(), matched, mismatches);
+	Check(mismatches == 0, "kernels: every kernel finds the pose the scalar kernel finds");
+}
+
+static void BenchFiles(size_t poses)
+{
+	static const mask none = { "-", {} };
+
+	MyPoseLibrary library;
+	RandomLibrary(library, poses, 41);
+
+	const char* formats[] = { "csv", "kpl" };
+	for (const char* format : formats)
+	{
+		const std::string path = std::string(settings.dir) + "/kinectbench." + format;
+		const std::string exportName = std::string("export_") + format;
+		const std::string importName = std::string("import_") + format;
+
+		if (Selected(exportName.c_str()))
+		{
+			Measure(exportName.c_str(), poses, none, [&](uint64_t iterations) {
+				int written = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+					written += library.Export(path.c_str()) ? 1 : 0;
+				sink = written;
+			});
+		}
+		if (Selected(importName.c_str()))
+		{
+			// import needs a file even when only the import is asked for
+			if (!library.Export(path.c_str()))
+			{
+				fprintf(stderr, "Can't write %s\n", path.c_str());
+				continue;
+			}
+
+			MyPoseLibrary loaded;
+			Measure(importName.c_str(), poses, none, [&](uint64_t iterations) {
+				size_t read = 0;
+				for (uint64_t i = 0; i < iterations; ++i)
+				{
+					loaded.Import(path.c_str());
+					read += loaded.size();
+				}
+				sink = (int)read;
+			});
+			loaded.Clear();
+		}
+		remove(path.c_str());
+	}
+
+}
+
+static void BenchFileFormats()
+{
+	// a csv keeps which joints a pose had data for, a file from before the mask has them all
+	if (Selected("import_csv"))
+	{
+		const std::string path = std::string(settings.dir) + "/kinectbench_tracked.csv";
+		float orientations[JOINTS][4] = {};
+		bool tracked[JOINTS];
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			orientations[j][0] = 1.0f;
+			tracked[j] = j % 3 != 0;
+		}
+		MyPoseLibrary saved;
+		saved.Append(orientations, tracked, 'T');
+
+		MyPoseLibrary loaded;
+		bool kept = saved.Export(path.c_str()) && loaded.Import(path.c_str()) && loaded.size() == 1;
+		for (int j = 0; j < JOINTS && kept; ++j)
+			kept = loaded.isTracked(0, j) == tracked[j];
+
+		// the same pose without the trailing mask
+		FILE* f = fopen(path.c_str(), "w");
+		if (f)
+		{
+			fprintf(f, "%d,0,0.1,0.15,0,0\n", 'T');
+			for (int j = 0; j < JOINTS; ++j)
+				fprintf(f, "1,0,0,0\n");
+			fclose(f);
+		}
+		MyPoseLibrary older;
+		bool all = f && older.Import(path.c_str()) && older.size() == 1;
+		for (int j = 0; j < JOINTS && all; ++j)
+			all = older.isTracked(0, j);
+		Check(kept && all, "import_csv: the tracked joints survive a csv, older files count every joint as tracked");
+		remove(path.c_str());
+	}
+
+	// a mapped file is matched as it is, a block count or padding lane that Export never writes is refused
+	if (!Selected("import_kpl"))
+		return;
+
+	const std::string path = std::string(settings.dir) + "/kinectbench_damaged.kpl";
+	MyPoseLibrary small;
+	RandomLibrary(small, MyPoseLibrary::LANES + 3, 43);
+	std::vector<char> bytes;
+	if (small.Export(path.c_str()))
+	{
+		FILE* f = fopen(path.c_str(), "rb");
+		char buffer[4096];
+		size_t read;
+		while (f && (read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+			bytes.insert(bytes.end(), buffer, buffer + read);
+		if (f)
+			fclose(f);
+	}
+
+	auto refused = [&](const std::vector<char>& damaged) {
+		FILE* f = fopen(path.c_str(), "wb");
+		if (!f)
+			return false;
+		fwrite(damaged.data(), 1, damaged.size(), f);
+		fclose(f);
+		MyPoseLibrary loaded;
+		return !loaded.Import(path.c_str()) && loaded.size() == 0;
+	};
+
+	bool ok = bytes.size() >= sizeof(MyPoseLibrary::file_header);
+	if (ok)
+	{
+		MyPoseLibrary::file_header header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		// fewer poses than the blocks hold, the second block's real poses would become padding
+		std::vector<char> fewer = bytes;
+		header.poses = 3;
+		std::memcpy(fewer.data(), &header, sizeof(header));
+		ok = refused(fewer);
+
+		// a tracked joint in the first padding lane
+		std::vector<char> padded = bytes;
+		const size_t lane = (MyPoseLibrary::LANES + 3) % MyPoseLibrary::LANES;
+		uint32_t tracked = 1;
+		std::memcpy(padded.data() + header.dataOffset + sizeof(MyPoseLibrary::block) + offsetof(MyPoseLibrary::block, tracked) + lane * sizeof(uint32_t), &tracked, sizeof(tracked));
+		ok = refused(padded) && ok;
+
+		// the file as written still loads
+		ok = !refused(bytes) && ok;
+	}
+	Check(ok, "import_kpl: a damaged block count or padding lane is refused");
+	remove(path.c_str());
+}
+
+static void BenchCodec()
+{
+	static const mask none = { "-", {} };
+
+	// a full room at sensor rate, chunked like MyRecorder does so every chunk starts from a keyframe
+	const std::vector<frame_data> frames = Frames(SEQUENCE, 51);
+
+	const size_t chunks = (SEQUENCE + MyRecorder::CHUNK_FRAMES - 1) / MyRecorder::CHUNK_FRAMES;
+	std::vector<std::vector<uint8_t>> coded(chunks);
+	std::vector<size_t> counts(chunks);
+	MyFrameCodec codec;
+	size_t raw = 0;
+	size_t bytes = 0;
+	for (size_t c = 0; c < chunks; ++c)
+	{
+		coded[c].reserve(MyRecorder::CHUNK_FRAMES * MyFrameCodec::MAX_FRAME_BYTES);
+		codec.Reset();
+		codec.Begin(coded[c]);
+		for (size_t i = c * MyRecorder::CHUNK_FRAMES; i < std::min(SEQUENCE, (c + 1) * MyRecorder::CHUNK_FRAMES); ++i)
+		{
+			codec.Encode(frames[i]);
+			++counts[c];
+			raw += sizeof(MyRecorder::frame_header) + frames[i].count * sizeof(body_data);
+		}
+		codec.End();
+		bytes += coded[c].size();
+	}
+	// long runs of empty frames get down to a few bits each, the last one may end on a byte boundary
+	{
+		MyFrameCodec check;
+		frame_data empty = {};
+		std::vector<uint8_t> out;
+		bool whole = true;
+		for (size_t count = 340; count < 400; ++count)
+		{
+			out.clear();
+			check.Reset();
+			check.Begin(out);
+			for (size_t i = 0; i < count; ++i)
+			{
+				empty.seq = i;
+				empty.timestamp = i * 33333;
+				check.Encode(empty);
+			}
+			check.End();
+
+			check.Reset();
+			check.Begin(out.data(), out.size(), count);
+			size_t decoded = 0;
+			while (check.Decode(empty) && empty.seq == decoded)
+				++decoded;
+			whole = whole && decoded == count;
+		}
+		Check(whole, "codec: every empty frame decodes, however the last one ends");
+	}
+
+	fprintf(output, "# codec bodies=%d raw_bytes_per_frame=%.0f coded_bytes_per_frame=%.0f ratio=%.2f\n",
+		MAX_BODIES, (double)raw / SEQUENCE, (double)bytes / SEQUENCE, (double)raw / bytes);
+
+	if (Selected("encode_frame"))
+	{
+		std::vector<uint8_t> out;
+		out.reserve(MyRecorder::CHUNK_FRAMES * MyFrameCodec::MAX_FRAME_BYTES);
+		Measure("encode_frame", MAX_BODIES, none, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				if (i % MyRecorder::CHUNK_FRAMES == 0)
+				{
+					codec.End();
+					out.clear();
+					codec.Reset();
+					codec.Begin(out);
+				}
+				codec.Encode(frames[i % SEQUENCE]);
+			}
+			codec.End();
+			sink = (int)out.size();
+		});
+	}
+	if (Selected("decode_frame"))
+	{
+		frame_data frame;
+		Measure("decode_frame", MAX_BODIES, none, [&](uint64_t iterations) {
+			int bodies = 0;
+			size_t chunk = 0;
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				if (!codec.Decode(frame))
+				{
+					codec.Reset();
+					codec.Begin(coded[chunk].data(), coded[chunk].size(), counts[chunk]);
+					chunk = (chunk + 1) % chunks;
+					codec.Decode(frame);
+				}
+				bodies += frame.count;
+			}
+			sink = bodies;
+		});
+	}
+}
+
+static void BenchShared()
+{
+	static const mask none = { "-", {} };
+	if (!Selected("shared_publish") && !Selected("shared_read"))
+		return;
+
+	MySharedRing ring;
+	MySharedReader reader;
+	if (!ring.Start("kinectbench.frames") || !reader.Open("kinectbench.frames"))
+	{
+		fprintf(stderr, "Can't share frames\n");
+		return;
+	}
+
+	const std::vector<frame_data> frames = Frames(QUERIES, 61);
+
+	if (Selected("shared_publish"))
+	{
+		Measure("shared_publish", MAX_BODIES, none, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i)
+				ring.Publish(frames[i % QUERIES]);
+			sink = (int)ring.getPublished();
+		});
+	}
+	if (Selected("shared_read"))
+	{
+		// what a consumer in the same process pays per frame, reading in place
+		MySharedReader::view v;
+		Measure("shared_read", MAX_BODIES, none, [&](uint64_t iterations) {
+			int bodies = 0;
+			for (uint64_t i = 0; i < iterations; ++i)
+			{
+				ring.Publish(frames[i % QUERIES]);
+				if (reader.Next(v))
+				{
+					const int count = v.frame->count;
+					if (reader.Validate(v))
+						bodies += count;
+				}
+			}
+			sink = bodies;
+		});
+	}
+	reader.Close();
+	ring.Stop();
+}
+
+static void BenchNetwork()
+{
+	static const mask none = { "-", {} };
+	if (!Selected("net_push") && !Selected("net_loopback"))
+		return;
+
+	MyNetReceiver receiver;
+	MyNetPublisher publisher;
+	const std::string subscriber = "127.0.0.1:" + std::to_string(NET_PORT);
+	if (!receiver.Start(NET_PORT) || !publisher.Start(subscriber.c_str()))
+	{
+		fprintf(stderr, "Can't stream frames\n");
+		return;
+	}
+
+	std::vector<frame_data> frames = Frames(QUERIES, 71);
+
+	if (Selected("net_push"))
+	{
+		// what the match stage pays, the sender thread does the rest
+		Measure("net_push", MAX_BODIES, none, [&](uint64_t iterations) {
+			for (uint64_t i = 0; i < iterations; ++i)
+				publisher.Push(frames[i % QUERIES]);
+			sink = (int)publisher.getSentFrames();
+		});
+	}
+	if (Selected("net_loopback"))
+	{
+		// paced well above sensor rate, then loss and capture -> complete latency as a subscriber sees them
+		const int count = settings.quick ? 500 : 5000;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		publisher.Stop();
+		receiver.Stop();
+		receiver.Start(NET_PORT);
+		publisher.Start(subscriber.c_str());
+		for (int i = 0; i < count; ++i)
+		{
+			frame_data& frame = frames[i % QUERIES];
+			frame.seq = (uint64_t)i;
+			frame.acquired = Now();
+			publisher.Push(frame);
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		const MyLatencyHistogram& latency = receiver.getLatency();
+		fprintf(output, "# net frames=%d complete=%llu incomplete=%llu datagrams=%llu lost=%llu loss=%.4f p50_us=%.1f p99_us=%.1f max_us=%.1f\n",
+			count, (unsigned long long)receiver.getCompleteFrames(), (unsigned long long)receiver.getIncompleteFrames(),
+			(unsigned long long)receiver.getDatagrams(), (unsigned long long)receiver.getLost(), receiver.getLossRate(),
+			latency.Percentile(50.0) / 1000.0, latency.Percentile(99.0) / 1000.0, latency.getMax() / 1000.0);
+	}
+	publisher.Stop();
+	receiver.Stop();
+}
+
+// a take stopped after the source ended still becomes a gesture, nothing is left waiting for a frame
+static void BenchGestures()
+{
+	if (!Selected("gesture"))
+		return;
+
+	MySyntheticSource::settings config = MySyntheticSource::Defaults();
+	config.realtime = false;
+	config.frames = 200;
+	config.seed = 86;
+	MySyntheticSource source(config);
+
+	MySkeleton* skeleton = new MySkeleton();
+	skeleton->Init(nullptr, &source);
+	MyGestureMatcher& gestures = skeleton->getGestures();
+	gestures.StartRecording();
+	skeleton->Start();
+	while (skeleton->isRunning())
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	skeleton->StopGesture();
+	const int state = gestures.getState();
+	const int take = gestures.getTakeLength();
+	skeleton->SaveGesture('G');
+	const size_t saved = skeleton->getGestureAmount();
+	skeleton->Stop();
+	delete skeleton;
+
+	fprintf(output, "# gestures frames=%llu take=%d saved=%zu\n", (unsigned long long)config.frames, take, saved);
+	Check(state == GESTURE_READY && take > 0, "gestures: a take stopped after the source ended is ready");
+	Check(saved == 1, "gestures: the take is saved");
+}
+
+static void BenchDispatch()
+{
+	if (!Selected("dispatch"))
+		return;
+
+	// taps, holds and repeats, so both the droppable and the guaranteed paths of the key queue are used
+	MyPoseLibrary library;
+	RandomLibrary(library, 24, 81);
+	for (size_t p = 0; p < library.size(); ++p)
+	{
+		MyPoseLibrary::binding bind = MyPoseLibrary::DefaultBinding();
+		bind.mode = (uint32_t)(p % BIND_MODE_COUNT);
+		bind.repeatMs = 100;
+		bind.cooldownMs = 0;
+		library.setBinding(p, bind);
+	}
+	const std::string path = std::string(settings.dir) + "/kinectbench_dispatch.kpl";
+	if (!library.Export(path.c_str()))
+	{
+		fprintf(stderr, "Can't write %s\n", path.c_str());
+		return;
+	}
+
+	// every body moves through the library as fast as frames can be matched, into a sink slow enough
+	// to fill the key queue
+	MySyntheticSource::settings config = MySyntheticSource::Defaults();
+	config.realtime = false;
+	config.bodies = MAX_BODIES;
+	config.frames = settings.quick ? 3000 : 30000;
+	config.holdMs = 300.0f;
+	config.transitionMs = 100.0f;
+	config.seed = 82;
+	MySyntheticSource source(config, &library);
+	MyMemorySink keys(1 << 20);
+	keys.setDelay(200);
+
+	MySkeleton* skeleton = new MySkeleton();
+	skeleton->Init(nullptr, &source, &keys);
+	skeleton->Import(path.c_str());
+	skeleton->setMode(EXECUTE);
+	const uint64_t begin = Now();
+	skeleton->Start();
+	while (skeleton->isRunning())
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	const double seconds = (Now() - begin) / 1e9;
+	skeleton->Stop();
+	const uint64_t dropped = skeleton->getDroppedKeys();
+	const uint64_t sent = skeleton->getSentKeys();
+	delete skeleton;
+	remove(path.c_str());
+
+	// a key is released as often as it is pressed and never before, and keys come out in the order sent
+	const std::vector<MyMemorySink::sent> got = keys.getSent();
+	std::array<int, 256> down;
+	down.fill(0);
+	size_t presses = 0, releases = 0, taps = 0, unpaired = 0, unordered = 0;
+	for (size_t i = 0; i < got.size(); ++i)
+	{
+		const MyMemorySink::sent& key = got[i];
+		if (i > 0 && key.time < got[i - 1].time)
+			++unordered;
+		int& count = down[key.key & 0xff];
+		if (key.action == KEY_PRESS)
+		{
+			++presses;
+			++count;
+		}
+		else if (key.action == KEY_RELEASE)
+		{
+			++releases;
+			if (--count < 0)
+				++unpaired;
+		}
+		else
+		{
+			++taps;
+		}
+	}
+	for (int count : down)
+		unpaired += count > 0 ? count : 0;
+
+	fprintf(output, "# dispatch frames=%llu keys=%zu taps=%zu presses=%zu releases=%zu dropped_taps=%llu unpaired=%zu unordered=%zu seconds=%.2f\n",
+		(unsigned long long)config.frames, got.size(), taps, presses, releases, (unsigned long long)dropped, unpaired, unordered, seconds);
+	Check(got.size() == sent && keys.getTotal() == sent, "dispatch: every key the dispatch stage sent reached the sink");
+	Check(presses > 0 && taps > 0, "dispatch: the run pressed and tapped keys");
+	Check(unpaired == 0, "dispatch: every press has its release");
+	Check(unordered == 0, "dispatch: keys arrive in order");
+}
+
+/*************************************************************************************************/
+/*                                             Main                                              */
+/*************************************************************************************************/
+static void Usage(const char* name)
+{
+	fprintf(stderr, "usage: %s [--quick] [--max poses] [--out results.csv] [--dir tmpdir] [--filter name]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--quick"))
+			settings.quick = true;
+		else if (!strcmp(argv[i], "--max") && hasValue)
+			settings.maxPoses = (size_t)strtoull(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "--out") && hasValue)
+			settings.out = argv[++i];
+		else if (!strcmp(argv[i], "--dir") && hasValue)
+			settings.dir = argv[++i];
+		else if (!strcmp(argv[i], "--filter") && hasValue)
+			settings.filter = argv[++i];
+		else
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	// not stdout, the classes under test print there
+	output = fopen(settings.out, "w");
+	if (!output)
+	{
+		fprintf(stderr, "Can't write %s\n", settings.out);
+		return 1;
+	}
+
+	fprintf(output, "# kinectbench sensor=%s joints=%d lanes=%d file_version=%u quick=%d\n",
+		active_traits::NAME, JOINTS, MyPoseLibrary::LANES, MyPoseLibrary::FILE_VERSION, settings.quick ? 1 : 0);
+	fprintf(output, "bench,poses,mask,joints,iterations,median_ns,min_ns,ops_per_s\n");
+
+	const std::vector<mask> masks = Masks();
+	BenchCompare(masks);
+	BenchSensors();
+	BenchSynthetic();
+	BenchStability(masks);
+	BenchKernels(masks);
+	BenchCodec();
+	BenchFileFormats();
+	BenchShared();
+	BenchNetwork();
+	BenchDispatch();
+	BenchGestures();
+	for (size_t poses : SIZES)
+	{
+		if (poses > settings.maxPoses)
+			break;
+		BenchMatch(masks, poses);
+		BenchFiles(poses);
+	}
+
+	fclose(output);
+	fprintf(stderr, "Results written to %s\n", settings.out);
+	if (failures)
+		fprintf(stderr, "%d checks failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#include "MyAllocCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t s_threadAllocs = 0;
+static std::atomic<uint64_t> s_totalAllocs(0);
+
+static void* CountedAlloc(size_t size)
+{
+	++s_threadAllocs;
+	s_totalAllocs.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+static void* CountedAlignedAlloc(size_t size, size_t align)
+{
+	++s_threadAllocs;
+	s_totalAllocs.fetch_add(1, std::memory_order_relaxed);
+#if defined(_WIN32)
+	return _aligned_malloc(size ? size : 1, align);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, align < sizeof(void*) ? sizeof(void*) : align, size ? size : 1) != 0)
+		return nullptr;
+	return ptr;
+#endif
+}
+
+static void AlignedFree(void* ptr)
+{
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+uint64_t MyAllocCounter::ThisThread()
+{
+	return s_threadAllocs;
+}
+
+uint64_t MyAllocCounter::Total()
+{
+	return s_totalAllocs.load(std::memory_order_relaxed);
+}
+
+// replacements of the global allocation functions
+void* operator new(size_t size)
+{
+	void* ptr = CountedAlloc(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	void* ptr = CountedAlloc(size);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+	void* ptr = CountedAlignedAlloc(size, static_cast<size_t>(align));
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+	void* ptr = CountedAlignedAlloc(size, static_cast<size_t>(align));
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { AlignedFree(ptr); }
@@ -0,0 +1,14 @@
+#pragma once
+// std
+#include <cstdint>
+
+// Counts heap allocations made through the global operator new.
+// MyAllocCounter.cpp replaces operator new/delete for the whole program,
+// the per-thread count is what the capture loop uses to prove it stays allocation-free.
+class MyAllocCounter {
+public:		// functions
+	// allocations made by the calling thread since it started
+	static uint64_t ThisThread();
+	// allocations made by every thread since the program started
+	static uint64_t Total();
+};
@@ -0,0 +1,369 @@
+#include "MyFrameCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const int NEW_BODY = 7;						// reference index of a body not in the previous frame
+static const int64_t DELTA_LIMIT = (int64_t)1 << 30;
+
+static_assert(MAX_BODIES < NEW_BODY, "body references are 3 bits");
+static_assert(active_traits::BONES + 1 == JOINTS, "every joint but the root needs a bone");
+
+// joints in coding order, parents before children, and the parent of each, -1 for the root
+struct joint_tree {
+	int order[JOINTS];
+	int parent[JOINTS];
+
+	joint_tree()
+	{
+		order[0] = active_traits::ROOT;
+		parent[active_traits::ROOT] = -1;
+		for (int b = 0; b < active_traits::BONES; ++b)
+		{
+			order[b + 1] = active_traits::bones[b * 2];
+			parent[active_traits::bones[b * 2]] = active_traits::bones[b * 2 + 1];
+		}
+	}
+};
+static const joint_tree tree;
+
+static uint32_t ZigZag(int64_t v)
+{
+	return (uint32_t)((v << 1) ^ (v >> 63));
+}
+
+static int64_t UnZigZag(uint32_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// number of ones before the first zero, at least 64 bits must be buffered for an exact count
+static int TrailingOnes(uint64_t bits)
+{
+	if (bits == ~0ull)
+		return 64;
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, ~bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(~bits);
+#endif
+}
+
+MyFrameCodec::MyFrameCodec()
+{
+	this->m_out = nullptr;
+	this->m_bits = 0;
+	this->m_count = 0;
+	this->m_in = nullptr;
+	this->m_size = 0;
+	this->m_pos = 0;
+	this->m_frames = 0;
+	this->m_bad = false;
+	this->Reset();
+}
+
+void MyFrameCodec::Reset()
+{
+	this->m_previousCount = 0;
+	this->m_key = true;
+	this->m_seq = 0;
+	this->m_timestamp = 0;
+	this->m_interval = 0;
+
+	// small residuals against the previous frame, parent to child differences are larger
+	for (context& ctx : this->m_temporal)
+		ctx = { 4, 1, 2 };
+	for (context& ctx : this->m_spatial)
+		ctx = { 1024, 1, 10 };
+	this->m_seqContext = { 1, 1, 0 };
+	this->m_timeContext = { 64, 1, 6 };
+}
+
+void MyFrameCodec::Begin(std::vector<uint8_t>& out)
+{
+	this->m_out = &out;
+	this->m_bits = 0;
+	this->m_count = 0;
+}
+
+void MyFrameCodec::Encode(const frame_data& frame)
+{
+	// header, raw on keyframes and jumps
+	const int64_t seqDelta = (int64_t)(frame.seq - this->m_seq) - 1;
+	const int64_t timeDelta = (int64_t)(frame.timestamp - this->m_timestamp);
+	const bool raw = this->m_key || seqDelta < -DELTA_LIMIT || seqDelta > DELTA_LIMIT ||
+		timeDelta - this->m_interval < -DELTA_LIMIT || timeDelta - this->m_interval > DELTA_LIMIT;
+	this->Put(raw ? 1 : 0, 1);
+	if (raw)
+	{
+		this->Put(frame.seq, 32);
+		this->Put(frame.seq >> 32, 32);
+		this->Put(frame.timestamp, 32);
+		this->Put(frame.timestamp >> 32, 32);
+	}
+	else
+	{
+		this->PutRice(ZigZag(seqDelta), this->m_seqContext);
+		this->PutRice(ZigZag(timeDelta - this->m_interval), this->m_timeContext);
+		this->m_interval = timeDelta;
+	}
+
+	// bodies, each against the body with the same id in the previous frame
+	std::array<body_values, MAX_BODIES> current;
+	const int count = std::min(std::max(frame.count, 0), MAX_BODIES);
+	this->Put((uint64_t)count, 3);
+	for (int b = 0; b < count; ++b)
+	{
+		body_values& body = current[b];
+		body.id = frame.bodies[b].id;
+		MyFrameCodec::Quantize(frame.bodies[b].skeleton, body.values);
+
+		int reference = NEW_BODY;
+		for (int p = 0; p < this->m_previousCount && !this->m_key; ++p)
+		{
+			if (this->m_previous[p].id == body.id)
+			{
+				reference = p;
+				break;
+			}
+		}
+
+		this->Put((uint64_t)reference, 3);
+		if (reference == NEW_BODY)
+		{
+			this->Put(body.id, 32);
+			this->Put(body.id >> 32, 32);
+		}
+		this->PutBody(body, reference == NEW_BODY ? nullptr : &this->m_previous[reference]);
+	}
+
+	std::copy(current.begin(), current.begin() + count, this->m_previous.begin());
+	this->m_previousCount = count;
+	this->m_seq = frame.seq;
+	this->m_timestamp = frame.timestamp;
+	this->m_key = false;
+}
+
+void MyFrameCodec::End()
+{
+	while (this->m_count > 0)
+	{
+		this->m_out->push_back((uint8_t)this->m_bits);
+		this->m_bits >>= 8;
+		this->m_count = std::max(0, this->m_count - 8);
+	}
+	this->m_bits = 0;
+	this->m_out = nullptr;
+}
+
+void MyFrameCodec::Begin(const uint8_t* data, size_t size, size_t frames)
+{
+	this->m_in = data;
+	this->m_size = size;
+	this->m_pos = 0;
+	this->m_frames = frames;
+	this->m_bits = 0;
+	this->m_count = 0;
+	this->m_bad = false;
+}
+
+bool MyFrameCodec::Decode(frame_data& frame)
+{
+	if (this->m_bad || this->m_frames == 0)
+		return false;
+	--this->m_frames;
+
+	if (this->Get(1))
+	{
+		frame.seq = this->Get(32);
+		frame.seq |= this->Get(32) << 32;
+		frame.timestamp = this->Get(32);
+		frame.timestamp |= this->Get(32) << 32;
+	}
+	else
+	{
+		if (this->m_key)
+			return false;
+		frame.seq = this->m_seq + 1 + UnZigZag(this->GetRice(this->m_seqContext));
+		this->m_interval += UnZigZag(this->GetRice(this->m_timeContext));
+		frame.timestamp = this->m_timestamp + this->m_interval;
+	}
+
+	std::array<body_values, MAX_BODIES> current;
+	const int count = (int)this->Get(3);
+	if (count > MAX_BODIES)
+		this->m_bad = true;
+	for (int b = 0; b < count && !this->m_bad; ++b)
+	{
+		body_values& body = current[b];
+		const int reference = (int)this->Get(3);
+		if (reference == NEW_BODY)
+		{
+			body.id = this->Get(32);
+			body.id |= this->Get(32) << 32;
+		}
+		else if (reference >= this->m_previousCount)
+		{
+			this->m_bad = true;
+			break;
+		}
+		else
+		{
+			body.id = this->m_previous[reference].id;
+		}
+		this->GetBody(body, reference == NEW_BODY ? nullptr : &this->m_previous[reference]);
+
+		frame.bodies[b].id = body.id;
+		MyFrameCodec::Dequantize(body.values, frame.bodies[b].skeleton);
+	}
+	if (this->m_bad)
+		return false;
+
+	frame.count = count;
+	std::copy(current.begin(), current.begin() + count, this->m_previous.begin());
+	this->m_previousCount = count;
+	this->m_seq = frame.seq;
+	this->m_timestamp = frame.timestamp;
+	this->m_key = false;
+	return true;
+}
+
+void MyFrameCodec::Put(uint64_t value, int bits)
+{
+	// up to 32 bits, least significant first
+	this->m_bits |= (value & ((1ull << bits) - 1)) << this->m_count;
+	this->m_count += bits;
+	if (this->m_count >= 32)
+	{
+		const uint8_t bytes[4] = { (uint8_t)this->m_bits, (uint8_t)(this->m_bits >> 8), (uint8_t)(this->m_bits >> 16), (uint8_t)(this->m_bits >> 24) };
+		this->m_out->insert(this->m_out->end(), bytes, bytes + 4);
+		this->m_bits >>= 32;
+		this->m_count -= 32;
+	}
+}
+
+uint64_t MyFrameCodec::Get(int bits)
+{
+	while (this->m_count <= 56 && this->m_pos < this->m_size)
+	{
+		this->m_bits |= (uint64_t)this->m_in[this->m_pos++] << this->m_count;
+		this->m_count += 8;
+	}
+	if (this->m_count < bits)
+	{
+		this->m_bad = true;
+		return 0;
+	}
+
+	const uint64_t value = this->m_bits & ((1ull << bits) - 1);
+	this->m_bits >>= bits;
+	this->m_count -= bits;
+	return value;
+}
+
+void MyFrameCodec::PutRice(uint32_t value, context& ctx)
+{
+	// unary quotient as ones ended by a zero, then k plain bits, or ESCAPE ones and the raw value
+	const int k = ctx.k;
+	const uint32_t q = value >> k;
+	if (q >= (uint32_t)ESCAPE)
+	{
+		this->Put((1ull << ESCAPE) - 1, ESCAPE);
+		this->Put(value, 32);
+	}
+	else if (q + 1 + k <= 32)
+	{
+		const uint64_t low = value & ((1ull << k) - 1);
+		this->Put(((1ull << q) - 1) | (low << (q + 1)), (int)q + 1 + k);
+	}
+	else
+	{
+		this->Put((1ull << q) - 1, (int)q + 1);
+		this->Put(value, k);
+	}
+	MyFrameCodec::Update(ctx, value);
+}
+
+uint32_t MyFrameCodec::GetRice(context& ctx)
+{
+	const int k = ctx.k;
+
+	// the quotient and its end fit in the bits buffered after a refill
+	this->Get(0);
+	const int q = std::min(TrailingOnes(this->m_bits), ESCAPE);
+	if (q >= this->m_count)
+	{
+		this->m_bad = true;
+		return 0;
+	}
+
+	uint32_t value;
+	if (q == ESCAPE)
+	{
+		this->m_bits >>= ESCAPE;
+		this->m_count -= ESCAPE;
+		value = (uint32_t)this->Get(32);
+	}
+	else
+	{
+		this->m_bits >>= q + 1;
+		this->m_count -= q + 1;
+		value = ((uint32_t)q << k) | (uint32_t)this->Get(k);
+	}
+	MyFrameCodec::Update(ctx, value);
+	return value;
+}
+
+void MyFrameCodec::Update(context& ctx, uint32_t value)
+{
+	ctx.sum += std::min<uint32_t>(value, 1u << 24);
+	if (++ctx.count >= 64)
+	{
+		ctx.sum >>= 1;
+		ctx.count >>= 1;
+	}
+
+	// the parameter moves a step or two at a time
+	while (ctx.k > 0 && (ctx.count << (ctx.k - 1)) >= ctx.sum)
+		--ctx.k;
+	while (ctx.k < ESCAPE && (ctx.count << ctx.k) < ctx.sum)
+		++ctx.k;
+}
+
+void MyFrameCodec::PutBody(const body_values& body, const body_values* reference)
+{
+	for (int i = 0; i < JOINTS; ++i)
+	{
+		const int j = tree.order[i];
+		const int parent = tree.parent[j];
+		for (int c = 0; c < CHANNELS; ++c)
+		{
+			if (reference)
+				this->PutRice(ZigZag((int64_t)body.values[j][c] - reference->values[j][c]), this->m_temporal[j * CHANNELS + c]);
+			else
+				this->PutRice(ZigZag((int64_t)body.values[j][c] - (parent < 0 ? 0 : body.values[parent][c])), this->m_spatial[c]);
+		}
+	}
+}
+
+void MyFrameCodec::GetBody(body_values& body, const body_values* reference)
+{
+	for (int i = 0; i < JOINTS; ++i)
+	{
+		const int j = tree.order[i];
+		const int parent = tree.parent[j];
+		for (int c = 0; c < CHANNELS; ++c)
+		{
+			if (reference)
+				body.values[j][c] = (int32_t)(reference->values[j][c] + UnZigZag(this->GetRice(this->m_temporal[j * CHANNELS + c])));
+			else
+				body.values[j][c] = (int32_t)((parent < 0 ? 0 : body.values[parent][c]) + UnZigZag(this->GetRice(this->m_spatial[c])));
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compresses skeleton frames for long recordings.
+// Joints are quantized: orientation components to 1 / ORIENTATION_SCALE, positions to 1 / POSITION_SCALE meters,
+// the sensor's tracking state exactly. Each value is predicted from the same body (by tracking id) in the previous
+// frame and the residual is Rice coded, with a Rice parameter per joint and channel that follows the size of its
+// recent residuals, so a joint that holds still costs about a bit per value. A body new to the frame is predicted
+// joint by joint from its parent instead. Residuals too large for the unary part are escaped and written raw.
+// Reset() forgets the previous frame and the statistics, the next frame is a keyframe, so every chunk of a
+// recording decodes on its own. Nothing is allocated once the output has room for MAX_FRAME_BYTES per frame.
+class MyFrameCodec {
+public:		// data structures
+	static const int CHANNELS = 8;							// w, x, y, z, position x, y, z, state
+	static constexpr float ORIENTATION_SCALE = 32767.0f;
+	static constexpr float POSITION_SCALE = 10000.0f;		// 0.1 mm
+	static const int32_t POSITION_LIMIT = 1000000;		// 100 m, keeps every residual inside 32 bits
+	static const int ESCAPE = 24;							// unary length announcing a raw value
+	static const size_t MAX_FRAME_BYTES = (1 + 128 + 3 + MAX_BODIES * (3 + 64 + JOINTS * CHANNELS * (ESCAPE + 32))) / 8 + 8;
+
+private:	// data structures
+	// Rice parameter state: sum of recent residuals and how many, both halved now and then to follow changes,
+	// k is the smallest parameter with count << k >= sum
+	struct context {
+		uint32_t sum;
+		uint32_t count;
+		int k;
+	};
+
+	struct body_values {
+		uint64_t id;
+		int32_t values[JOINTS][CHANNELS];
+	};
+
+private:	// variables
+	// previous frame, as the decoder sees it
+	std::array<body_values, MAX_BODIES> m_previous;
+	int m_previousCount;
+	bool m_key;
+	uint64_t m_seq;
+	uint64_t m_timestamp;
+	int64_t m_interval;
+
+	std::array<context, JOINTS * CHANNELS> m_temporal;		// residuals against the previous frame
+	std::array<context, CHANNELS> m_spatial;				// residuals against the parent joint
+	context m_seqContext;
+	context m_timeContext;
+
+	// writing
+	std::vector<uint8_t>* m_out;
+	uint64_t m_bits;
+	int m_count;
+
+	// reading
+	const uint8_t* m_in;
+	size_t m_size;
+	size_t m_pos;
+	size_t m_frames;			// left to decode
+	bool m_bad;
+
+public:		// functions
+
+	// constructer
+	MyFrameCodec();
+
+	// operations
+	void Reset();
+
+	// writing: Begin, Encode the frames, End writes out the last bits
+	void Begin(std::vector<uint8_t>& out);
+	void Encode(const frame_data& frame);
+	void End();
+
+	// reading: Begin with the number of frames encoded, then Decode them in the order they were encoded,
+	// false past the last one or on bad data. The padding can't tell, a frame may be shorter than a byte
+	void Begin(const uint8_t* data, size_t size, size_t frames);
+	bool Decode(frame_data& frame);
+
+	// tools, for any sensor's skeleton, values has sensor_traits<Sensor>::JOINTS rows
+	template <typename Sensor = active_sensor>
+	static void Quantize(const typename sensor_traits<Sensor>::skeleton& skeleton, int32_t values[][CHANNELS]);
+	template <typename Sensor = active_sensor>
+	static void Dequantize(const int32_t values[][CHANNELS], typename sensor_traits<Sensor>::skeleton& skeleton);
+
+private:	// functions
+	static int32_t Round(float v);
+	void Put(uint64_t value, int bits);
+	uint64_t Get(int bits);
+	void PutRice(uint32_t value, context& ctx);
+	uint32_t GetRice(context& ctx);
+	static void Update(context& ctx, uint32_t value);
+	void PutBody(const body_values& body, const body_values* reference);
+	void GetBody(body_values& body, const body_values* reference);
+};
+
+inline int32_t MyFrameCodec::Round(float v)
+{
+	return (int32_t)(v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+template <typename Sensor>
+void MyFrameCodec::Quantize(const typename sensor_traits<Sensor>::skeleton& skeleton, int32_t values[][CHANNELS])
+{
+	typedef sensor_traits<Sensor> traits;
+	for (int j = 0; j < traits::JOINTS; ++j)
+	{
+		float q[4];
+		float p[3];
+		traits::Orientation(skeleton, j, q);
+		traits::Position(skeleton, j, p);
+		for (int c = 0; c < 4; ++c)
+			values[j][c] = Round(std::max(-1.0f, std::min(1.0f, q[c])) * ORIENTATION_SCALE);
+		for (int c = 0; c < 3; ++c)
+		{
+			const float v = p[c] * POSITION_SCALE;
+			values[j][4 + c] = v > POSITION_LIMIT ? POSITION_LIMIT : v < -POSITION_LIMIT ? -POSITION_LIMIT : Round(v);
+		}
+		values[j][7] = std::max(0, std::min((int)traits::MAX_STATE, traits::State(skeleton, j)));
+	}
+}
+
+template <typename Sensor>
+void MyFrameCodec::Dequantize(const int32_t values[][CHANNELS], typename sensor_traits<Sensor>::skeleton& skeleton)
+{
+	typedef sensor_traits<Sensor> traits;
+	for (int j = 0; j < traits::JOINTS; ++j)
+	{
+		float q[4];
+		float p[3];
+		for (int c = 0; c < 4; ++c)
+			q[c] = values[j][c] / ORIENTATION_SCALE;
+		for (int c = 0; c < 3; ++c)
+			p[c] = values[j][4 + c] / POSITION_SCALE;
+		traits::SetOrientation(skeleton, j, q);
+		traits::SetPosition(skeleton, j, p);
+		traits::SetState(skeleton, j, values[j][7]);
+	}
+}
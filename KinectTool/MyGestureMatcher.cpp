@@ -0,0 +1,325 @@
+#include "MyGestureMatcher.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+MyGestureMatcher::MyGestureMatcher()
+{
+	// everything the capture thread touches is sized once here
+	this->m_take.assign((size_t)RECORD_FRAMES * FEATURES, 0.0f);
+	this->m_takeLength = 0;
+	this->m_state = GESTURE_IDLE;
+
+	this->m_windows = 0;
+	this->m_kim = 0;
+	this->m_keogh = 0;
+	this->m_abandoned = 0;
+	this->m_full = 0;
+	this->m_matches = 0;
+}
+
+MyGestureMatcher::stream::stream()
+{
+	this->history.assign((size_t)MAX_LENGTH * FEATURES, 0.0f);
+	this->rows.assign(2 * (MAX_LENGTH + 1), INF);
+	this->joints.fill(0);
+	this->jointCount = 0;
+	this->Reset();
+}
+
+void MyGestureMatcher::stream::Reset()
+{
+	this->head = 0;
+	this->filled = 0;
+}
+
+void MyGestureMatcher::Tick()
+{
+	// the GUI thread asked to stop, the take is its own from now on
+	int expected = GESTURE_STOPPING;
+	this->m_state.compare_exchange_strong(expected, GESTURE_READY);
+}
+
+void MyGestureMatcher::Record(const skeleton_data& skeleton)
+{
+	if (this->m_state == GESTURE_RECORDING && this->m_takeLength < RECORD_FRAMES)
+	{
+		float* frame = &this->m_take[(size_t)this->m_takeLength * FEATURES];
+		for (int j = 0; j < JOINTS; ++j)
+			GetJointOrientation(skeleton, j, frame + j * 4);
+		++this->m_takeLength;
+	}
+}
+
+MyGestureMatcher::match MyGestureMatcher::Push(stream& s, const gesture_set& gestures, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, bool detect) const
+{
+	match result = { -1, 0.0f };
+
+	bool tracked = true;
+	s.jointCount = 0;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		if (!mask[j])
+			continue;
+		s.joints[s.jointCount++] = j;
+		tracked = tracked && IsJointTracked(skeleton, j);
+	}
+
+	// a gesture has to be seen whole, losing a joint starts the stream over
+	if (!tracked)
+	{
+		s.filled = 0;
+		return result;
+	}
+
+	float* frame = &s.history[(size_t)s.head * FEATURES];
+	for (int j = 0; j < JOINTS; ++j)
+		GetJointOrientation(skeleton, j, frame + j * 4);
+	s.head = (s.head + 1) % MAX_LENGTH;
+	s.filled = std::min(s.filled + 1, (int)MAX_LENGTH);
+
+	if (!detect || s.jointCount == 0)
+		return result;
+
+	// the best gesture so far tightens the bound for the next ones
+	float best = thresh * thresh;
+	for (int i = 0; i < (int)gestures.size(); ++i)
+	{
+		const gesture& g = gestures[i];
+		if (g.length > s.filled)
+			continue;
+
+		++this->m_windows;
+		const float bound = best * g.length * s.jointCount;
+
+		// every warping path starts and ends on the first and last frames
+		const float kim = MyGestureMatcher::Distance(s, MyGestureMatcher::Frame(s, g.length, 0), &g.frames[0]) +
+			MyGestureMatcher::Distance(s, MyGestureMatcher::Frame(s, g.length, g.length - 1), &g.frames[(size_t)(g.length - 1) * FEATURES]);
+		if (kim > bound)
+		{
+			++this->m_kim;
+			continue;
+		}
+
+		if (MyGestureMatcher::LowerBoundKeogh(s, g, bound) > bound)
+		{
+			++this->m_keogh;
+			continue;
+		}
+
+		const float cost = MyGestureMatcher::Dtw(s, g, bound);
+		if (cost == INF)
+		{
+			++this->m_abandoned;
+			continue;
+		}
+		++this->m_full;
+
+		const float distance = cost / (g.length * s.jointCount);
+		if (distance <= best)
+		{
+			best = distance;
+			result.gesture = i;
+			result.distance = distance;
+		}
+	}
+
+	// the frames that made the gesture can not make it again
+	if (result.gesture >= 0)
+	{
+		++this->m_matches;
+		s.filled = 0;
+	}
+	return result;
+}
+
+void MyGestureMatcher::StartRecording()
+{
+	const int state = this->m_state;
+	if (state != GESTURE_IDLE && state != GESTURE_READY)
+		return;
+
+	this->m_takeLength = 0;
+	this->m_state = GESTURE_RECORDING;
+}
+
+void MyGestureMatcher::StopRecording()
+{
+	int expected = GESTURE_RECORDING;
+	this->m_state.compare_exchange_strong(expected, GESTURE_STOPPING);
+}
+
+std::shared_ptr<const MyGestureMatcher::gesture_set> MyGestureMatcher::Save(const gesture_set& gestures, int key)
+{
+	if (this->m_state != GESTURE_READY)
+		return nullptr;
+
+	const int take = this->m_takeLength;
+	const int count = (int)gestures.size();
+	if (take < MIN_LENGTH || count >= MAX_GESTURES)
+	{
+		printf("Gesture not saved: %d frames, %d gestures\n", take, count);
+		this->m_state = GESTURE_IDLE;
+		return nullptr;
+	}
+
+	// the templates are shared with the matching threads, the new one goes into a copy
+	std::shared_ptr<gesture_set> next = std::make_shared<gesture_set>(gestures);
+	next->emplace_back();
+
+	// resample long takes down to MAX_LENGTH
+	gesture& g = next->back();
+	g.key = key;
+	g.length = std::min(take, (int)MAX_LENGTH);
+	g.band = std::max(1, (int)(BAND * g.length));
+	g.frames.assign((size_t)g.length * FEATURES, 0.0f);
+	for (int i = 0; i < g.length; ++i)
+	{
+		const float position = g.length > 1 ? (float)i * (take - 1) / (g.length - 1) : 0.0f;
+		const int a = (int)position;
+		const int b = std::min(a + 1, take - 1);
+		const float t = position - a;
+		for (int f = 0; f < FEATURES; ++f)
+		{
+			const float va = this->m_take[(size_t)a * FEATURES + f];
+			const float vb = this->m_take[(size_t)b * FEATURES + f];
+			g.frames[(size_t)i * FEATURES + f] = va + (vb - va) * t;
+		}
+	}
+
+	// envelope of every frame over the warping band
+	g.upper.assign(g.frames.size(), -INF);
+	g.lower.assign(g.frames.size(), INF);
+	for (int i = 0; i < g.length; ++i)
+	{
+		const int lo = std::max(0, i - g.band);
+		const int hi = std::min(g.length - 1, i + g.band);
+		for (int k = lo; k <= hi; ++k)
+		{
+			for (int f = 0; f < FEATURES; ++f)
+			{
+				const float v = g.frames[(size_t)k * FEATURES + f];
+				g.upper[(size_t)i * FEATURES + f] = std::max(g.upper[(size_t)i * FEATURES + f], v);
+				g.lower[(size_t)i * FEATURES + f] = std::min(g.lower[(size_t)i * FEATURES + f], v);
+			}
+		}
+	}
+
+	this->m_state = GESTURE_IDLE;
+
+	printf("Gesture %d bound to key[%d], %d frames\n", count, key, g.length);
+	return next;
+}
+
+void MyGestureMatcher::Discard()
+{
+	int expected = GESTURE_READY;
+	this->m_state.compare_exchange_strong(expected, GESTURE_IDLE);
+}
+
+int MyGestureMatcher::getState() const
+{
+	return this->m_state;
+}
+
+int MyGestureMatcher::getTakeLength() const
+{
+	return this->m_takeLength;
+}
+
+MyGestureMatcher::stats MyGestureMatcher::getStats() const
+{
+	stats s;
+	s.windows = this->m_windows;
+	s.kim = this->m_kim;
+	s.keogh = this->m_keogh;
+	s.abandoned = this->m_abandoned;
+	s.full = this->m_full;
+	s.matches = this->m_matches;
+	return s;
+}
+
+const float* MyGestureMatcher::Frame(const stream& s, int length, int i)
+{
+	// i = 0 is the oldest of the last `length` frames
+	const int index = (s.head - length + i + MAX_LENGTH) % MAX_LENGTH;
+	return &s.history[(size_t)index * FEATURES];
+}
+
+float MyGestureMatcher::Distance(const stream& s, const float* a, const float* b)
+{
+	float sum = 0.0f;
+	for (int k = 0; k < s.jointCount; ++k)
+	{
+		const int f = s.joints[k] * 4;
+		for (int c = 0; c < 4; ++c)
+		{
+			const float d = a[f + c] - b[f + c];
+			sum += d * d;
+		}
+	}
+	return sum;
+}
+
+float MyGestureMatcher::LowerBoundKeogh(const stream& s, const gesture& g, float bound)
+{
+	float sum = 0.0f;
+	for (int i = 0; i < g.length; ++i)
+	{
+		const float* x = MyGestureMatcher::Frame(s, g.length, i);
+		const float* upper = &g.upper[(size_t)i * FEATURES];
+		const float* lower = &g.lower[(size_t)i * FEATURES];
+		for (int k = 0; k < s.jointCount; ++k)
+		{
+			const int f = s.joints[k] * 4;
+			for (int c = 0; c < 4; ++c)
+			{
+				const float v = x[f + c];
+				if (v > upper[f + c])
+					sum += (v - upper[f + c]) * (v - upper[f + c]);
+				else if (v < lower[f + c])
+					sum += (lower[f + c] - v) * (lower[f + c] - v);
+			}
+		}
+
+		if (sum > bound)
+			return sum;
+	}
+	return sum;
+}
+
+float MyGestureMatcher::Dtw(stream& s, const gesture& g, float bound)
+{
+	// rows indexed by template frame + 1, column 0 is the virtual start
+	float* previous = &s.rows[0];
+	float* current = &s.rows[MAX_LENGTH + 1];
+	std::fill(previous, previous + g.length + 1, INF);
+	previous[0] = 0.0f;
+
+	for (int i = 0; i < g.length; ++i)
+	{
+		const float* x = MyGestureMatcher::Frame(s, g.length, i);
+		const int lo = std::max(0, i - g.band);
+		const int hi = std::min(g.length - 1, i + g.band);
+
+		std::fill(current, current + g.length + 1, INF);
+		float rowMin = INF;
+		for (int j = lo; j <= hi; ++j)
+		{
+			const float step = std::min(previous[j + 1], std::min(current[j], previous[j]));
+			const float cost = MyGestureMatcher::Distance(s, x, &g.frames[(size_t)j * FEATURES]) + step;
+			current[j + 1] = cost;
+			rowMin = std::min(rowMin, cost);
+		}
+
+		// every path goes through this row, none can come back under the bound
+		if (rowMin > bound)
+			return INF;
+
+		std::swap(previous, current);
+	}
+	return previous[g.length];
+}
@@ -0,0 +1,118 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// std
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+typedef enum {
+	GESTURE_IDLE,
+	GESTURE_RECORDING,		// the capture thread appends frames
+	GESTURE_STOPPING,		// asked to stop, the capture thread still owns the buffer
+	GESTURE_READY			// stopped, the GUI thread can save or discard the take
+}GESTURE_STATE;
+
+// Motion gestures bound to keys, matched against the live stream with dynamic time warping.
+// Every frame, each template is compared with the last `length` frames of the stream (the UCR suite cascade):
+// LB_Kim on the first and last frame, then LB_Keogh against the template envelope, and only the windows that
+// survive both get a full DTW inside a Sakoe-Chiba band, abandoned as soon as a row exceeds the bound.
+// Frame distance is the squared quaternion distance summed over the enabled joints, a gesture matches when its
+// DTW cost is under length * joints * thresh^2.
+// The templates are not kept here: Save builds a new gesture_set from the current one and the take, and the
+// caller publishes it whole, so a set the matching threads hold is never written again.
+class MyGestureMatcher {
+public:		// data structures
+	static const int FEATURES = JOINTS * 4;		// w, x, y, z per joint
+	static const int MAX_LENGTH = 128;			// frames per template, longer takes are resampled
+	static const int MIN_LENGTH = 8;
+	static const int MAX_GESTURES = 64;
+	static const int RECORD_FRAMES = 512;		// longest take, ~4 s at 120 Hz
+	static constexpr float BAND = 0.2f;			// warping band, fraction of the template length
+
+	struct gesture {
+		int key;
+		int length;
+		int band;
+		std::vector<float> frames;		// [length][FEATURES]
+		std::vector<float> upper;		// LB_Keogh envelope over the band, same layout
+		std::vector<float> lower;
+	};
+	typedef std::vector<gesture> gesture_set;
+
+	struct match {
+		int gesture;		// -1 if none
+		float distance;		// DTW cost per frame and joint, comparable to thresh^2
+	};
+
+	// the last frames of one body and the DTW rows, one per tracked body so bodies can be matched in parallel
+	struct stream {
+		std::vector<float> history;			// ring of MAX_LENGTH frames
+		int head;							// next frame to write
+		int filled;							// frames in the ring
+		std::vector<float> rows;			// two rows of MAX_LENGTH + 1
+		std::array<int, JOINTS> joints;		// enabled joints in order
+		int jointCount;
+
+		stream();
+		void Reset();
+	};
+
+	struct stats {
+		uint64_t windows;	// template / window pairs looked at
+		uint64_t kim;		// rejected by LB_Kim
+		uint64_t keogh;		// rejected by LB_Keogh
+		uint64_t abandoned;	// full DTW started but abandoned
+		uint64_t full;		// full DTW finished
+		uint64_t matches;
+	};
+
+private:	// variables
+	// recording a new template
+	std::vector<float> m_take;			// [RECORD_FRAMES][FEATURES]
+	std::atomic<int> m_takeLength;
+	std::atomic<int> m_state;
+
+	// statistics, counted from every thread matching a stream
+	mutable std::atomic<uint64_t> m_windows;
+	mutable std::atomic<uint64_t> m_kim;
+	mutable std::atomic<uint64_t> m_keogh;
+	mutable std::atomic<uint64_t> m_abandoned;
+	mutable std::atomic<uint64_t> m_full;
+	mutable std::atomic<uint64_t> m_matches;
+
+public:		// functions
+
+	// constructer
+	MyGestureMatcher();
+	MyGestureMatcher(const MyGestureMatcher&) = delete;
+	MyGestureMatcher& operator=(const MyGestureMatcher&) = delete;
+
+	// capture thread, every frame and every wait with or without a body: hands a stopped take to the GUI thread
+	void Tick();
+
+	// capture thread: Record feeds the take from one body, Push adds the frame to the stream and returns the best
+	// gesture of the set it completes. Push can run on any thread at once as long as every stream is used by one of them
+	void Record(const skeleton_data& skeleton);
+	match Push(stream& s, const gesture_set& gestures, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, bool detect) const;
+
+	// GUI thread, recording a template. Save returns the gestures with the take appended, nullptr if it was not saved
+	void StartRecording();
+	void StopRecording();
+	std::shared_ptr<const gesture_set> Save(const gesture_set& gestures, int key);
+	void Discard();
+
+	// get data
+	int getState() const;
+	int getTakeLength() const;
+	stats getStats() const;
+
+private:	// functions
+	static const float* Frame(const stream& s, int length, int i);
+	static float Distance(const stream& s, const float* a, const float* b);
+	static float LowerBoundKeogh(const stream& s, const gesture& g, float bound);
+	static float Dtw(stream& s, const gesture& g, float bound);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+typedef enum {
+	KEY_TAP,			// press and release
+	KEY_PRESS,			// press, held until KEY_RELEASE
+	KEY_RELEASE
+}KEY_ACTION;
+
+// Where the dispatch stage sends key presses: the OS input queue, a virtual keyboard, or memory for tests.
+// Keys are Windows virtual-key codes ('A' to 'Z', '0' to '9', VK_SPACE, ...) whatever the sink, the way the
+// pose library stores them. Open() and Close() are called once each, Send() only from the dispatch thread,
+// so a slow sink holds up later keys but never the capture or match stages.
+class MyKeySink {
+public:		// functions
+
+	// constructer
+	virtual ~MyKeySink() {}
+
+	// operations
+	virtual bool Open() = 0;
+	virtual void Close() = 0;
+
+	// press and/or release key, false if it could not be sent
+	virtual bool Send(int key, KEY_ACTION action) = 0;
+
+	// get data
+	virtual const char* getName() const = 0;
+};
@@ -0,0 +1,302 @@
+#include "MyKinectSource.h"
+
+#include <cstdio>
+
+#if defined(K4A) || defined(K4W)
+
+#define VERIFY(result, error)                                                                            \
+	if (result != K4A_RESULT_SUCCEEDED)                                                                  \
+	{                                                                                                    \
+		printf("%s \n - (File: %s, Function: %s, Line: %d)\n", error, __FILE__, __FUNCTION__, __LINE__); \
+		return false;                                                                                    \
+	}
+
+MyKinectSource::MyKinectSource()
+{
+#if defined(K4A)
+	this->m_device = NULL;
+	this->m_tracker = NULL;
+	this->m_feeder = nullptr;
+	this->m_feeding = false;
+	this->m_failed = false;
+#elif defined(K4W)
+	this->m_sensor = nullptr;
+	this->m_reader = nullptr;
+	this->m_frameEvent = 0;
+	this->m_wakeEvent = NULL;
+#endif
+	this->m_idle = false;
+	this->m_skipped = 0;
+}
+
+MyKinectSource::~MyKinectSource()
+{
+	this->Close();
+}
+
+bool MyKinectSource::Open()
+{
+	// Setup camera
+#if defined(K4A)
+	k4a_device_configuration_t device_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+	device_config.depth_mode = K4A_DEPTH_MODE_NFOV_UNBINNED;
+
+	VERIFY(k4a_device_open(0, &this->m_device), "Open K4A Device failed!");
+	VERIFY(k4a_device_start_cameras(this->m_device, &device_config), "Start K4A cameras failed!");
+
+	k4a_calibration_t sensor_calibration;
+	VERIFY(k4a_device_get_calibration(this->m_device, device_config.depth_mode, K4A_COLOR_RESOLUTION_OFF, &sensor_calibration),
+		"Get depth camera calibration failed!");
+
+	k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
+	VERIFY(k4abt_tracker_create(&sensor_calibration, tracker_config, &this->m_tracker), "Body tracker initialization failed!");
+
+	this->m_failed = false;
+	this->m_feeding = true;
+	this->m_feeder = new std::thread(&MyKinectSource::Feed, this);
+#elif defined(K4W)
+	if (GetDefaultKinectSensor(&this->m_sensor) != S_OK)
+	{
+		printf("Get Sensor failed\n");
+		return false;
+	}
+
+	if (this->m_sensor->Open() != S_OK)
+	{
+		printf("Can't open sensor\n");
+		return false;
+	}
+
+	IBodyFrameSource* source = NULL;
+	if (this->m_sensor->get_BodyFrameSource(&source) != S_OK)
+	{
+		printf("Can't open BodyFrameSource\n");
+		return false;
+	}
+
+	if (source->OpenReader(&this->m_reader) != S_OK)
+	{
+		printf("Can't open reader\n");
+		source->Release();
+		return false;
+	}
+	source->Release();
+
+	// wait on frame arrival instead of polling the reader
+	if (this->m_reader->SubscribeFrameArrived(&this->m_frameEvent) != S_OK)
+	{
+		printf("Can't subscribe to body frames\n");
+		return false;
+	}
+	this->m_wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#endif
+
+	return true;
+}
+
+void MyKinectSource::Close()
+{
+	// Close camera
+#if defined(K4A)
+	if (this->m_feeder)
+	{
+		this->m_feeding = false;
+		this->m_feeder->join();
+		delete this->m_feeder;
+		this->m_feeder = nullptr;
+	}
+	if (this->m_tracker)
+	{
+		k4abt_tracker_shutdown(this->m_tracker);
+		k4abt_tracker_destroy(this->m_tracker);
+		this->m_tracker = NULL;
+	}
+	if (this->m_device)
+	{
+		k4a_device_stop_cameras(this->m_device);
+		k4a_device_close(this->m_device);
+		this->m_device = NULL;
+	}
+#elif defined(K4W)
+	if (this->m_wakeEvent)
+	{
+		CloseHandle(this->m_wakeEvent);
+		this->m_wakeEvent = NULL;
+	}
+	if (this->m_reader)
+	{
+		if (this->m_frameEvent)
+			this->m_reader->UnsubscribeFrameArrived(this->m_frameEvent);
+		this->m_frameEvent = 0;
+		this->m_reader->Release();
+		this->m_reader = nullptr;
+	}
+	if (this->m_sensor)
+	{
+		this->m_sensor->Close();
+		this->m_sensor->Release();
+		this->m_sensor = nullptr;
+	}
+#endif
+}
+
+SOURCE_RESULT MyKinectSource::Acquire(frame_data& frame, uint32_t timeout)
+{
+#if defined(K4A)
+	if (this->m_failed)
+		return SOURCE_ERROR;
+
+	// the feeder keeps the tracker busy, wait for whatever it finishes next
+	k4abt_frame_t body_frame = NULL;
+	k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(this->m_tracker, &body_frame, (int32_t)timeout);
+	if (pop_frame_result == K4A_WAIT_RESULT_TIMEOUT)
+	{
+		return SOURCE_NONE;
+	}
+	else if (pop_frame_result != K4A_WAIT_RESULT_SUCCEEDED)
+	{
+		printf("Pop body frame result failed!\n");
+		return SOURCE_ERROR;
+	}
+
+	frame.count = 0;
+	frame.timestamp = k4abt_frame_get_device_timestamp_usec(body_frame);
+
+	const uint32_t bodies = k4abt_frame_get_num_bodies(body_frame);
+	for (uint32_t i = 0; i < bodies && frame.count < MAX_BODIES; ++i)
+	{
+		body_data& body = frame.bodies[frame.count];
+		if (k4abt_frame_get_body_skeleton(body_frame, i, &body.skeleton) != K4A_RESULT_SUCCEEDED)
+		{
+			printf("Get body from body frame failed!\n");
+			continue;
+		}
+		body.id = k4abt_frame_get_body_id(body_frame, i);
+		++frame.count;
+	}
+
+	k4abt_frame_release(body_frame);
+	return SOURCE_FRAME;
+#elif defined(K4W)
+	HANDLE events[2] = { reinterpret_cast<HANDLE>(this->m_frameEvent), this->m_wakeEvent };
+	if (WaitForMultipleObjects(2, events, FALSE, timeout) != WAIT_OBJECT_0)
+		return SOURCE_NONE;
+
+	// reading the event data resets the event
+	IBodyFrameArrivedEventArgs* args = nullptr;
+	if (this->m_reader->GetFrameArrivedEventData(this->m_frameEvent, &args) != S_OK)
+		return SOURCE_NONE;
+
+	// nobody around, skip reading most frames
+	if (this->m_idle && ++this->m_skipped < IDLE_STRIDE)
+	{
+		args->Release();
+		return SOURCE_NONE;
+	}
+	this->m_skipped = 0;
+
+	IBodyFrameReference* reference = nullptr;
+	IBodyFrame* bodyFrame = nullptr;
+	HRESULT hr = args->get_FrameReference(&reference);
+	if (hr == S_OK)
+		hr = reference->AcquireFrame(&bodyFrame);
+	if (reference)
+		reference->Release();
+	args->Release();
+
+	// the frame may already be gone if we were late
+	if (hr != S_OK || !bodyFrame)
+		return SOURCE_NONE;
+
+	frame.count = 0;
+
+	// 100ns ticks
+	TIMESPAN time = 0;
+	bodyFrame->get_RelativeTime(&time);
+	frame.timestamp = (uint64_t)time / 10;
+
+	IBody* bodies[6] = { 0 };
+	if (bodyFrame->GetAndRefreshBodyData(6, bodies) == S_OK)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			IBody* body = bodies[i];
+			if (body)
+			{
+				BOOLEAN tracked = false;
+				if (body->get_IsTracked(&tracked) == S_OK && tracked)
+				{
+					body_data& data = frame.bodies[frame.count++];
+					body->get_TrackingId(&data.id);
+					body->GetJoints(JOINTS, data.skeleton.joints);
+					body->GetJointOrientations(JOINTS, data.skeleton.orientations);
+				}
+			}
+		}
+
+		for (int i = 0; i < 6; ++i)
+		{
+			if (bodies[i])
+				bodies[i]->Release();
+		}
+	}
+	bodyFrame->Release();
+	return SOURCE_FRAME;
+#endif
+}
+
+#if defined(K4A)
+void MyKinectSource::Feed()
+{
+	while (this->m_feeding)
+	{
+		// the timeout keeps Close() responsive since the call can't be woken up
+		k4a_capture_t sensor_capture;
+		k4a_wait_result_t get_capture_result = k4a_device_get_capture(this->m_device, &sensor_capture, 100);
+		if (get_capture_result == K4A_WAIT_RESULT_TIMEOUT)
+		{
+			continue;
+		}
+		else if (get_capture_result != K4A_WAIT_RESULT_SUCCEEDED)
+		{
+			printf("Get depth capture returned error: %d\n", get_capture_result);
+			break;
+		}
+
+		// nobody around, spare the tracker most captures
+		if (this->m_idle && ++this->m_skipped < IDLE_STRIDE)
+		{
+			k4a_capture_release(sensor_capture);
+			continue;
+		}
+		this->m_skipped = 0;
+
+		// a full tracker queue means the results are not taken fast enough, this capture is dropped
+		k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(this->m_tracker, sensor_capture, 0);
+		k4a_capture_release(sensor_capture);
+		if (queue_capture_result == K4A_WAIT_RESULT_FAILED)
+		{
+			printf("Error! Add capture to tracker process queue failed!\n");
+			break;
+		}
+	}
+
+	if (this->m_feeding)
+		this->m_failed = true;
+}
+#endif
+
+void MyKinectSource::Wake()
+{
+#if defined(K4W)
+	if (this->m_wakeEvent)
+		SetEvent(this->m_wakeEvent);
+#endif
+}
+
+void MyKinectSource::setIdle(bool idle)
+{
+	this->m_idle = idle;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+#if defined(K4W)
+#include <Windows.h>
+#endif
+
+// my classes
+#include "MySkeletonSource.h"
+
+// std
+#include <atomic>
+#include <thread>
+
+#if defined(K4A) || defined(K4W)
+// Live frames from the sensor the build targets.
+// Acquire() sleeps on the sensor: the frame arrived event for K4W, the body tracker results for K4A.
+// On K4A a feeder thread hands every capture to the tracker as it arrives, so the tracker works on the next
+// capture while the last result is matched. While idle only one frame in IDLE_STRIDE goes through the tracker.
+class MyKinectSource : public MySkeletonSource {
+public:		// data structures
+	static const int IDLE_STRIDE = 3;
+
+private:	// variables
+#if defined(K4A)
+	k4a_device_t m_device;
+	k4abt_tracker_t m_tracker;
+	std::thread* m_feeder;
+	std::atomic<bool> m_feeding;
+	std::atomic<bool> m_failed;			// the feeder stopped on a sensor error
+#elif defined(K4W)
+	IKinectSensor* m_sensor;
+	IBodyFrameReader* m_reader;
+	WAITABLE_HANDLE m_frameEvent;		// signaled by the runtime when a body frame arrived
+	HANDLE m_wakeEvent;					// signaled by Wake()
+#endif
+	std::atomic<bool> m_idle;
+	int m_skipped;						// frames skipped since the last one let through while idle
+
+public:		// functions
+
+	// constructer
+	MyKinectSource();
+	~MyKinectSource();
+
+	// operations
+	bool Open();
+	void Close();
+	SOURCE_RESULT Acquire(frame_data& frame, uint32_t timeout);
+	void Wake();
+
+	// set data
+	void setIdle(bool idle);
+
+private:	// functions
+#if defined(K4A)
+	void Feed();
+#endif
+};
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+// Kinect for Windows v2 skeleton types for builds without the SDK (KSIM).
+// Same names, values and memory layout as Kinect.h, so K4W recordings and pose libraries
+// can be replayed and matched on machines without the sensor, including Linux.
+
+// std
+#include <cstdint>
+
+typedef enum _JointType {
+	JointType_SpineBase = 0,
+	JointType_SpineMid = 1,
+	JointType_Neck = 2,
+	JointType_Head = 3,
+	JointType_ShoulderLeft = 4,
+	JointType_ElbowLeft = 5,
+	JointType_WristLeft = 6,
+	JointType_HandLeft = 7,
+	JointType_ShoulderRight = 8,
+	JointType_ElbowRight = 9,
+	JointType_WristRight = 10,
+	JointType_HandRight = 11,
+	JointType_HipLeft = 12,
+	JointType_KneeLeft = 13,
+	JointType_AnkleLeft = 14,
+	JointType_FootLeft = 15,
+	JointType_HipRight = 16,
+	JointType_KneeRight = 17,
+	JointType_AnkleRight = 18,
+	JointType_FootRight = 19,
+	JointType_SpineShoulder = 20,
+	JointType_HandTipLeft = 21,
+	JointType_ThumbLeft = 22,
+	JointType_HandTipRight = 23,
+	JointType_ThumbRight = 24,
+	JointType_Count = (JointType_ThumbRight + 1)
+} JointType;
+
+typedef enum _TrackingState {
+	TrackingState_NotTracked = 0,
+	TrackingState_Inferred = 1,
+	TrackingState_Tracked = 2
+} TrackingState;
+
+typedef struct _CameraSpacePoint {
+	float X;
+	float Y;
+	float Z;
+} CameraSpacePoint;
+
+typedef struct _Vector4 {
+	float x;
+	float y;
+	float z;
+	float w;
+} Vector4;
+
+// members named after their types as in Kinect.h, spelled with the enum tags so gcc accepts them
+typedef struct _Joint {
+	enum _JointType JointType;
+	CameraSpacePoint Position;
+	enum _TrackingState TrackingState;
+} Joint;
+
+typedef struct _JointOrientation {
+	enum _JointType JointType;
+	Vector4 Orientation;
+} JointOrientation;
+
+static_assert(sizeof(Joint) == 20, "Joint must match the Kinect SDK layout");
+static_assert(sizeof(JointOrientation) == 20, "JointOrientation must match the Kinect SDK layout");
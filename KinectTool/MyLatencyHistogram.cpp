@@ -0,0 +1,112 @@
+#include "MyLatencyHistogram.h"
+
+MyLatencyHistogram::MyLatencyHistogram()
+{
+	this->Reset();
+}
+
+void MyLatencyHistogram::Record(uint64_t nanoseconds)
+{
+	this->m_buckets[MyLatencyHistogram::Index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	this->m_count.fetch_add(1, std::memory_order_relaxed);
+	this->m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+	uint64_t max = this->m_max.load(std::memory_order_relaxed);
+	while (nanoseconds > max && !this->m_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MyLatencyHistogram::Reset()
+{
+	for (std::atomic<uint64_t>& bucket : this->m_buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	this->m_count = 0;
+	this->m_sum = 0;
+	this->m_max = 0;
+}
+
+uint64_t MyLatencyHistogram::getCount() const
+{
+	return this->m_count;
+}
+
+uint64_t MyLatencyHistogram::getMax() const
+{
+	return this->m_max;
+}
+
+double MyLatencyHistogram::getMean() const
+{
+	const uint64_t count = this->m_count;
+	return count ? (double)this->m_sum / count : 0.0;
+}
+
+uint64_t MyLatencyHistogram::Percentile(double p) const
+{
+	const uint64_t count = this->m_count;
+	if (count == 0)
+		return 0;
+
+	// rank of the value we are after, at least the first one
+	uint64_t rank = (uint64_t)(p / 100.0 * count + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; ++i)
+	{
+		seen += this->m_buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+		{
+			// never report more than was actually recorded
+			const uint64_t upper = MyLatencyHistogram::Upper(i);
+			const uint64_t max = this->m_max;
+			return upper < max ? upper : max;
+		}
+	}
+	return this->m_max;
+}
+
+void MyLatencyHistogram::Write(FILE* file, const char* name) const
+{
+	fprintf(file, "%s,count=%llu,mean_ns=%.0f,p50_ns=%llu,p90_ns=%llu,p99_ns=%llu,p999_ns=%llu,max_ns=%llu\n", name,
+		(unsigned long long)this->getCount(), this->getMean(),
+		(unsigned long long)this->Percentile(50.0), (unsigned long long)this->Percentile(90.0),
+		(unsigned long long)this->Percentile(99.0), (unsigned long long)this->Percentile(99.9),
+		(unsigned long long)this->getMax());
+
+	for (int i = 0; i < BUCKETS; ++i)
+	{
+		const uint64_t n = this->m_buckets[i].load(std::memory_order_relaxed);
+		if (n)
+			fprintf(file, "%s,%llu,%llu\n", name, (unsigned long long)MyLatencyHistogram::Upper(i), (unsigned long long)n);
+	}
+}
+
+int MyLatencyHistogram::Index(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+		return (int)value;
+
+	// highest set bit, then the SUB_BITS bits below it pick the bucket
+	int top = 0;
+	for (int step = 32; step > 0; step >>= 1)
+	{
+		if (value >> (top + step))
+			top += step;
+	}
+	const int shift = top - SUB_BITS;
+	return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t MyLatencyHistogram::Upper(int index)
+{
+	// largest value that lands in the bucket
+	if (index < SUB_BUCKETS)
+		return (uint64_t)index;
+
+	const int shift = index / SUB_BUCKETS - 1;
+	const uint64_t sub = (uint64_t)(index % SUB_BUCKETS) + SUB_BUCKETS;
+	return ((sub + 1) << shift) - 1;
+}
@@ -0,0 +1,49 @@
+#pragma once
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// Latency distribution in nanoseconds with a fixed relative error, in the spirit of HdrHistogram.
+// Values are bucketed by their highest bit and the SUB_BITS bits below it, so every bucket is at most
+// 1 / 2^SUB_BITS (~6%) wide relative to its value whatever the range, from nanoseconds to minutes.
+// Record() is three relaxed atomic adds (bucket, count, sum) and a load of the max, compare-exchanged
+// only when the value is a new max. Cheap enough for every frame and safe from any thread; readers see
+// a slightly stale picture, the count may briefly disagree with the buckets.
+class MyLatencyHistogram {
+public:		// data structures
+	static const int SUB_BITS = 4;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+private:	// variables
+	std::array<std::atomic<uint64_t>, BUCKETS> m_buckets;
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_sum;
+	std::atomic<uint64_t> m_max;
+
+public:		// functions
+
+	// constructer
+	MyLatencyHistogram();
+	MyLatencyHistogram(const MyLatencyHistogram&) = delete;
+	MyLatencyHistogram& operator=(const MyLatencyHistogram&) = delete;
+
+	// operations
+	void Record(uint64_t nanoseconds);
+	void Reset();
+
+	// get data, nanoseconds. Percentile() reports the top of the bucket, p in [0, 100]
+	uint64_t getCount() const;
+	uint64_t getMax() const;
+	double getMean() const;
+	uint64_t Percentile(double p) const;
+
+	// one summary line, then one line per non-empty bucket: name,upper_ns,count
+	void Write(FILE* file, const char* name) const;
+
+private:	// functions
+	static int Index(uint64_t value);
+	static uint64_t Upper(int index);
+};
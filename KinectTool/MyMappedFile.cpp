@@ -0,0 +1,120 @@
+#include "MyMappedFile.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MyMappedFile::MyMappedFile()
+{
+	this->m_data = nullptr;
+	this->m_size = 0;
+#if defined(_WIN32)
+	this->m_file = INVALID_HANDLE_VALUE;
+	this->m_mapping = NULL;
+#else
+	this->m_fd = -1;
+#endif
+}
+
+MyMappedFile::~MyMappedFile()
+{
+	this->Close();
+}
+
+bool MyMappedFile::Open(const char* path)
+{
+	this->Close();
+
+#if defined(_WIN32)
+	this->m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (this->m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->m_file, &size) || size.QuadPart == 0)
+	{
+		this->Close();
+		return false;
+	}
+
+	this->m_mapping = CreateFileMappingA(this->m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!this->m_mapping)
+	{
+		this->Close();
+		return false;
+	}
+
+	this->m_data = MapViewOfFile(this->m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!this->m_data)
+	{
+		this->Close();
+		return false;
+	}
+	this->m_size = (size_t)size.QuadPart;
+#else
+	this->m_fd = open(path, O_RDONLY);
+	if (this->m_fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(this->m_fd, &st) != 0 || st.st_size == 0)
+	{
+		this->Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, this->m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		this->Close();
+		return false;
+	}
+	this->m_data = data;
+	this->m_size = (size_t)st.st_size;
+#endif
+
+	return true;
+}
+
+void MyMappedFile::Close()
+{
+#if defined(_WIN32)
+	if (this->m_data)
+		UnmapViewOfFile(this->m_data);
+	if (this->m_mapping)
+		CloseHandle(this->m_mapping);
+	if (this->m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->m_file);
+	this->m_mapping = NULL;
+	this->m_file = INVALID_HANDLE_VALUE;
+#else
+	if (this->m_data)
+		munmap(const_cast<void*>(this->m_data), this->m_size);
+	if (this->m_fd >= 0)
+		close(this->m_fd);
+	this->m_fd = -1;
+#endif
+
+	this->m_data = nullptr;
+	this->m_size = 0;
+}
+
+bool MyMappedFile::isOpen() const
+{
+	return this->m_data != nullptr;
+}
+
+const void* MyMappedFile::data() const
+{
+	return this->m_data;
+}
+
+size_t MyMappedFile::size() const
+{
+	return this->m_size;
+}
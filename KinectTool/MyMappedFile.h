@@ -0,0 +1,33 @@
+#pragma once
+// std
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+class MyMappedFile {
+private:	// variables
+	const void* m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_fd;
+#endif
+
+public:		// functions
+
+	// constructer
+	MyMappedFile();
+	~MyMappedFile();
+	MyMappedFile(const MyMappedFile&) = delete;
+	MyMappedFile& operator=(const MyMappedFile&) = delete;
+
+	// operations
+	bool Open(const char* path);
+	void Close();
+
+	// get data
+	bool isOpen() const;
+	const void* data() const;
+	size_t size() const;
+};
@@ -0,0 +1,69 @@
+#include "MyMemorySink.h"
+
+#include <chrono>
+#include <thread>
+
+MyMemorySink::MyMemorySink(size_t capacity)
+{
+	this->m_capacity = capacity;
+	this->m_sent.reserve(capacity);
+	this->m_total = 0;
+	this->m_delay = 0;
+}
+
+bool MyMemorySink::Open()
+{
+	return true;
+}
+
+void MyMemorySink::Close()
+{
+}
+
+bool MyMemorySink::Send(int key, KEY_ACTION action)
+{
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (this->m_delay)
+		std::this_thread::sleep_for(std::chrono::microseconds(this->m_delay));
+
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	++this->m_total;
+	if (this->m_sent.size() < this->m_capacity)
+		this->m_sent.push_back({ key, action, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() });
+	return true;
+}
+
+void MyMemorySink::Clear()
+{
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	this->m_sent.clear();
+	this->m_total = 0;
+}
+
+void MyMemorySink::setDelay(uint32_t microseconds)
+{
+	this->m_delay = microseconds;
+}
+
+const char* MyMemorySink::getName() const
+{
+	return "memory";
+}
+
+size_t MyMemorySink::size() const
+{
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	return this->m_sent.size();
+}
+
+uint64_t MyMemorySink::getTotal() const
+{
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	return this->m_total;
+}
+
+std::vector<MyMemorySink::sent> MyMemorySink::getSent() const
+{
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	return this->m_sent;
+}
@@ -0,0 +1,49 @@
+#pragma once
+// my classes
+#include "MyKeySink.h"
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Keeps the keys it is given instead of sending them, for tests and headless runs.
+// Holds up to a fixed number of keys, later ones are counted but not kept. A delay per key can stand in
+// for a slow input path, to check that nothing upstream waits on it.
+class MyMemorySink : public MyKeySink {
+public:		// data structures
+	struct sent {
+		int key;
+		KEY_ACTION action;
+		uint64_t time;			// steady clock nanoseconds when Send() was called
+	};
+
+private:	// variables
+	mutable std::mutex m_mutex;
+	std::vector<sent> m_sent;			// reserved up front, Send() never allocates
+	size_t m_capacity;
+	uint64_t m_total;
+	std::atomic<uint32_t> m_delay;		// microseconds spent in every Send()
+
+public:		// functions
+
+	// constructer
+	MyMemorySink(size_t capacity = 4096);
+
+	// operations
+	bool Open();
+	void Close();
+	bool Send(int key, KEY_ACTION action);
+	void Clear();
+
+	// set data
+	void setDelay(uint32_t microseconds);
+
+	// get data, any thread
+	const char* getName() const;
+	size_t size() const;
+	uint64_t getTotal() const;			// keys sent, kept or not
+	std::vector<sent> getSent() const;
+};
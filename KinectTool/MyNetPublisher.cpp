@@ -0,0 +1,310 @@
+#include "MyNetPublisher.h"
+
+// my classes
+#include "MyFrameCodec.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static_assert(sizeof(MyNetPublisher::packet_header) == 24, "packet header must stay 24 bytes");
+static_assert(sizeof(MyNetPublisher::message_header) == 4, "message header must stay 4 bytes");
+static_assert(sizeof(MyNetPublisher::frame_message) == 32, "frame message must stay 32 bytes");
+static_assert(sizeof(MyNetPublisher::net_joint) == 16, "joint must stay 16 bytes");
+static_assert(sizeof(MyNetPublisher::event_message) == 32, "event message must stay 32 bytes");
+static_assert(sizeof(MyNetPublisher::packet_header) + sizeof(MyNetPublisher::message_header) + sizeof(MyNetPublisher::body_message) <= MyNetPublisher::MAX_DATAGRAM,
+	"a body must fit one datagram");
+
+MyNetPublisher::MyNetPublisher()
+{
+	this->m_thread = nullptr;
+	this->m_running = false;
+	this->m_busy = false;
+	this->m_finish = false;
+	this->m_subscriberCount = 0;
+
+	this->m_size = 0;
+	this->m_messages = 0;
+	this->m_sequence = 0;
+
+	this->m_datagrams = 0;
+	this->m_bytes = 0;
+	this->m_sentFrames = 0;
+	this->m_sentEvents = 0;
+	this->m_droppedEvents = 0;
+	this->m_sendErrors = 0;
+}
+
+MyNetPublisher::~MyNetPublisher()
+{
+	this->Stop();
+}
+
+bool MyNetPublisher::Start(const char* subscribers)
+{
+	if (this->m_thread)
+		return false;
+
+	// "host:port,host:port"
+	this->m_subscriberCount = 0;
+	const std::string list = subscribers;
+	size_t begin = 0;
+	while (begin < list.size() && this->m_subscriberCount < MAX_SUBSCRIBERS)
+	{
+		size_t end = list.find(',', begin);
+		if (end == std::string::npos)
+			end = list.size();
+
+		const std::string entry = list.substr(begin, end - begin);
+		if (!entry.empty() && !MyUdpSocket::Resolve(entry.c_str(), this->m_subscribers[this->m_subscriberCount++]))
+		{
+			printf("Bad subscriber: %s\n", entry.c_str());
+			--this->m_subscriberCount;
+		}
+		begin = end + 1;
+	}
+
+	if (this->m_subscriberCount == 0)
+	{
+		printf("No subscribers to stream to\n");
+		return false;
+	}
+	if (!this->m_socket.Open())
+	{
+		printf("Can't open a UDP socket\n");
+		return false;
+	}
+
+	this->m_size = 0;
+	this->m_messages = 0;
+	this->m_datagrams = 0;
+	this->m_bytes = 0;
+	this->m_sentFrames = 0;
+	this->m_sentEvents = 0;
+	this->m_droppedEvents = 0;
+	this->m_sendErrors = 0;
+
+	this->m_finish = false;
+	this->m_running = true;
+	this->m_thread = new std::thread(&MyNetPublisher::Sender, this);
+
+	printf("Streaming to %d subscribers\n", this->m_subscriberCount);
+	return true;
+}
+
+void MyNetPublisher::Stop()
+{
+	if (!this->m_thread)
+		return;
+
+	// what a late Push() or PushEvent() queued is sent before the sender leaves, not by the next Start()
+	this->m_running = false;
+	while (this->m_busy)
+		std::this_thread::yield();
+	this->m_finish = true;
+	this->m_frames.wake();
+	this->m_thread->join();
+	delete this->m_thread;
+	this->m_thread = nullptr;
+
+	this->m_socket.Close();
+
+	printf("Streaming stopped, %llu datagrams, %llu frames, %llu events.\n", (unsigned long long)this->m_datagrams.load(),
+		(unsigned long long)this->m_sentFrames.load(), (unsigned long long)this->m_sentEvents.load());
+}
+
+void MyNetPublisher::Push(const frame_data& frame)
+{
+	// seq_cst on both, so Stop() either sees m_busy or Push() sees m_running cleared
+	this->m_busy = true;
+	if (!this->m_running)
+	{
+		this->m_busy = false;
+		return;
+	}
+
+	frame_data* slot = this->m_frames.acquire();
+	if (slot)
+	{
+		CopyFrame(*slot, frame);
+		this->m_frames.commit();
+	}
+	this->m_busy.store(false, std::memory_order_release);
+}
+
+void MyNetPublisher::PushEvent(uint64_t id, uint64_t timestamp, uint64_t acquired, int key, int action)
+{
+	this->m_busy = true;
+	if (!this->m_running)
+	{
+		this->m_busy = false;
+		return;
+	}
+
+	const event_message event = { id, timestamp, acquired, key, action };
+	if (!this->m_events.push(event))
+		++this->m_droppedEvents;
+	this->m_busy.store(false, std::memory_order_release);
+}
+
+bool MyNetPublisher::isRunning() const
+{
+	return this->m_running;
+}
+
+int MyNetPublisher::getSubscribers() const
+{
+	return this->m_thread ? this->m_subscriberCount : 0;
+}
+
+uint64_t MyNetPublisher::getDatagrams() const
+{
+	return this->m_datagrams;
+}
+
+uint64_t MyNetPublisher::getBytes() const
+{
+	return this->m_bytes;
+}
+
+uint64_t MyNetPublisher::getSentFrames() const
+{
+	return this->m_sentFrames;
+}
+
+uint64_t MyNetPublisher::getSentEvents() const
+{
+	return this->m_sentEvents;
+}
+
+uint64_t MyNetPublisher::getDroppedFrames() const
+{
+	return this->m_frames.getDropped();
+}
+
+uint64_t MyNetPublisher::getDroppedEvents() const
+{
+	return this->m_droppedEvents;
+}
+
+uint64_t MyNetPublisher::getSendErrors() const
+{
+	return this->m_sendErrors;
+}
+
+void MyNetPublisher::Sender()
+{
+	while (true)
+	{
+		// read before the queues, everything queued before Stop() raised it is seen below
+		const bool finish = this->m_finish;
+		const frame_data* frame = this->m_frames.wait(WAIT_TIMEOUT);
+
+		// events first, they were raised while matching this frame or an earlier one
+		while (event_message* event = this->m_events.peek())
+		{
+			this->Pack(NET_EVENT, event, sizeof(*event));
+			this->m_events.release();
+			++this->m_sentEvents;
+		}
+
+		if (frame)
+		{
+			this->PackFrame(*frame);
+			this->m_frames.release();
+			++this->m_sentFrames;
+		}
+		else if (finish)
+		{
+			// drained
+			break;
+		}
+
+		// a batch is whatever queued up while the last one was sent, nothing waits for a datagram to fill
+		if (this->m_frames.size() == 0)
+			this->Flush();
+	}
+
+	this->Flush();
+}
+
+void MyNetPublisher::PackFrame(const frame_data& frame)
+{
+	frame_message header;
+	header.seq = frame.seq;
+	header.timestamp = frame.timestamp;
+	header.acquired = frame.acquired;
+	header.failed = frame.failed;
+	header.count = (uint32_t)frame.count;
+	this->Pack(NET_FRAME, &header, sizeof(header));
+
+	int32_t values[JOINTS][MyFrameCodec::CHANNELS];
+	body_message body;
+	for (int b = 0; b < frame.count; ++b)
+	{
+		body.seq = frame.seq;
+		body.id = frame.bodies[b].id;
+		body.index = (uint32_t)b;
+		body.joints = JOINTS;
+
+		// the codec's 0.1 mm positions to millimeters, +-32 m is more than any sensor sees
+		MyFrameCodec::Quantize(frame.bodies[b].skeleton, values);
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			net_joint& joint = body.joint[j];
+			for (int c = 0; c < 4; ++c)
+				joint.orientation[c] = (int16_t)values[j][c];
+			for (int c = 0; c < 3; ++c)
+				joint.position[c] = (int16_t)std::max(-32767, std::min(32767, values[j][4 + c] / 10));
+			joint.state = (uint8_t)values[j][7];
+			joint.reserved = 0;
+		}
+		this->Pack(NET_BODY, &body, sizeof(body));
+	}
+}
+
+void MyNetPublisher::Pack(NET_MESSAGE type, const void* message, size_t size)
+{
+	if (this->m_size + sizeof(message_header) + size > MAX_DATAGRAM)
+		this->Flush();
+
+	// room for the packet header, written by Flush()
+	if (this->m_size == 0)
+		this->m_size = sizeof(packet_header);
+
+	message_header header;
+	header.type = (uint8_t)type;
+	header.reserved = 0;
+	header.size = (uint16_t)size;
+	std::memcpy(&this->m_packet[this->m_size], &header, sizeof(header));
+	std::memcpy(&this->m_packet[this->m_size + sizeof(header)], message, size);
+	this->m_size += sizeof(header) + size;
+	++this->m_messages;
+}
+
+void MyNetPublisher::Flush()
+{
+	if (this->m_messages == 0)
+		return;
+
+	packet_header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.messages = this->m_messages;
+	header.sequence = this->m_sequence++;
+	header.sensor = SENSOR_TYPE;
+	header.sent = Now();
+	std::memcpy(this->m_packet.data(), &header, sizeof(header));
+
+	for (int s = 0; s < this->m_subscriberCount; ++s)
+	{
+		if (!this->m_socket.Send(this->m_subscribers[s], this->m_packet.data(), this->m_size))
+			++this->m_sendErrors;
+	}
+
+	++this->m_datagrams;
+	this->m_bytes += this->m_size;
+	this->m_size = 0;
+	this->m_messages = 0;
+}
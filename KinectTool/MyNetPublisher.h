@@ -0,0 +1,143 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MyUdpSocket.h"
+#include "MyStageQueue.h"
+#include "MySpscQueue.h"
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+typedef enum {
+	NET_FRAME = 1,		// frame_message, followed by its bodies
+	NET_BODY,			// body_message
+	NET_EVENT			// event_message
+}NET_MESSAGE;
+
+// Streams matched frames and key events over UDP to the machines showing them or running the game.
+// Push() and PushEvent() only copy into queues, a sender thread packs whatever is waiting into datagrams of at
+// most MAX_DATAGRAM bytes (below the Ethernet MTU, so nothing is fragmented) and sends each datagram to every
+// subscriber. Joints travel quantized: orientation to 1/32767, position to millimeters. A frame that does not fit
+// one datagram continues in the next, the receiver (MyNetReceiver) puts it back together and counts the gaps.
+//
+// datagram: packet_header, then `messages` times (message_header, message)
+class MyNetPublisher {
+public:		// data structures
+	static constexpr char MAGIC[4] = { 'K', 'T', 'N', 'P' };
+	static const uint16_t VERSION = 1;
+	static const size_t MAX_DATAGRAM = 1400;
+	static const int MAX_SUBSCRIBERS = 8;
+	static const size_t FRAME_QUEUE = 8;
+	static const size_t EVENT_QUEUE = 256;
+	static const uint32_t WAIT_TIMEOUT = 10;		// milliseconds the sender sleeps without frames, events still go out
+
+	struct packet_header {
+		char magic[4];				// "KTNP"
+		uint16_t version;
+		uint16_t messages;
+		uint32_t sequence;			// +1 per datagram, gaps are lost datagrams
+		uint32_t sensor;			// SENSOR_K4W or SENSOR_K4A
+		uint64_t sent;				// steady clock nanoseconds
+	};
+
+	struct message_header {
+		uint8_t type;				// NET_MESSAGE
+		uint8_t reserved;
+		uint16_t size;				// message after this header
+	};
+
+	struct frame_message {
+		uint64_t seq;
+		uint64_t timestamp;			// sensor time, microseconds
+		uint64_t acquired;			// steady clock nanoseconds when the sensor host got the frame
+		int32_t failed;
+		uint32_t count;				// body_message that follow
+	};
+
+	struct net_joint {
+		int16_t orientation[4];		// w, x, y, z times 32767
+		int16_t position[3];		// millimeters
+		uint8_t state;				// tracking state or confidence
+		uint8_t reserved;
+	};
+
+	struct body_message {
+		uint64_t seq;				// frame it belongs to
+		uint64_t id;
+		uint32_t index;				// in the frame
+		uint32_t joints;
+		net_joint joint[JOINTS];
+	};
+
+	struct event_message {
+		uint64_t id;				// body that triggered it
+		uint64_t timestamp;			// sensor time of the frame
+		uint64_t acquired;
+		int32_t key;
+		int32_t action;				// KEY_ACTION
+	};
+
+private:	// variables
+	std::thread* m_thread;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_busy;				// Push() or PushEvent() is queueing, Stop() waits for it
+	std::atomic<bool> m_finish;				// nothing more is queued, the sender drains and leaves
+	MyUdpSocket m_socket;
+	std::array<MyUdpSocket::address, MAX_SUBSCRIBERS> m_subscribers;
+	int m_subscriberCount;
+
+	// match stage -> sender, the newest frames matter most
+	MyStageQueue<frame_data, FRAME_QUEUE> m_frames;
+	MySpscQueue<event_message, EVENT_QUEUE> m_events;
+
+	// sender thread only
+	std::array<uint8_t, MAX_DATAGRAM> m_packet;
+	size_t m_size;
+	uint16_t m_messages;
+	uint32_t m_sequence;
+
+	// statistics
+	std::atomic<uint64_t> m_datagrams;
+	std::atomic<uint64_t> m_bytes;
+	std::atomic<uint64_t> m_sentFrames;
+	std::atomic<uint64_t> m_sentEvents;
+	std::atomic<uint64_t> m_droppedEvents;
+	std::atomic<uint64_t> m_sendErrors;
+
+public:		// functions
+
+	// constructer
+	MyNetPublisher();
+	~MyNetPublisher();
+
+	// operations
+	// subscribers as "host:port,host:port"
+	bool Start(const char* subscribers);
+	void Stop();
+
+	// match stage, never blocks, a full queue drops the oldest frame or the new event
+	void Push(const frame_data& frame);
+	void PushEvent(uint64_t id, uint64_t timestamp, uint64_t acquired, int key, int action);
+
+	// get data
+	bool isRunning() const;
+	int getSubscribers() const;
+	uint64_t getDatagrams() const;
+	uint64_t getBytes() const;
+	uint64_t getSentFrames() const;
+	uint64_t getSentEvents() const;
+	uint64_t getDroppedFrames() const;
+	uint64_t getDroppedEvents() const;
+	uint64_t getSendErrors() const;
+
+private:	// functions
+	void Sender();
+	void PackFrame(const frame_data& frame);
+	void Pack(NET_MESSAGE type, const void* message, size_t size);
+	void Flush();
+};
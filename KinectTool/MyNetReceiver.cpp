@@ -0,0 +1,279 @@
+#include "MyNetReceiver.h"
+
+// my classes
+#include "MyFrameCodec.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+MyNetReceiver::MyNetReceiver()
+{
+	this->m_thread = nullptr;
+	this->m_running = false;
+
+	this->m_expected = 0;
+	this->m_synced = false;
+	this->m_bodies = 0;
+	this->m_assembling = false;
+
+	this->m_datagrams = 0;
+	this->m_lost = 0;
+	this->m_late = 0;
+	this->m_bad = 0;
+	this->m_complete = 0;
+	this->m_incomplete = 0;
+	this->m_receivedEvents = 0;
+	this->m_droppedEvents = 0;
+}
+
+MyNetReceiver::~MyNetReceiver()
+{
+	this->Stop();
+}
+
+bool MyNetReceiver::Start(uint16_t port)
+{
+	if (this->m_thread)
+		return false;
+
+	if (!this->m_socket.Open(port))
+	{
+		printf("Can't listen on UDP port %u\n", (unsigned)port);
+		return false;
+	}
+
+	this->m_synced = false;
+	this->m_assembling = false;
+	this->m_datagrams = 0;
+	this->m_lost = 0;
+	this->m_late = 0;
+	this->m_bad = 0;
+	this->m_complete = 0;
+	this->m_incomplete = 0;
+	this->m_receivedEvents = 0;
+	this->m_droppedEvents = 0;
+	this->m_latency.Reset();
+	this->m_transit.Reset();
+
+	this->m_running = true;
+	this->m_thread = new std::thread(&MyNetReceiver::Receiver, this);
+
+	printf("Receiving on UDP port %u\n", (unsigned)port);
+	return true;
+}
+
+void MyNetReceiver::Stop()
+{
+	if (!this->m_thread)
+		return;
+
+	this->m_running = false;
+	this->m_thread->join();
+	delete this->m_thread;
+	this->m_thread = nullptr;
+
+	this->m_socket.Close();
+
+	printf("Receiving stopped, %llu datagrams, %llu lost, %llu frames.\n", (unsigned long long)this->m_datagrams.load(),
+		(unsigned long long)this->m_lost.load(), (unsigned long long)this->m_complete.load());
+}
+
+bool MyNetReceiver::Update()
+{
+	return this->m_frames.update();
+}
+
+const frame_data& MyNetReceiver::getFrame() const
+{
+	return this->m_frames.front();
+}
+
+bool MyNetReceiver::PopEvent(event_message& event)
+{
+	return this->m_events.pop(event);
+}
+
+bool MyNetReceiver::isRunning() const
+{
+	return this->m_running;
+}
+
+uint64_t MyNetReceiver::getDatagrams() const
+{
+	return this->m_datagrams;
+}
+
+uint64_t MyNetReceiver::getLost() const
+{
+	return this->m_lost;
+}
+
+uint64_t MyNetReceiver::getLate() const
+{
+	return this->m_late;
+}
+
+uint64_t MyNetReceiver::getBad() const
+{
+	return this->m_bad;
+}
+
+uint64_t MyNetReceiver::getCompleteFrames() const
+{
+	return this->m_complete;
+}
+
+uint64_t MyNetReceiver::getIncompleteFrames() const
+{
+	return this->m_incomplete;
+}
+
+uint64_t MyNetReceiver::getEvents() const
+{
+	return this->m_receivedEvents;
+}
+
+uint64_t MyNetReceiver::getDroppedEvents() const
+{
+	return this->m_droppedEvents;
+}
+
+double MyNetReceiver::getLossRate() const
+{
+	const double total = (double)(this->m_datagrams + this->m_lost);
+	return total > 0.0 ? this->m_lost / total : 0.0;
+}
+
+const MyLatencyHistogram& MyNetReceiver::getLatency() const
+{
+	return this->m_latency;
+}
+
+const MyLatencyHistogram& MyNetReceiver::getTransit() const
+{
+	return this->m_transit;
+}
+
+void MyNetReceiver::Receiver()
+{
+	std::array<uint8_t, 65536> packet;
+	while (this->m_running)
+	{
+		const int size = this->m_socket.Receive(packet.data(), packet.size(), RECEIVE_TIMEOUT);
+		if (size <= 0)
+			continue;
+		this->Parse(packet.data(), (size_t)size, Now());
+	}
+}
+
+void MyNetReceiver::Parse(const uint8_t* data, size_t size, uint64_t received)
+{
+	MyNetPublisher::packet_header packet;
+	if (size < sizeof(packet))
+	{
+		++this->m_bad;
+		return;
+	}
+	std::memcpy(&packet, data, sizeof(packet));
+	if (std::memcmp(packet.magic, MyNetPublisher::MAGIC, sizeof(MyNetPublisher::MAGIC)) != 0 ||
+		packet.version != MyNetPublisher::VERSION || packet.sensor != SENSOR_TYPE)
+	{
+		++this->m_bad;
+		return;
+	}
+
+	// a publisher that started over shows up as a jump back, take it as the new start
+	const int32_t gap = (int32_t)(packet.sequence - this->m_expected);
+	if (this->m_synced && gap < 0 && gap > -1000)
+	{
+		++this->m_late;
+		return;
+	}
+	if (this->m_synced && gap > 0)
+		this->m_lost += (uint64_t)gap;
+	this->m_expected = packet.sequence + 1;
+	this->m_synced = true;
+
+	++this->m_datagrams;
+	this->m_transit.Record(received > packet.sent ? received - packet.sent : 0);
+
+	size_t offset = sizeof(packet);
+	for (int m = 0; m < packet.messages; ++m)
+	{
+		MyNetPublisher::message_header header;
+		if (offset + sizeof(header) > size)
+			break;
+		std::memcpy(&header, data + offset, sizeof(header));
+		offset += sizeof(header);
+		if (offset + header.size > size)
+			break;
+		const uint8_t* message = data + offset;
+		offset += header.size;
+
+		if (header.type == NET_FRAME && header.size == sizeof(MyNetPublisher::frame_message))
+		{
+			MyNetPublisher::frame_message frame;
+			std::memcpy(&frame, message, sizeof(frame));
+
+			// the last frame never got all its bodies
+			if (this->m_assembling)
+				++this->m_incomplete;
+
+			frame_data& current = this->m_frames.back();
+			current.seq = frame.seq;
+			current.timestamp = frame.timestamp;
+			current.acquired = frame.acquired;
+			current.failed = frame.failed;
+			current.count = (int)std::min<uint32_t>(frame.count, MAX_BODIES);
+			this->m_bodies = 0;
+			this->m_assembling = true;
+			if (current.count == 0)
+				this->Finish(received);
+		}
+		else if (header.type == NET_BODY && header.size == sizeof(MyNetPublisher::body_message))
+		{
+			MyNetPublisher::body_message body;
+			std::memcpy(&body, message, sizeof(body));
+
+			frame_data& current = this->m_frames.back();
+			if (!this->m_assembling || body.seq != current.seq || body.index >= (uint32_t)current.count || body.joints != JOINTS)
+				continue;
+
+			int32_t values[JOINTS][MyFrameCodec::CHANNELS];
+			for (int j = 0; j < JOINTS; ++j)
+			{
+				const MyNetPublisher::net_joint& joint = body.joint[j];
+				for (int c = 0; c < 4; ++c)
+					values[j][c] = joint.orientation[c];
+				for (int c = 0; c < 3; ++c)
+					values[j][4 + c] = joint.position[c] * 10;
+				values[j][7] = joint.state;
+			}
+			current.bodies[body.index].id = body.id;
+			MyFrameCodec::Dequantize(values, current.bodies[body.index].skeleton);
+
+			this->m_bodies |= 1u << body.index;
+			if (this->m_bodies == (1u << current.count) - 1)
+				this->Finish(received);
+		}
+		else if (header.type == NET_EVENT && header.size == sizeof(event_message))
+		{
+			event_message event;
+			std::memcpy(&event, message, sizeof(event));
+			++this->m_receivedEvents;
+			if (!this->m_events.push(event))
+				++this->m_droppedEvents;
+		}
+	}
+}
+
+void MyNetReceiver::Finish(uint64_t received)
+{
+	const uint64_t acquired = this->m_frames.back().acquired;
+	this->m_latency.Record(received > acquired ? received - acquired : 0);
+
+	this->m_frames.publish();
+	this->m_assembling = false;
+	++this->m_complete;
+}
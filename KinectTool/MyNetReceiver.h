@@ -0,0 +1,89 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MyNetPublisher.h"
+#include "MyUdpSocket.h"
+#include "MyTripleBuffer.h"
+#include "MySpscQueue.h"
+#include "MyLatencyHistogram.h"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Receives what MyNetPublisher streams and puts the frames back together on a thread of its own.
+// A frame is handed out once all its bodies arrived, a frame missing a body (its datagram was lost) is
+// counted incomplete and skipped. Gaps in the datagram sequence count as lost, datagrams arriving after a
+// later one as late, those are dropped. Latency is measured against the sensor host's steady clock, so it is
+// exact on the same machine (loopback) and only meaningful across machines with synchronized clocks.
+class MyNetReceiver {
+public:		// data structures
+	static const size_t EVENT_QUEUE = 256;
+	static const uint32_t RECEIVE_TIMEOUT = 100;	// milliseconds between checks for Stop()
+
+	typedef MyNetPublisher::event_message event_message;
+
+private:	// variables
+	std::thread* m_thread;
+	std::atomic<bool> m_running;
+	MyUdpSocket m_socket;
+
+	// receiver thread -> any one consumer thread
+	MyTripleBuffer<frame_data> m_frames;
+	MySpscQueue<event_message, EVENT_QUEUE> m_events;
+
+	// receiver thread only
+	uint32_t m_expected;				// next datagram sequence
+	bool m_synced;						// m_expected is valid
+	uint32_t m_bodies;					// bit per body of the frame in m_frames.back() received so far
+	bool m_assembling;					// m_frames.back() waits for bodies
+
+	// statistics
+	std::atomic<uint64_t> m_datagrams;
+	std::atomic<uint64_t> m_lost;
+	std::atomic<uint64_t> m_late;
+	std::atomic<uint64_t> m_bad;		// not a datagram of ours, or cut short
+	std::atomic<uint64_t> m_complete;
+	std::atomic<uint64_t> m_incomplete;
+	std::atomic<uint64_t> m_receivedEvents;
+	std::atomic<uint64_t> m_droppedEvents;
+	MyLatencyHistogram m_latency;		// acquired on the sensor host -> frame complete here
+	MyLatencyHistogram m_transit;		// datagram sent -> received
+
+public:		// functions
+
+	// constructer
+	MyNetReceiver();
+	~MyNetReceiver();
+
+	// operations
+	bool Start(uint16_t port);
+	void Stop();
+
+	// consumer side: Update() takes the newest complete frame, false if none arrived since the last call
+	bool Update();
+	const frame_data& getFrame() const;
+	bool PopEvent(event_message& event);
+
+	// get data
+	bool isRunning() const;
+	uint64_t getDatagrams() const;
+	uint64_t getLost() const;
+	uint64_t getLate() const;
+	uint64_t getBad() const;
+	uint64_t getCompleteFrames() const;
+	uint64_t getIncompleteFrames() const;
+	uint64_t getEvents() const;
+	uint64_t getDroppedEvents() const;
+	double getLossRate() const;			// lost / (received + lost)
+	const MyLatencyHistogram& getLatency() const;
+	const MyLatencyHistogram& getTransit() const;
+
+private:	// functions
+	void Receiver();
+	void Parse(const uint8_t* data, size_t size, uint64_t received);
+	void Finish(uint64_t received);
+};
@@ -0,0 +1,374 @@
+#include "MyPoseIndex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+static const int LEAF_SIZE = 16;				// poses scanned linearly at the bottom of the tree
+static const size_t MIN_INDEXED = 2048;			// below this the SIMD scan of the library is faster
+static const size_t MIN_PENDING = 64;			// poses appended before a rebuild is considered
+static const float MAX_VISITED = 0.25f;			// fraction of the library a query may touch before the tree is not worth it
+static const int PROBE_INTERVAL = 64;			// queries between two attempts to use the tree again
+static const float INF = std::numeric_limits<float>::infinity();
+
+static std::atomic<uint64_t> builds(0);
+
+MyPoseIndex::MyPoseIndex()
+{
+	this->m_mask.fill(0);
+	this->m_joints.fill(0);
+	this->m_jointCount = 0;
+
+	this->m_indexed = 0;
+	this->m_synced = 0;
+	this->m_generation = 0;
+	this->m_build = ++builds;
+}
+
+void MyPoseIndex::Build(const MyPoseLibrary& library, const std::array<bool, JOINTS>& mask, const MyPoseIndex* previous)
+{
+	// a new mask is a new metric, another library has other pose ids, both start over
+	if (previous && previous->m_mask == mask && previous->m_generation == library.generation() && previous->m_synced <= library.size())
+	{
+		this->m_nodes = previous->m_nodes;
+		this->m_items = previous->m_items;
+		this->m_features = previous->m_features;
+		this->m_valid = previous->m_valid;
+		this->m_mask = previous->m_mask;
+		this->m_joints = previous->m_joints;
+		this->m_jointCount = previous->m_jointCount;
+		this->m_indexed = previous->m_indexed;
+		this->m_synced = previous->m_synced;
+	}
+	else
+	{
+		this->m_mask = mask;
+		this->m_jointCount = 0;
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			if (mask[j])
+				this->m_joints[this->m_jointCount++] = j;
+		}
+		this->m_indexed = 0;
+		this->m_synced = 0;
+	}
+	this->m_generation = library.generation();
+
+	// copy the enabled joints of new poses next to each other
+	this->m_features.reserve(library.size() * this->m_jointCount * 4);
+	this->m_valid.reserve(library.size());
+	for (size_t p = this->m_synced; p < library.size(); ++p)
+	{
+		uint8_t valid = 1;
+		for (int k = 0; k < this->m_jointCount; ++k)
+		{
+			float q[4];
+			library.getOrientation(p, this->m_joints[k], q);
+			this->m_features.insert(this->m_features.end(), q, q + 4);
+			valid &= library.isTracked(p, this->m_joints[k]) ? 1 : 0;
+		}
+		this->m_valid.push_back(valid);
+	}
+	this->m_synced = library.size();
+
+	const size_t pending = this->m_synced - this->m_indexed;
+	if (pending > std::max(MIN_PENDING, this->m_indexed / 8))
+		this->Rebuild();
+}
+
+bool MyPoseIndex::Prepare(const MyPoseLibrary& library, usage& use) const
+{
+	if (use.build != this->m_build)
+	{
+		use.build = this->m_build;
+		use.visitedRatio = 0.0f;
+		use.probeCountdown = 0;
+	}
+
+	// small library or no joint to compare, the tree can not beat the batched scan
+	if (library.size() < MIN_INDEXED || this->m_jointCount == 0)
+		return false;
+
+	// built for another library, the scan is always right
+	if (library.generation() != this->m_generation || library.size() != this->m_synced)
+		return false;
+
+	// the tree visited most of the library recently, only probe it from time to time
+	if (use.visitedRatio > MAX_VISITED)
+	{
+		if (--use.probeCountdown > 0)
+			return false;
+		use.probeCountdown = PROBE_INTERVAL;
+	}
+	return true;
+}
+
+MyPoseLibrary::match MyPoseIndex::Match(const MyPoseLibrary& library, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, bool useTree, MyPoseLibrary::scratch& work) const
+{
+	if (!useTree)
+		return library.Match(skeleton, mask, thresh, work);
+
+	int pose = -1;
+	float distance = INF;
+	size_t visited = 0;
+	float query[JOINTS * 4];
+	if (!this->Query(skeleton, query) || this->Closest(query, 1, &pose, &distance, visited) == 0)
+	{
+		// lost an enabled joint, let the library report which one
+		return library.Match(skeleton, mask, thresh, work);
+	}
+	work.visited += visited;
+	++work.queries;
+
+	MyPoseLibrary::match result = { -1, pose, -1, distance, thresh - distance };
+	if (distance <= thresh)
+		result.pose = pose;
+	else
+		result.failed = library.WorstJoint(pose, skeleton, mask, thresh);
+	return result;
+}
+
+void MyPoseIndex::Merge(const MyPoseLibrary& library, MyPoseLibrary::scratch& work, usage& use) const
+{
+	library.Merge(work);
+
+	if (work.queries > 0)
+		this->Visited((size_t)work.visited, (size_t)work.queries, use);
+	work.visited = 0;
+	work.queries = 0;
+}
+
+bool MyPoseIndex::Within(const skeleton_data& skeleton, float thresh, std::vector<int>& poses) const
+{
+	float query[JOINTS * 4];
+	if (!this->Query(skeleton, query))
+		return false;
+
+	size_t visited = 0;
+	if (!this->m_nodes.empty())
+		this->SearchWithin(0, query, thresh, poses, visited);
+
+	// appended since the last build
+	for (size_t p = this->m_indexed; p < this->m_synced; ++p)
+	{
+		if (!this->m_valid[p])
+			continue;
+
+		++visited;
+		if (this->Distance(query, (int)p, thresh) <= thresh)
+			poses.push_back((int)p);
+	}
+	return true;
+}
+
+size_t MyPoseIndex::Nearest(const skeleton_data& skeleton, size_t k, int* poses, float* distances) const
+{
+	float query[JOINTS * 4];
+	if (k == 0 || !this->Query(skeleton, query))
+		return 0;
+
+	size_t visited = 0;
+	return this->Closest(query, k, poses, distances, visited);
+}
+
+size_t MyPoseIndex::getIndexed() const
+{
+	return this->m_indexed;
+}
+
+bool MyPoseIndex::isBuiltFor(const MyPoseLibrary& library, const std::array<bool, JOINTS>& mask) const
+{
+	return library.generation() == this->m_generation && library.size() == this->m_synced && mask == this->m_mask;
+}
+
+void MyPoseIndex::Rebuild()
+{
+	this->m_items.clear();
+	for (size_t p = 0; p < this->m_synced; ++p)
+	{
+		if (this->m_valid[p])
+			this->m_items.push_back((int)p);
+	}
+
+	this->m_nodes.clear();
+	std::vector<std::pair<float, int>> order(this->m_items.size());
+	if (!this->m_items.empty())
+		this->Split(0, (int)this->m_items.size(), order);
+
+	this->m_indexed = this->m_synced;
+}
+
+int MyPoseIndex::Split(int begin, int end, std::vector<std::pair<float, int>>& order)
+{
+	const int index = (int)this->m_nodes.size();
+	this->m_nodes.push_back({ -1, 0.0f, -1, -1, begin, end });
+	if (end - begin <= LEAF_SIZE)
+		return index;
+
+	// middle element as vantage point, the order of m_items is arbitrary anyway
+	std::swap(this->m_items[begin], this->m_items[begin + (end - begin) / 2]);
+	const int vantage = this->m_items[begin];
+	const float* feature = &this->m_features[(size_t)vantage * this->m_jointCount * 4];
+
+	std::pair<float, int>* distances = &order[begin + 1];
+	const int count = end - begin - 1;
+	for (int i = 0; i < count; ++i)
+		distances[i] = { this->Distance(feature, this->m_items[begin + 1 + i], INF), this->m_items[begin + 1 + i] };
+
+	// split at the median distance, the median and its ties end up outside
+	const int half = count / 2;
+	std::nth_element(distances, distances + half, distances + count);
+	for (int i = 0; i < count; ++i)
+		this->m_items[begin + 1 + i] = distances[i].second;
+
+	const float radius = distances[half].first;
+	const int inside = this->Split(begin + 1, begin + 1 + half, order);
+	const int outside = this->Split(begin + 1 + half, end, order);
+
+	node& n = this->m_nodes[index];
+	n.vantage = vantage;
+	n.radius = radius;
+	n.inside = inside;
+	n.outside = outside;
+	return index;
+}
+
+bool MyPoseIndex::Query(const skeleton_data& skeleton, float* query) const
+{
+	for (int k = 0; k < this->m_jointCount; ++k)
+	{
+		if (!IsJointTracked(skeleton, this->m_joints[k]))
+			return false;
+		GetJointOrientation(skeleton, this->m_joints[k], query + k * 4);
+	}
+	return true;
+}
+
+float MyPoseIndex::Distance(const float* query, int pose, float bound) const
+{
+	// largest joint distance, gives up as soon as one joint is over the bound
+	const float* p = &this->m_features[(size_t)pose * this->m_jointCount * 4];
+	const float bound2 = bound * bound;
+	float worst = 0.0f;
+	for (int k = 0; k < this->m_jointCount; ++k)
+	{
+		const float* a = p + k * 4;
+		const float* b = query + k * 4;
+		float mag = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]) + (a[3] - b[3]) * (a[3] - b[3]);
+		if (mag > worst)
+		{
+			worst = mag;
+			if (worst > bound2)
+				break;
+		}
+	}
+	return std::sqrt(worst);
+}
+
+size_t MyPoseIndex::Closest(const float* query, size_t k, int* poses, float* distances, size_t& visited) const
+{
+	size_t found = 0;
+	float tau = INF;
+	if (!this->m_nodes.empty())
+		this->SearchNearest(0, query, k, poses, distances, found, tau, visited);
+
+	// appended since the last build
+	for (size_t p = this->m_indexed; p < this->m_synced; ++p)
+	{
+		if (!this->m_valid[p])
+			continue;
+
+		++visited;
+		float d = this->Distance(query, (int)p, tau);
+		if (d < tau)
+			MyPoseIndex::Insert((int)p, d, k, poses, distances, found, tau);
+	}
+	return found;
+}
+
+void MyPoseIndex::Visited(size_t visited, size_t queries, usage& use) const
+{
+	// one step of the moving average per query, they all saw the same library
+	const float ratio = (float)visited / (float)(queries * std::max<size_t>(this->m_synced, 1));
+	for (size_t q = 0; q < queries; ++q)
+		use.visitedRatio = use.visitedRatio * 0.9f + ratio * 0.1f;
+}
+
+void MyPoseIndex::SearchWithin(int n, const float* query, float thresh, std::vector<int>& poses, size_t& visited) const
+{
+	const node& nd = this->m_nodes[n];
+	if (nd.vantage < 0)
+	{
+		for (int i = nd.begin; i < nd.end; ++i)
+		{
+			++visited;
+			if (this->Distance(query, this->m_items[i], thresh) <= thresh)
+				poses.push_back(this->m_items[i]);
+		}
+		return;
+	}
+
+	++visited;
+	const float d = this->Distance(query, nd.vantage, INF);
+	if (d <= thresh)
+		poses.push_back(nd.vantage);
+
+	if (d - thresh <= nd.radius)
+		this->SearchWithin(nd.inside, query, thresh, poses, visited);
+	if (d + thresh >= nd.radius)
+		this->SearchWithin(nd.outside, query, thresh, poses, visited);
+}
+
+void MyPoseIndex::SearchNearest(int n, const float* query, size_t k, int* poses, float* distances, size_t& found, float& tau, size_t& visited) const
+{
+	const node& nd = this->m_nodes[n];
+	if (nd.vantage < 0)
+	{
+		for (int i = nd.begin; i < nd.end; ++i)
+		{
+			++visited;
+			float d = this->Distance(query, this->m_items[i], tau);
+			if (d < tau)
+				MyPoseIndex::Insert(this->m_items[i], d, k, poses, distances, found, tau);
+		}
+		return;
+	}
+
+	++visited;
+	const float d = this->Distance(query, nd.vantage, INF);
+	if (d < tau)
+		MyPoseIndex::Insert(nd.vantage, d, k, poses, distances, found, tau);
+
+	// the side the query falls in first, it is the most likely to shrink tau
+	if (d <= nd.radius)
+	{
+		this->SearchNearest(nd.inside, query, k, poses, distances, found, tau, visited);
+		if (d + tau >= nd.radius)
+			this->SearchNearest(nd.outside, query, k, poses, distances, found, tau, visited);
+	}
+	else
+	{
+		this->SearchNearest(nd.outside, query, k, poses, distances, found, tau, visited);
+		if (d - tau <= nd.radius)
+			this->SearchNearest(nd.inside, query, k, poses, distances, found, tau, visited);
+	}
+}
+
+void MyPoseIndex::Insert(int pose, float dist, size_t k, int* poses, float* distances, size_t& found, float& tau)
+{
+	// keep the k best sorted, k is small
+	size_t i = found < k ? found++ : k - 1;
+	while (i > 0 && distances[i - 1] > dist)
+	{
+		poses[i] = poses[i - 1];
+		distances[i] = distances[i - 1];
+		--i;
+	}
+	poses[i] = pose;
+	distances[i] = dist;
+
+	if (found == k)
+		tau = distances[k - 1];
+}
@@ -0,0 +1,92 @@
+#pragma once
+// my classes
+#include "MyPoseLibrary.h"
+
+// std
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Vantage-point tree over the saved poses for libraries too large to scan every frame.
+// The metric is the one the matcher uses: the largest quaternion distance over the enabled joints,
+// so the tree is tied to the joint mask it was built with. An index is built once, on the thread that changes
+// the library or the mask, and never changes afterwards, so the matching threads read it without a lock.
+// Building from the index of an earlier copy of the same library under the same mask only adds the poses
+// appended since: they are kept in a pending list that is scanned linearly until it grows large enough to
+// be worth a new tree.
+class MyPoseIndex {
+public:		// data structures
+	// how much of the library the tree visited lately, kept by the thread that matches, not by the index
+	struct usage {
+		uint64_t build;			// index the numbers belong to, they start over with another one
+		float visitedRatio;
+		int probeCountdown;
+	};
+
+private:	// data structures
+	struct node {
+		int vantage;		// pose used as the vantage point, -1 for a leaf
+		float radius;		// median distance from the vantage point
+		int inside;			// child with distance <= radius
+		int outside;		// child with distance >= radius, the median pose and its ties go here
+		int begin;			// leaf: range in m_items
+		int end;
+	};
+
+private:	// variables
+	std::vector<node> m_nodes;
+	std::vector<int> m_items;			// pose ids, reordered by the build
+	std::vector<float> m_features;		// per pose, the enabled joints as w, x, y, z
+	std::vector<uint8_t> m_valid;		// 0 if the pose has an untracked enabled joint and can never match
+
+	std::array<bool, JOINTS> m_mask;
+	std::array<int, JOINTS> m_joints;	// enabled joints in order
+	int m_jointCount;
+
+	size_t m_indexed;					// poses inside the tree
+	size_t m_synced;					// poses with features, the library size when built
+	uint64_t m_generation;				// library generation the features belong to
+	uint64_t m_build;					// unique per built index, for usage
+
+public:		// functions
+
+	// constructer
+	MyPoseIndex();
+	MyPoseIndex(const MyPoseIndex&) = delete;
+	MyPoseIndex& operator=(const MyPoseIndex&) = delete;
+
+	// operations
+	// indexes the library under the mask, extending previous when it indexes an earlier copy of the same library
+	// under the same mask. Only before the index is shared
+	void Build(const MyPoseLibrary& library, const std::array<bool, JOINTS>& mask, const MyPoseIndex* previous = nullptr);
+
+	// matching for several threads: Prepare decides whether the tree is used this frame, then any number of threads
+	// may call Match with their own scratch, and Merge folds the scratches back into the library statistics and use
+	// once they are all done. The library and mask must be the ones the index was built for
+	bool Prepare(const MyPoseLibrary& library, usage& use) const;
+	MyPoseLibrary::match Match(const MyPoseLibrary& library, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, bool useTree, MyPoseLibrary::scratch& work) const;
+	void Merge(const MyPoseLibrary& library, MyPoseLibrary::scratch& work, usage& use) const;
+
+	// every pose whose distance is <= thresh, returns false if the skeleton lost an enabled joint
+	bool Within(const skeleton_data& skeleton, float thresh, std::vector<int>& poses) const;
+
+	// up to k closest poses sorted by distance, returns how many were found
+	size_t Nearest(const skeleton_data& skeleton, size_t k, int* poses, float* distances) const;
+
+	// get data
+	size_t getIndexed() const;
+	bool isBuiltFor(const MyPoseLibrary& library, const std::array<bool, JOINTS>& mask) const;
+
+private:	// functions
+	void Rebuild();
+	int Split(int begin, int end, std::vector<std::pair<float, int>>& order);
+	bool Query(const skeleton_data& skeleton, float* query) const;
+	float Distance(const float* query, int pose, float bound) const;
+	size_t Closest(const float* query, size_t k, int* poses, float* distances, size_t& visited) const;
+	void Visited(size_t visited, size_t queries, usage& use) const;
+
+	void SearchWithin(int n, const float* query, float thresh, std::vector<int>& poses, size_t& visited) const;
+	void SearchNearest(int n, const float* query, size_t k, int* poses, float* distances, size_t& found, float& tau, size_t& visited) const;
+	static void Insert(int pose, float dist, size_t k, int* poses, float* distances, size_t& found, float& tau);
+};
@@ -0,0 +1,1113 @@
+#include "MyPoseLibrary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <new>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define KT_TARGET_AVX2
+#else
+#define KT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+static const size_t ALIGNMENT = alignof(MyPoseLibrary::block);
+static const char MAGIC[4] = { 'K', 'T', 'P', 'L' };
+static const float UNTRACKED = 1e30f;	// squared distance added for joints the pose has no data for
+static const float UNSCALE2 = 1.0f / (MyPoseLibrary::QUANT_SCALE * MyPoseLibrary::QUANT_SCALE);
+
+// records of version 1 and 2 files, floats with a penalty component (0 if tracked) instead of the bits
+template <typename Library>
+struct alignas(32) float_block {
+	int32_t keys[Library::LANES];
+	float values[Library::JOINTS * 5 * Library::LANES];		// [joint][w, x, y, z, penalty][lane]
+	typename Library::binding bindings[Library::LANES];
+};
+static const int FLOAT_COMPONENTS = 5;
+template <typename Library>
+static const size_t V1_BLOCK_SIZE = offsetof(float_block<Library>, bindings);	// no bindings yet
+template <typename Library>
+static const size_t V2_BLOCK_SIZE = sizeof(float_block<Library>);
+
+// one joint of the skeleton being matched
+struct query_joint {
+	size_t offset;		// joint * COMPONENTS * LANES
+	uint32_t bit;		// 1 << joint
+	float q[4];			// w, x, y, z, times QUANT_SCALE like the stored values
+	bool enabled;
+};
+
+static_assert(sizeof(MyPoseLibrary::file_header) == 64, "library header must stay 64 bytes");
+static_assert(sizeof(MyPoseLibrary::binding) == 16, "bindings are part of the library file");
+
+template <typename Library>
+using kernel_fn = uint64_t (*)(const typename Library::block* data, size_t blocks, const query_joint* joints,
+	const typename Library::joint_order* order, typename Library::joint_rejects* rejects, float* worst);
+
+/*************************************************************************************************/
+/*                                     Kernels                                                   */
+/*************************************************************************************************/
+// every kernel writes the largest squared joint distance of each pose into worst and returns the joints it evaluated.
+// they work on the quantized values directly, the query is scaled up instead, and only worst is scaled back.
+// joints are visited in the block's order and a block is left as soon as all its lanes are worse than the best pose
+// found so far: those lanes only hold a partial worst, but it is already too large for them to be the closest pose.
+// the joint that made a block leave is counted in rejects so it moves to the front.
+
+template <typename Library>
+static uint64_t KernelScalar(const typename Library::block* data, size_t blocks, const query_joint* joints,
+	const typename Library::joint_order* order, typename Library::joint_rejects* rejects, float* worst)
+{
+	const int L = Library::LANES;
+	float bound = INFINITY;
+	uint64_t evaluated = 0;
+	for (size_t b = 0; b < blocks; ++b)
+	{
+		const int16_t* block = data[b].values;
+		const uint32_t* tracked = data[b].tracked;
+		float w[Library::LANES] = { 0 };
+		bool rejected = false;
+		for (int k = 0; k < Library::JOINTS && !rejected; ++k)
+		{
+			const int j = order[b][k];
+			if (!joints[j].enabled)
+				continue;
+
+			const int16_t* p = block + joints[j].offset;
+			const float* q = joints[j].q;
+			rejected = true;
+			for (int l = 0; l < L; ++l)
+			{
+				float d0 = p[0 * L + l] - q[0];
+				float d1 = p[1 * L + l] - q[1];
+				float d2 = p[2 * L + l] - q[2];
+				float d3 = p[3 * L + l] - q[3];
+				float mag = d0 * d0 + d1 * d1 + d2 * d2 + d3 * d3 + ((tracked[l] & joints[j].bit) ? 0.0f : UNTRACKED);
+				if (mag > w[l])
+					w[l] = mag;
+				rejected = rejected && w[l] > bound;
+			}
+			++evaluated;
+			if (rejected)
+				++rejects[b][j];
+		}
+		for (int l = 0; l < L; ++l)
+			worst[b * L + l] = w[l] * UNSCALE2;
+
+		for (int l = 0; l < L && !rejected; ++l)
+			bound = std::min(bound, w[l]);
+	}
+	return evaluated;
+}
+
+#if defined(KT_X86)
+template <typename Library>
+static uint64_t KernelSSE(const typename Library::block* data, size_t blocks, const query_joint* joints,
+	const typename Library::joint_order* order, typename Library::joint_rejects* rejects, float* worst)
+{
+	const int L = Library::LANES;
+	float bound = INFINITY;
+	uint64_t evaluated = 0;
+	for (size_t b = 0; b < blocks; ++b)
+	{
+		const int16_t* block = data[b].values;
+		const __m128i trackedLo = _mm_load_si128(reinterpret_cast<const __m128i*>(data[b].tracked));
+		const __m128i trackedHi = _mm_load_si128(reinterpret_cast<const __m128i*>(data[b].tracked + 4));
+		const __m128 limit = _mm_set1_ps(bound);
+		__m128 lo = _mm_setzero_ps();
+		__m128 hi = _mm_setzero_ps();
+		bool rejected = false;
+		for (int k = 0; k < Library::JOINTS; ++k)
+		{
+			const int j = order[b][k];
+			if (!joints[j].enabled)
+				continue;
+
+			// penalty where the joint bit is clear
+			const __m128i bit = _mm_set1_epi32((int)joints[j].bit);
+			const __m128 untracked = _mm_set1_ps(UNTRACKED);
+			__m128 accLo = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(trackedLo, bit), _mm_setzero_si128())), untracked);
+			__m128 accHi = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(trackedHi, bit), _mm_setzero_si128())), untracked);
+
+			const int16_t* p = block + joints[j].offset;
+			for (int c = 0; c < 4; ++c)
+			{
+				// sign extend the 8 values to two sets of 4 ints
+				const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(p + c * L));
+				const __m128 vLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+				const __m128 vHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+				__m128 q = _mm_set1_ps(joints[j].q[c]);
+				__m128 dLo = _mm_sub_ps(vLo, q);
+				__m128 dHi = _mm_sub_ps(vHi, q);
+				accLo = _mm_add_ps(accLo, _mm_mul_ps(dLo, dLo));
+				accHi = _mm_add_ps(accHi, _mm_mul_ps(dHi, dHi));
+			}
+			lo = _mm_max_ps(lo, accLo);
+			hi = _mm_max_ps(hi, accHi);
+			++evaluated;
+
+			if (_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(lo, limit), _mm_cmpgt_ps(hi, limit))) == 0xF)
+			{
+				++rejects[b][j];
+				rejected = true;
+				break;
+			}
+		}
+		const __m128 unscale = _mm_set1_ps(UNSCALE2);
+		_mm_storeu_ps(worst + b * L, _mm_mul_ps(lo, unscale));
+		_mm_storeu_ps(worst + b * L + 4, _mm_mul_ps(hi, unscale));
+
+		if (!rejected)
+		{
+			__m128 m = _mm_min_ps(lo, hi);
+			m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+			m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+			bound = std::min(bound, _mm_cvtss_f32(m));
+		}
+	}
+	return evaluated;
+}
+
+template <typename Library>
+KT_TARGET_AVX2
+static uint64_t KernelAVX2(const typename Library::block* data, size_t blocks, const query_joint* joints,
+	const typename Library::joint_order* order, typename Library::joint_rejects* rejects, float* worst)
+{
+	const int L = Library::LANES;
+	float bound = INFINITY;
+	uint64_t evaluated = 0;
+	for (size_t b = 0; b < blocks; ++b)
+	{
+		const int16_t* block = data[b].values;
+		const __m256i tracked = _mm256_load_si256(reinterpret_cast<const __m256i*>(data[b].tracked));
+		const __m256 limit = _mm256_set1_ps(bound);
+		__m256 w = _mm256_setzero_ps();
+		bool rejected = false;
+		for (int k = 0; k < Library::JOINTS; ++k)
+		{
+			const int j = order[b][k];
+			if (!joints[j].enabled)
+				continue;
+
+			// penalty where the joint bit is clear
+			const __m256i bit = _mm256_and_si256(tracked, _mm256_set1_epi32((int)joints[j].bit));
+			__m256 acc = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(bit, _mm256_setzero_si256())), _mm256_set1_ps(UNTRACKED));
+
+			const int16_t* p = block + joints[j].offset;
+			for (int c = 0; c < 4; ++c)
+			{
+				const __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(p + c * L))));
+				__m256 d = _mm256_sub_ps(v, _mm256_set1_ps(joints[j].q[c]));
+				acc = _mm256_fmadd_ps(d, d, acc);
+			}
+			w = _mm256_max_ps(w, acc);
+			++evaluated;
+
+			if (_mm256_movemask_ps(_mm256_cmp_ps(w, limit, _CMP_GT_OQ)) == 0xFF)
+			{
+				++rejects[b][j];
+				rejected = true;
+				break;
+			}
+		}
+		_mm256_storeu_ps(worst + b * L, _mm256_mul_ps(w, _mm256_set1_ps(UNSCALE2)));
+
+		if (!rejected)
+		{
+			__m128 m = _mm_min_ps(_mm256_castps256_ps128(w), _mm256_extractf128_ps(w, 1));
+			m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+			m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+			bound = std::min(bound, _mm_cvtss_f32(m));
+		}
+	}
+	return evaluated;
+}
+
+static bool HasAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// fma and the OS saving ymm registers
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 12)) || !(info[2] & (1 << 27)))
+		return false;
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+template <typename Library>
+static kernel_fn<Library> GetKernel(int kernel)
+{
+#if defined(KT_X86)
+	static const bool avx2 = HasAVX2();
+#endif
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return KernelScalar<Library>;
+#if defined(KT_X86)
+	case KERNEL_SSE:
+		return KernelSSE<Library>;
+	case KERNEL_AVX2:
+		return avx2 ? KernelAVX2<Library> : nullptr;
+#endif
+	default:
+		return nullptr;
+	}
+}
+
+static int SelectKernel()
+{
+	// KT_KERNEL picks one by name, to compare them or to work around a CPU
+	const char* name = std::getenv("KT_KERNEL");
+	for (int kernel = 0; name && kernel < KERNEL_COUNT; ++kernel)
+	{
+		if (std::strcmp(name, MyPoseLibrary::getKernelName(kernel)) == 0 && GetKernel<MyPoseLibrary>(kernel))
+			return kernel;
+	}
+
+	// the fastest one there is
+	int best = KERNEL_SCALAR;
+	for (int kernel = 0; kernel < KERNEL_COUNT; ++kernel)
+	{
+		if (GetKernel<MyPoseLibrary>(kernel))
+			best = kernel;
+	}
+	return best;
+}
+
+static std::atomic<int>& ActiveKernel()
+{
+	static std::atomic<int> kernel(SelectKernel());
+	return kernel;
+}
+
+/*************************************************************************************************/
+/*                                     MyBasicPoseLibrary                                        */
+/*************************************************************************************************/
+template <typename Sensor>
+MyBasicPoseLibrary<Sensor>::MyBasicPoseLibrary()
+{
+	static_assert(sizeof(block) % 32 == 0, "library records must keep 32 byte alignment");
+	static_assert(JOINTS <= 32, "tracked joints are a 32 bit mask");
+
+	this->m_data = nullptr;
+	this->m_view = nullptr;
+	this->m_blocks = 0;
+	this->m_capacity = 0;
+	this->m_size = 0;
+	this->m_generation = MyBasicPoseLibrary::NextGeneration();
+
+	this->m_evaluated = 0;
+	this->m_compared = 0;
+	this->m_enabled = 0;
+}
+
+template <typename Sensor>
+MyBasicPoseLibrary<Sensor>::~MyBasicPoseLibrary()
+{
+	if (this->m_data)
+		operator delete(this->m_data, std::align_val_t(ALIGNMENT));
+}
+
+template <typename Sensor>
+size_t MyBasicPoseLibrary<Sensor>::size() const
+{
+	return this->m_size;
+}
+
+template <typename Sensor>
+uint64_t MyBasicPoseLibrary<Sensor>::generation() const
+{
+	return this->m_generation;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::isMapped() const
+{
+	return this->m_file.isOpen();
+}
+
+template <typename Sensor>
+int MyBasicPoseLibrary<Sensor>::getKey(size_t pose) const
+{
+	return this->m_view[pose / LANES].keys[pose % LANES];
+}
+
+template <typename Sensor>
+typename MyBasicPoseLibrary<Sensor>::binding MyBasicPoseLibrary<Sensor>::getBinding(size_t pose) const
+{
+	// a mapped file is used as it is, its bindings were never checked
+	return MyBasicPoseLibrary::Sanitize(this->m_view[pose / LANES].bindings[pose % LANES]);
+}
+
+template <typename Sensor>
+typename MyBasicPoseLibrary<Sensor>::binding MyBasicPoseLibrary<Sensor>::DefaultBinding()
+{
+	binding bind;
+	bind.mode = BIND_TAP;
+	bind.enter = 1.0f;
+	bind.exit = 1.25f;
+	bind.repeatMs = 250;
+	bind.cooldownMs = 300;
+	return bind;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::isTracked(size_t pose, int joint) const
+{
+	return (this->m_view[pose / LANES].tracked[pose % LANES] >> joint) & 1;
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::getOrientation(size_t pose, int joint, float q[4]) const
+{
+	const int16_t* values = this->m_view[pose / LANES].values;
+	for (int c = 0; c < 4; ++c)
+		q[c] = values[(joint * COMPONENTS + c) * LANES + pose % LANES] / QUANT_SCALE;
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Append(const skeleton_data& skeleton, int key, const binding& bind)
+{
+	float orientations[JOINTS][4];
+	bool tracked[JOINTS];
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		sensor_traits<Sensor>::Orientation(skeleton, j, orientations[j]);
+		tracked[j] = sensor_traits<Sensor>::Tracked(skeleton, j);
+	}
+	this->Append(orientations, tracked, key, bind);
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Append(const float orientations[][4], const bool* tracked, int key, const binding& bind)
+{
+	// a mapped file is read only, move it to memory before changing it
+	this->Materialize();
+
+	// start a new block, padding lanes have no joint tracked
+	if (this->m_size == this->m_blocks * LANES)
+	{
+		if (this->m_blocks == this->m_capacity)
+			this->Reserve(this->m_capacity ? this->m_capacity * 2 : 4);
+
+		std::memset(&this->m_data[this->m_blocks], 0, sizeof(block));
+		++this->m_blocks;
+		this->ResizeOrder();
+	}
+
+	const size_t pose = this->m_size++;
+	block& b = this->m_data[pose / LANES];
+	const size_t lane = pose % LANES;
+	b.tracked[lane] = 0;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		for (int c = 0; c < 4; ++c)
+			b.values[(j * COMPONENTS + c) * LANES + lane] = MyBasicPoseLibrary::Quantize(orientations[j][c]);
+		if (tracked[j])
+			b.tracked[lane] |= 1u << j;
+	}
+	b.keys[lane] = key;
+	b.bindings[lane] = MyBasicPoseLibrary::Sanitize(bind);
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::setBinding(size_t pose, const binding& bind)
+{
+	if (pose >= this->m_size)
+		return;
+
+	this->Materialize();
+	this->m_data[pose / LANES].bindings[pose % LANES] = MyBasicPoseLibrary::Sanitize(bind);
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Clear()
+{
+	this->m_file.Close();
+	this->m_view = this->m_data;
+	this->m_blocks = 0;
+	this->m_size = 0;
+	this->m_generation = MyBasicPoseLibrary::NextGeneration();
+	this->ResizeOrder();
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::CopyFrom(const MyBasicPoseLibrary& other)
+{
+	this->m_file.Close();
+	this->m_view = this->m_data;
+	this->m_blocks = 0;
+	this->m_size = 0;
+	if (this->m_capacity < other.m_blocks + 1)
+		this->Reserve(other.m_blocks + 1);
+
+	// the adaptive order and the statistics are the other library's matcher's, they start over
+	if (other.m_blocks)
+		std::memcpy(this->m_data, other.m_view, other.m_blocks * sizeof(block));
+	this->m_blocks = other.m_blocks;
+	this->m_size = other.m_size;
+	this->m_generation = other.m_generation;
+	this->ResizeOrder();
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::Import(const char* path)
+{
+	if (MyBasicPoseLibrary::IsBinary(path))
+		return this->ImportBinary(path);
+	return this->ImportCsv(path);
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::Export(const char* path) const
+{
+	const size_t len = std::strlen(path);
+	if (len >= 4 && std::strcmp(path + len - 4, ".kpl") == 0)
+		return this->ExportBinary(path);
+	return this->ExportCsv(path);
+}
+
+// only blanks or a carriage return left on the line
+static bool AtEnd(const char* it)
+{
+	while (*it == ' ' || *it == '\t' || *it == '\r')
+		++it;
+	return *it == '\0';
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ImportCsv(const char* path)
+{
+	// a "key,mode,enter,exit,repeatMs,cooldownMs,tracked" line followed by one "w,x,y,z" line per joint,
+	// tracked is the hex mask of the joints that had data. Older files only have the key and tap it,
+	// or have no mask and every joint counts as tracked. Nothing is added unless the whole file parses
+	std::ifstream ifs;
+	ifs.open(path);
+	if (!ifs.is_open())
+		return false;
+
+	struct csv_pose {
+		float orientations[JOINTS][4];
+		bool tracked[JOINTS];
+		int key;
+		binding bind;
+	};
+	std::vector<csv_pose> poses;
+	std::string buf = "";
+	size_t line = 0;
+	while (std::getline(ifs, buf))
+	{
+		++line;
+		if (AtEnd(buf.c_str()))
+			continue;
+
+		csv_pose pose;
+		const char* begin = buf.c_str();
+		char* it = nullptr;
+		pose.key = (int)std::strtol(begin, &it, 10);
+		bool ok = it != begin;
+		pose.bind = MyBasicPoseLibrary::DefaultBinding();
+		uint32_t mask = ~0u;
+		if (ok && *it == ',')
+		{
+			// all five or none
+			begin = it + 1;
+			pose.bind.mode = (uint32_t)std::strtoul(begin, &it, 10);
+			ok = it != begin && *it == ',';
+			if (ok)
+			{
+				begin = it + 1;
+				pose.bind.enter = std::strtof(begin, &it);
+				ok = it != begin && *it == ',';
+			}
+			if (ok)
+			{
+				begin = it + 1;
+				pose.bind.exit = std::strtof(begin, &it);
+				ok = it != begin && *it == ',';
+			}
+			if (ok)
+			{
+				begin = it + 1;
+				pose.bind.repeatMs = (uint16_t)std::strtoul(begin, &it, 10);
+				ok = it != begin && *it == ',';
+			}
+			if (ok)
+			{
+				begin = it + 1;
+				pose.bind.cooldownMs = (uint16_t)std::strtoul(begin, &it, 10);
+				ok = it != begin;
+			}
+			if (ok && *it == ',')
+			{
+				begin = it + 1;
+				mask = (uint32_t)std::strtoul(begin, &it, 16);
+				ok = it != begin;
+			}
+		}
+		if (!ok || !AtEnd(it))
+		{
+			printf("%s:%zu: not a pose key\n", path, line);
+			return false;
+		}
+
+		for (int i = 0; i < JOINTS; ++i)
+		{
+			pose.tracked[i] = (mask >> i) & 1;
+			if (!std::getline(ifs, buf))
+			{
+				printf("%s: ends inside pose %zu\n", path, poses.size());
+				return false;
+			}
+			++line;
+
+			const char* joint = buf.c_str();
+			for (int c = 0; c < 4 && ok; ++c)
+			{
+				char* next = nullptr;
+				pose.orientations[i][c] = std::strtof(joint, &next);
+				ok = next != joint && (c == 3 ? AtEnd(next) : *next == ',');
+				joint = next + 1;
+			}
+			if (!ok)
+			{
+				printf("%s:%zu: not a w,x,y,z joint\n", path, line);
+				return false;
+			}
+		}
+		poses.push_back(pose);
+	}
+	ifs.close();
+
+	for (const csv_pose& pose : poses)
+		this->Append(pose.orientations, pose.tracked, pose.key, pose.bind);
+	return true;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ExportCsv(const char* path) const
+{
+	std::ofstream ofs;
+	ofs.open(path);
+	if (!ofs.is_open())
+		return false;
+
+	for (size_t pose = 0; pose < this->m_size; ++pose)
+	{
+		const binding bind = this->getBinding(pose);
+		uint32_t mask = 0;
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			if (this->isTracked(pose, j))
+				mask |= 1u << j;
+		}
+		ofs << this->getKey(pose) << ',' << bind.mode << ',' << bind.enter << ',' << bind.exit << ',' <<
+			bind.repeatMs << ',' << bind.cooldownMs << ',' << std::hex << mask << std::dec << '\n';
+		for (int i = 0; i < JOINTS; ++i)
+		{
+			// w, x, y, z for both sensors
+			float q[4];
+			this->getOrientation(pose, i, q);
+			ofs << q[0] << ',';
+			ofs << q[1] << ',';
+			ofs << q[2] << ',';
+			ofs << q[3] << '\n';
+		}
+	}
+	ofs.close();
+	return true;
+}
+
+// padding lanes of the last block have no joint tracked and no key, as Append leaves them.
+// One with data would bound the kernels' early exit with a pose that does not exist
+template <typename Library>
+static bool EmptyPadding(const typename Library::block& last, size_t used)
+{
+	for (size_t lane = used; lane < (size_t)Library::LANES; ++lane)
+	{
+		if (last.tracked[lane] != 0 || last.keys[lane] != 0)
+			return false;
+	}
+	return true;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ImportBinary(const char* path)
+{
+	// empty library and a current file: map the file into the library itself and match against it in place,
+	// otherwise map it temporarily and copy the poses behind the existing ones
+	file_header peek;
+	const bool inPlace = this->m_size == 0 && MyBasicPoseLibrary::ReadHeader(path, peek) && peek.version == FILE_VERSION;
+	MyMappedFile temporary;
+	if (inPlace)
+		this->Clear();
+	MyMappedFile& file = inPlace ? this->m_file : temporary;
+
+	if (!file.Open(path) || file.size() < sizeof(file_header))
+	{
+		printf("Can't map pose library: %s\n", path);
+		file.Close();
+		return false;
+	}
+
+	// refuse anything this build can not read
+	file_header header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	const bool current = header.version == FILE_VERSION && header.blockSize == sizeof(block) &&
+		header.components == (uint32_t)COMPONENTS;
+	const bool old = ((header.version == 1 && header.blockSize == V1_BLOCK_SIZE<MyBasicPoseLibrary>) ||
+		(header.version == 2 && header.blockSize == V2_BLOCK_SIZE<MyBasicPoseLibrary>)) &&
+		header.components == (uint32_t)FLOAT_COMPONENTS;
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		!(current || old) ||
+		header.sensor != (uint32_t)sensor_traits<Sensor>::ID ||
+		header.joints != (uint32_t)JOINTS ||
+		header.lanes != (uint32_t)LANES ||
+		header.dataOffset % ALIGNMENT != 0 ||
+		header.dataOffset > file.size() ||
+		header.blocks > (file.size() - header.dataOffset) / header.blockSize ||
+		header.blocks != header.poses / LANES + (header.poses % LANES != 0 ? 1 : 0))
+	{
+		printf("Pose library %s is damaged or was saved for another sensor or version\n", path);
+		file.Close();
+		return false;
+	}
+
+	const char* records = static_cast<const char*>(file.data()) + header.dataOffset;
+	if (current && header.blocks && !EmptyPadding<MyBasicPoseLibrary>(reinterpret_cast<const block*>(records)[header.blocks - 1], header.poses - (header.blocks - 1) * LANES))
+	{
+		printf("Pose library %s has data in its padding lanes\n", path);
+		file.Close();
+		return false;
+	}
+
+	if (inPlace)
+	{
+		this->m_view = reinterpret_cast<const block*>(records);
+		this->m_blocks = (size_t)header.blocks;
+		this->m_size = (size_t)header.poses;
+		this->ResizeOrder();
+		return true;
+	}
+
+	float orientations[JOINTS][4];
+	bool tracked[JOINTS];
+	for (size_t pose = 0; pose < header.poses; ++pose)
+	{
+		const size_t lane = pose % LANES;
+		const char* record = records + (pose / LANES) * header.blockSize;
+		if (current)
+		{
+			const block& b = *reinterpret_cast<const block*>(record);
+			for (int j = 0; j < JOINTS; ++j)
+			{
+				for (int c = 0; c < 4; ++c)
+					orientations[j][c] = b.values[(j * COMPONENTS + c) * LANES + lane] / QUANT_SCALE;
+				tracked[j] = (b.tracked[lane] >> j) & 1;
+			}
+			this->Append(orientations, tracked, b.keys[lane], b.bindings[lane]);
+			continue;
+		}
+
+		// floats, version 1 stops before the bindings
+		const float_block<MyBasicPoseLibrary>& b = *reinterpret_cast<const float_block<MyBasicPoseLibrary>*>(record);
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			for (int c = 0; c < 4; ++c)
+				orientations[j][c] = b.values[(j * FLOAT_COMPONENTS + c) * LANES + lane];
+			tracked[j] = b.values[(j * FLOAT_COMPONENTS + 4) * LANES + lane] == 0.0f;
+		}
+		this->Append(orientations, tracked, b.keys[lane], header.version >= 2 ? b.bindings[lane] : MyBasicPoseLibrary::DefaultBinding());
+	}
+	return true;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ExportBinary(const char* path) const
+{
+	std::ofstream ofs;
+	ofs.open(path, std::ios::out | std::ios::binary);
+	if (!ofs.is_open())
+		return false;
+
+	file_header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = FILE_VERSION;
+	header.sensor = sensor_traits<Sensor>::ID;
+	header.joints = JOINTS;
+	header.lanes = LANES;
+	header.components = COMPONENTS;
+	header.blockSize = sizeof(block);
+	header.poses = this->m_size;
+	header.blocks = this->m_blocks;
+	header.dataOffset = sizeof(file_header);
+
+	// the blocks are already the file format
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (this->m_blocks)
+		ofs.write(reinterpret_cast<const char*>(this->m_view), this->m_blocks * sizeof(block));
+	ofs.close();
+	return !ofs.fail();
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ReadHeader(const char* path, file_header& header)
+{
+	std::ifstream ifs(path, std::ios::in | std::ios::binary);
+	ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+	return ifs.gcount() == sizeof(header) && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::IsBinary(const char* path)
+{
+	std::ifstream ifs(path, std::ios::in | std::ios::binary);
+	char magic[sizeof(MAGIC)] = { 0 };
+	ifs.read(magic, sizeof(magic));
+	return ifs.gcount() == sizeof(magic) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::ConvertCsvToBinary(const char* csvPath, const char* binaryPath)
+{
+	MyBasicPoseLibrary library;
+	if (!library.ImportCsv(csvPath))
+		return false;
+	return library.ExportBinary(binaryPath);
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::hasKernel(int kernel)
+{
+	return GetKernel<MyBasicPoseLibrary>(kernel) != nullptr;
+}
+
+template <typename Sensor>
+bool MyBasicPoseLibrary<Sensor>::setKernel(int kernel)
+{
+	if (!GetKernel<MyBasicPoseLibrary>(kernel))
+		return false;
+	ActiveKernel() = kernel;
+	return true;
+}
+
+template <typename Sensor>
+int MyBasicPoseLibrary<Sensor>::getKernel()
+{
+	return ActiveKernel();
+}
+
+template <typename Sensor>
+const char* MyBasicPoseLibrary<Sensor>::getKernelName(int kernel)
+{
+	static const char* names[KERNEL_COUNT] = { "scalar", "sse", "avx2" };
+	return kernel >= 0 && kernel < KERNEL_COUNT ? names[kernel] : "unknown";
+}
+
+template <typename Sensor>
+typename MyBasicPoseLibrary<Sensor>::match MyBasicPoseLibrary<Sensor>::Match(const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh) const
+{
+	const match result = this->Match(skeleton, mask, thresh, this->m_scratch);
+	this->Merge(this->m_scratch);
+	return result;
+}
+
+template <typename Sensor>
+typename MyBasicPoseLibrary<Sensor>::match MyBasicPoseLibrary<Sensor>::Match(const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, scratch& work) const
+{
+	const kernel_fn<MyBasicPoseLibrary> kernel = GetKernel<MyBasicPoseLibrary>(ActiveKernel().load(std::memory_order_relaxed));
+
+	match result = { -1, -1, -1, 0.0f, 0.0f };
+	if (this->m_size == 0)
+		return result;
+
+	// gather the enabled joints, a checked joint the sensor lost can never match
+	query_joint joints[JOINTS];
+	int count = 0;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		joints[j].enabled = mask[j];
+		if (!mask[j])
+			continue;
+
+		if (!sensor_traits<Sensor>::Tracked(skeleton, j))
+		{
+			result.failed = j;
+			return result;
+		}
+
+		joints[j].offset = (size_t)j * COMPONENTS * LANES;
+		joints[j].bit = 1u << j;
+		sensor_traits<Sensor>::Orientation(skeleton, j, joints[j].q);
+		for (int c = 0; c < 4; ++c)
+			joints[j].q[c] *= QUANT_SCALE;
+		++count;
+	}
+
+	// only allocates after the library grew
+	if (work.rejects.size() != this->m_blocks)
+	{
+		joint_rejects none;
+		none.fill(0);
+		work.worst.resize(this->m_blocks * LANES);
+		work.rejects.resize(this->m_blocks, none);
+	}
+
+	work.evaluated += kernel(this->m_view, this->m_blocks, joints, this->m_order.data(), work.rejects.data(), work.worst.data());
+	work.compared += this->m_blocks;
+	++work.matches;
+	this->m_enabled = count;
+
+	// best pose is the one whose worst joint is the closest
+	size_t best = 0;
+	for (size_t i = 1; i < this->m_size; ++i)
+	{
+		if (work.worst[i] < work.worst[best])
+			best = i;
+	}
+
+	result.closest = (int)best;
+	result.distance = std::sqrt(work.worst[best]);
+	result.margin = thresh - result.distance;
+	if (result.distance <= thresh)
+		result.pose = (int)best;
+	else
+		result.failed = this->WorstJoint(best, skeleton, mask, thresh);
+
+	return result;
+}
+
+template <typename Sensor>
+int MyBasicPoseLibrary<Sensor>::WorstJoint(size_t pose, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh) const
+{
+	int worst = -1;
+	float worstMag = thresh * thresh;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		if (!mask[j])
+			continue;
+
+		if (!this->isTracked(pose, j) || !sensor_traits<Sensor>::Tracked(skeleton, j))
+			return j;
+
+		float p[4], q[4];
+		this->getOrientation(pose, j, p);
+		sensor_traits<Sensor>::Orientation(skeleton, j, q);
+
+		float mag = 0.0f;
+		for (int c = 0; c < 4; ++c)
+			mag += (p[c] - q[c]) * (p[c] - q[c]);
+
+		if (mag > worstMag)
+		{
+			worstMag = mag;
+			worst = j;
+		}
+	}
+	return worst;
+}
+
+template <typename Sensor>
+float MyBasicPoseLibrary<Sensor>::Distance(size_t pose, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask) const
+{
+	float worst = 0.0f;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		if (!mask[j])
+			continue;
+		if (!this->isTracked(pose, j) || !sensor_traits<Sensor>::Tracked(skeleton, j))
+			return INFINITY;
+
+		float p[4], q[4];
+		this->getOrientation(pose, j, p);
+		sensor_traits<Sensor>::Orientation(skeleton, j, q);
+
+		float mag = 0.0f;
+		for (int c = 0; c < 4; ++c)
+			mag += (p[c] - q[c]) * (p[c] - q[c]);
+		worst = std::max(worst, mag);
+	}
+	return std::sqrt(worst);
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Merge(scratch& work) const
+{
+	this->m_evaluated += work.evaluated;
+	this->m_compared += work.compared;
+	work.evaluated = 0;
+	work.compared = 0;
+
+	// the joints that reject blocks most often go first from now on
+	if (work.matches < REORDER_INTERVAL)
+		return;
+	work.matches = 0;
+
+	const size_t blocks = std::min(work.rejects.size(), this->m_rejects.size());
+	for (size_t b = 0; b < blocks; ++b)
+	{
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			this->m_rejects[b][j] += work.rejects[b][j];
+			work.rejects[b][j] = 0;
+		}
+	}
+	this->Reorder();
+}
+
+template <typename Sensor>
+double MyBasicPoseLibrary<Sensor>::getAverageJoints() const
+{
+	const uint64_t compared = this->m_compared;
+	return compared ? (double)this->m_evaluated / compared : 0.0;
+}
+
+template <typename Sensor>
+int MyBasicPoseLibrary<Sensor>::getEnabledJoints() const
+{
+	return this->m_enabled;
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::ResetStats()
+{
+	this->m_evaluated = 0;
+	this->m_compared = 0;
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::ResizeOrder()
+{
+	// new blocks start in joint order with no history
+	joint_order identity;
+	for (int j = 0; j < JOINTS; ++j)
+		identity[j] = (uint8_t)j;
+	joint_rejects none;
+	none.fill(0);
+
+	this->m_order.resize(this->m_blocks, identity);
+	this->m_rejects.resize(this->m_blocks, none);
+
+	// keeps the single threaded Match from allocating
+	this->m_scratch.worst.resize(this->m_blocks * LANES);
+	this->m_scratch.rejects.resize(this->m_blocks, none);
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Reorder() const
+{
+	for (size_t b = 0; b < this->m_blocks; ++b)
+	{
+		joint_order& order = this->m_order[b];
+		joint_rejects& rejects = this->m_rejects[b];
+
+		// insertion sort, most rejections first, ties keep their place
+		for (int i = 1; i < JOINTS; ++i)
+		{
+			const uint8_t joint = order[i];
+			int k = i;
+			while (k > 0 && rejects[order[k - 1]] < rejects[joint])
+			{
+				order[k] = order[k - 1];
+				--k;
+			}
+			order[k] = joint;
+		}
+
+		// forget slowly so the order follows the user
+		for (int j = 0; j < JOINTS; ++j)
+			rejects[j] /= 2;
+	}
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Reserve(size_t blocks)
+{
+	block* data = static_cast<block*>(operator new(blocks * sizeof(block), std::align_val_t(ALIGNMENT)));
+	if (this->m_data)
+	{
+		std::memcpy(data, this->m_data, this->m_blocks * sizeof(block));
+		operator delete(this->m_data, std::align_val_t(ALIGNMENT));
+	}
+
+	this->m_data = data;
+	this->m_view = data;
+	this->m_capacity = blocks;
+}
+
+template <typename Sensor>
+void MyBasicPoseLibrary<Sensor>::Materialize()
+{
+	if (!this->m_file.isOpen())
+		return;
+
+	if (this->m_capacity < this->m_blocks + 1)
+	{
+		if (this->m_data)
+			operator delete(this->m_data, std::align_val_t(ALIGNMENT));
+		this->m_data = static_cast<block*>(operator new((this->m_blocks + 1) * sizeof(block), std::align_val_t(ALIGNMENT)));
+		this->m_capacity = this->m_blocks + 1;
+	}
+
+	if (this->m_blocks)
+		std::memcpy(this->m_data, this->m_view, this->m_blocks * sizeof(block));
+	this->m_view = this->m_data;
+	this->m_file.Close();
+}
+
+template <typename Sensor>
+typename MyBasicPoseLibrary<Sensor>::binding MyBasicPoseLibrary<Sensor>::Sanitize(binding bind)
+{
+	// the matcher finds poses under the threshold only, entering can't be looser than that
+	if (bind.mode >= BIND_MODE_COUNT)
+		bind.mode = BIND_TAP;
+	if (!(bind.enter > 0.0f && bind.enter <= 1.0f))
+		bind.enter = 1.0f;
+	if (!(bind.exit >= bind.enter))
+		bind.exit = bind.enter;
+	if (bind.repeatMs == 0)
+		bind.repeatMs = 1;
+	return bind;
+}
+
+template <typename Sensor>
+uint64_t MyBasicPoseLibrary<Sensor>::NextGeneration()
+{
+	// libraries are replaced as a whole, a new one must never look like the one it replaces
+	static std::atomic<uint64_t> generations(0);
+	return ++generations;
+}
+
+template <typename Sensor>
+int16_t MyBasicPoseLibrary<Sensor>::Quantize(float v)
+{
+	// unit quaternion components, anything outside is clamped
+	v = std::max(-1.0f, std::min(1.0f, v));
+	return (int16_t)std::lround(v * QUANT_SCALE);
+}
+
+// the sensor of the build, and the one KinectBench checks the library on
+template class MyBasicPoseLibrary<active_sensor>;
+template class MyBasicPoseLibrary<test_sensor>;
@@ -0,0 +1,213 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MyMappedFile.h"
+
+// std
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+typedef enum {
+	BIND_TAP,			// one press when the pose is entered
+	BIND_HOLD,			// key down while the pose is held, up once it is left
+	BIND_REPEAT,		// a press when the pose is entered, then one every repeat interval while it is held
+	BIND_MODE_COUNT
+}BIND_MODE;
+
+typedef enum {
+	KERNEL_SCALAR,		// plain C++, any CPU
+	KERNEL_SSE,			// x86 only
+	KERNEL_AVX2,		// x86 with AVX2 and FMA
+	KERNEL_COUNT
+}MATCH_KERNEL;
+
+// Saved poses stored structure-of-arrays for batched matching.
+// Poses are grouped in blocks of LANES, inside a block every joint holds LANES values of w, then x, y, z,
+// so one aligned load feeds one SIMD lane per pose. Tracked joints are one bit per joint and pose,
+// a joint without data adds a penalty so large the pose can never match. Padding lanes have no joint tracked.
+//
+// Quaternion components are stored as int16, round(v * QUANT_SCALE), less than half the size of floats.
+// Every component is off by at most 0.5 / QUANT_SCALE, so a joint distance computed against the stored pose
+// is within QUANT_ERROR = 2 * 0.5 / QUANT_SCALE (about 3.1e-5) of the distance to the pose as it was saved,
+// far below any useful threshold.
+//
+// A block is also the fixed-stride record of the binary library file (*.kpl): a 64 byte header followed by
+// the blocks exactly as they are in memory, so a file can be memory mapped and matched against in place.
+// Version 1 and 2 files hold floats, version 1 has no bindings either, they are copied in and quantized.
+//
+// The library is written against the sensor traits: MyPoseLibrary is the one for the sensor of the build,
+// KinectBench also runs MyBasicPoseLibrary<test_sensor>. Both are built in MyPoseLibrary.cpp.
+template <typename Sensor>
+class MyBasicPoseLibrary {
+public:		// data structures
+	typedef typename sensor_traits<Sensor>::skeleton skeleton_data;
+	static constexpr int JOINTS = sensor_traits<Sensor>::JOINTS;
+	static constexpr int LANES = 8;
+	static constexpr int COMPONENTS = 4;	// w, x, y, z
+	static constexpr size_t BLOCK_VALUES = (size_t)JOINTS * COMPONENTS * LANES;
+	static constexpr uint32_t FILE_VERSION = 3;
+	static constexpr float QUANT_SCALE = 32767.0f;
+	static constexpr float QUANT_ERROR = 1.0f / QUANT_SCALE;		// largest change of a joint distance
+	static constexpr int REORDER_INTERVAL = 256;	// matches between two joint order refreshes
+
+	typedef std::array<uint8_t, JOINTS> joint_order;		// joints of a block, most likely to reject first
+	typedef std::array<uint32_t, JOINTS> joint_rejects;		// times each joint rejected the whole block
+
+	// what the key of a pose does. A pose is entered under enter * threshold and left over exit * threshold,
+	// so a distance hovering around the threshold does not enter and leave it every other frame
+	struct binding {
+		uint32_t mode;					// BIND_MODE
+		float enter;					// fraction of the threshold, (0, 1]
+		float exit;						// fraction of the threshold, >= enter
+		uint16_t repeatMs;				// BIND_REPEAT interval
+		uint16_t cooldownMs;			// time after leaving before the pose can be entered again
+	};
+
+	struct alignas(32) block {
+		int32_t keys[LANES];			// key bound to each pose, 0 for padding lanes
+		uint32_t tracked[LANES];		// bit j set if joint j of the pose was tracked
+		int16_t values[BLOCK_VALUES];	// [joint][component][lane], quantized
+		binding bindings[LANES];		// not read while matching, kept behind the values
+	};
+
+	struct file_header {
+		char magic[4];					// "KTPL"
+		uint32_t version;
+		uint32_t sensor;				// SENSOR_K4W, SENSOR_K4A or SENSOR_TEST
+		uint32_t joints;
+		uint32_t lanes;
+		uint32_t components;
+		uint32_t blockSize;				// sizeof(block), the record stride
+		uint32_t reserved0;
+		uint64_t poses;
+		uint64_t blocks;
+		uint64_t dataOffset;			// first block, from the start of the file
+		uint8_t reserved1[8];
+	};
+
+	// what one thread needs to run Match, so several threads can match against the library at once
+	struct scratch {
+		std::vector<float> worst;				// per-pose worst squared joint distance of the last Match
+		std::vector<joint_rejects> rejects;		// per block, handed to the library by Merge
+		uint64_t matches;
+		uint64_t evaluated;
+		uint64_t compared;
+		uint64_t visited;						// poses visited by MyPoseIndex queries
+		uint64_t queries;
+
+		scratch() : matches(0), evaluated(0), compared(0), visited(0), queries(0) {}
+	};
+
+	struct match {
+		int pose;			// best pose under the threshold, -1 if none
+		int closest;		// closest pose even if it is over the threshold, -1 if the library is empty
+		int failed;			// joint to highlight when nothing matched, -1 otherwise
+		float distance;		// worst joint distance of the closest pose
+		float margin;		// threshold - distance, positive when matched
+	};
+
+private:	// variables
+	block* m_data;					// owned storage, m_capacity blocks
+	const block* m_view;			// what the matcher reads: m_data or the mapped file
+	MyMappedFile m_file;
+	size_t m_blocks;
+	size_t m_capacity;
+	size_t m_size;
+	uint64_t m_generation;			// unique in the process, changes whenever existing poses go away
+	mutable scratch m_scratch;			// used by the single threaded Match
+
+	// adaptive joint order, per block since the 8 poses of a block are evaluated together
+	mutable std::vector<joint_order> m_order;
+	mutable std::vector<joint_rejects> m_rejects;
+	mutable std::atomic<uint64_t> m_evaluated;	// joints evaluated, summed over blocks
+	mutable std::atomic<uint64_t> m_compared;	// blocks compared
+	mutable std::atomic<int> m_enabled;			// joints enabled in the last Match
+
+public:		// functions
+
+	// constructer
+	MyBasicPoseLibrary();
+	~MyBasicPoseLibrary();
+	MyBasicPoseLibrary(const MyBasicPoseLibrary&) = delete;
+	MyBasicPoseLibrary& operator=(const MyBasicPoseLibrary&) = delete;
+
+	// get data
+	size_t size() const;
+	uint64_t generation() const;
+	bool isMapped() const;
+	int getKey(size_t pose) const;
+	binding getBinding(size_t pose) const;
+	bool isTracked(size_t pose, int joint) const;
+	void getOrientation(size_t pose, int joint, float q[4]) const;
+
+	// joints evaluated per block and Match, out of getEnabledJoints() without the early exit
+	double getAverageJoints() const;
+	int getEnabledJoints() const;
+	void ResetStats();
+
+	// tap on enter, hysteresis of a quarter of the threshold, a short cooldown
+	static binding DefaultBinding();
+
+	// operations
+	void Append(const skeleton_data& skeleton, int key, const binding& bind = DefaultBinding());
+	void Append(const float orientations[][4], const bool* tracked, int key, const binding& bind = DefaultBinding());
+	void setBinding(size_t pose, const binding& bind);
+	void Clear();
+
+	// the poses and generation of another library, in memory even if it is mapped, with room for one more
+	// Append. Only its immutable parts are read, so it may be matched against meanwhile
+	void CopyFrom(const MyBasicPoseLibrary& other);
+
+	// files, Import picks the format from the content, Export from the extension (.kpl is binary)
+	bool Import(const char* path);
+	bool Export(const char* path) const;
+	bool ImportCsv(const char* path);
+	bool ExportCsv(const char* path) const;
+	bool ImportBinary(const char* path);
+	bool ExportBinary(const char* path) const;
+	static bool IsBinary(const char* path);
+	static bool ConvertCsvToBinary(const char* csvPath, const char* binaryPath);
+
+	// the kernel Match runs, for every library of the process. The fastest one the CPU has is picked unless
+	// KT_KERNEL is set to scalar, sse or avx2. setKernel refuses a kernel this build or CPU can't run
+	static bool hasKernel(int kernel);
+	static bool setKernel(int kernel);
+	static int getKernel();
+	static const char* getKernelName(int kernel);
+
+	// compare the skeleton against every pose at once, only joints enabled in mask are checked.
+	// a block stops early once none of its poses can be the closest, the joints that stop blocks most go first
+	match Match(const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh) const;
+
+	// same, safe to call from several threads at once as long as each brings its own scratch.
+	// Merge folds the statistics of a scratch back into the library and refreshes the joint order,
+	// call it from one thread while no Match is running
+	match Match(const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh, scratch& work) const;
+	void Merge(scratch& work) const;
+
+	// joint with the largest distance between the pose and the skeleton, -1 if every checked joint is in range
+	int WorstJoint(size_t pose, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask, float thresh) const;
+
+	// largest joint distance between one pose and the skeleton, infinite if a checked joint is missing on either
+	float Distance(size_t pose, const skeleton_data& skeleton, const std::array<bool, JOINTS>& mask) const;
+
+private:	// functions
+	void Reserve(size_t blocks);
+	void ResizeOrder();
+	void Reorder() const;
+	void Materialize();
+	static bool ReadHeader(const char* path, file_header& header);
+	static binding Sanitize(binding bind);
+	static int16_t Quantize(float v);
+	static uint64_t NextGeneration();
+};
+
+typedef MyBasicPoseLibrary<active_sensor> MyPoseLibrary;
+
+extern template class MyBasicPoseLibrary<active_sensor>;
+extern template class MyBasicPoseLibrary<test_sensor>;
@@ -0,0 +1,275 @@
+#include "MyRecorder.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+static const char FILE_MAGIC[4] = { 'K', 'T', 'R', 'S' };
+static const char CHUNK_MAGIC[4] = { 'K', 'T', 'R', 'C' };
+static const char INDEX_MAGIC[4] = { 'K', 'T', 'R', 'I' };
+
+static_assert(sizeof(MyRecorder::file_header) == 32, "recording header must stay 32 bytes");
+static_assert(sizeof(MyRecorder::chunk_header) == 32, "chunk header must stay 32 bytes");
+static_assert(sizeof(MyRecorder::frame_header) == 24, "frame header must stay 24 bytes");
+static_assert(sizeof(MyRecorder::index_entry) == 32, "index entry must stay 32 bytes");
+static_assert(sizeof(MyRecorder::index_footer) == 24, "index footer must stay 24 bytes");
+
+MyRecorder::MyRecorder()
+{
+	this->m_thread = nullptr;
+	this->m_running = false;
+	this->m_busy = false;
+	this->m_finish = false;
+	this->m_file = nullptr;
+	this->m_compressed = true;
+
+	std::memset(&this->m_chunkHeader, 0, sizeof(this->m_chunkHeader));
+
+	this->m_written = 0;
+	this->m_dropped = 0;
+	this->m_bytes = 0;
+}
+
+MyRecorder::~MyRecorder()
+{
+	this->Stop();
+}
+
+bool MyRecorder::Start(const char* path, bool compressed)
+{
+	if (this->m_thread)
+		return false;
+
+	this->m_file = fopen(path, "wb");
+	if (!this->m_file)
+	{
+		printf("Can't open recording: %s\n", path);
+		return false;
+	}
+
+	file_header header = {};
+	std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+	header.version = FILE_VERSION;
+	header.sensor = SENSOR_TYPE;
+	header.joints = JOINTS;
+	header.maxBodies = MAX_BODIES;
+	header.bodySize = sizeof(body_data);
+	header.flags = compressed ? FLAG_COMPRESSED : 0;
+	fwrite(&header, sizeof(header), 1, this->m_file);
+	fflush(this->m_file);
+
+	// room for a full chunk so the writer does not grow it while recording
+	this->m_compressed = compressed;
+	this->m_chunk.clear();
+	this->m_chunk.reserve(CHUNK_FRAMES * std::max(sizeof(frame_header) + MAX_BODIES * sizeof(body_data), MyFrameCodec::MAX_FRAME_BYTES));
+	this->m_index.clear();
+
+	this->m_written = 0;
+	this->m_dropped = 0;
+	this->m_bytes = sizeof(header);
+
+	this->m_finish = false;
+	this->m_running = true;
+	this->m_thread = new std::thread(&MyRecorder::Writer, this);
+
+	printf("Recording to %s%s\n", path, compressed ? ", compressed" : "");
+	return true;
+}
+
+void MyRecorder::Stop()
+{
+	if (!this->m_thread)
+		return;
+
+	// a Push() that saw m_running queues its frame before the writer is told to drain the queue,
+	// nothing is left behind for the next recording
+	this->m_running = false;
+	while (this->m_busy)
+		std::this_thread::yield();
+	this->m_finish = true;
+	this->m_thread->join();
+	delete this->m_thread;
+	this->m_thread = nullptr;
+
+	this->WriteIndex();
+	fclose(this->m_file);
+	this->m_file = nullptr;
+
+	printf("Recording stopped, %llu frames written, %llu dropped.\n",
+		(unsigned long long)this->m_written.load(), (unsigned long long)this->m_dropped.load());
+}
+
+void MyRecorder::Push(const frame_data& frame)
+{
+	// seq_cst on both, so Stop() either sees m_busy or Push() sees m_running cleared
+	this->m_busy = true;
+	if (!this->m_running)
+	{
+		this->m_busy = false;
+		return;
+	}
+
+	frame_data* slot = this->m_queue.acquire();
+	if (!slot)
+	{
+		++this->m_dropped;
+		this->m_busy.store(false, std::memory_order_release);
+		return;
+	}
+
+	CopyFrame(*slot, frame);
+	this->m_queue.commit();
+	this->m_busy.store(false, std::memory_order_release);
+}
+
+bool MyRecorder::isRecording() const
+{
+	return this->m_running;
+}
+
+uint64_t MyRecorder::getWritten() const
+{
+	return this->m_written;
+}
+
+uint64_t MyRecorder::getDropped() const
+{
+	return this->m_dropped;
+}
+
+uint64_t MyRecorder::getBytes() const
+{
+	return this->m_bytes;
+}
+
+uint32_t MyRecorder::Crc32(const void* data, size_t size)
+{
+	// reflected crc32 (zlib / png)
+	static const std::array<uint32_t, 256> table = []() {
+		std::array<uint32_t, 256> t;
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+void MyRecorder::Writer()
+{
+	while (true)
+	{
+		frame_data* frame = this->m_queue.peek();
+		if (!frame)
+		{
+			// drain what is left before leaving
+			if (this->m_finish)
+				break;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+
+		this->Append(*frame);
+		this->m_queue.release();
+	}
+
+	this->Flush();
+}
+
+void MyRecorder::Append(const frame_data& frame)
+{
+	if (this->m_chunkHeader.frames == 0)
+	{
+		this->m_chunkHeader.firstTimestamp = frame.timestamp;
+
+		// every chunk starts from a keyframe
+		if (this->m_compressed)
+		{
+			this->m_codec.Reset();
+			this->m_codec.Begin(this->m_chunk);
+		}
+	}
+
+	if (this->m_compressed)
+	{
+		this->m_codec.Encode(frame);
+	}
+	else
+	{
+		frame_header header = {};
+		header.seq = frame.seq;
+		header.timestamp = frame.timestamp;
+		header.count = (uint32_t)frame.count;
+
+		const uint8_t* h = reinterpret_cast<const uint8_t*>(&header);
+		const uint8_t* b = reinterpret_cast<const uint8_t*>(frame.bodies);
+		this->m_chunk.insert(this->m_chunk.end(), h, h + sizeof(header));
+		this->m_chunk.insert(this->m_chunk.end(), b, b + frame.count * sizeof(body_data));
+	}
+
+	++this->m_chunkHeader.frames;
+	this->m_chunkHeader.lastTimestamp = frame.timestamp;
+
+	if (this->m_chunkHeader.frames >= CHUNK_FRAMES ||
+		frame.timestamp - this->m_chunkHeader.firstTimestamp >= CHUNK_USEC)
+	{
+		this->Flush();
+	}
+}
+
+void MyRecorder::Flush()
+{
+	if (this->m_chunkHeader.frames == 0)
+		return;
+
+	if (this->m_compressed)
+		this->m_codec.End();
+
+	std::memcpy(this->m_chunkHeader.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+	this->m_chunkHeader.bytes = (uint32_t)this->m_chunk.size();
+	this->m_chunkHeader.crc = MyRecorder::Crc32(this->m_chunk.data(), this->m_chunk.size());
+
+	fwrite(&this->m_chunkHeader, sizeof(this->m_chunkHeader), 1, this->m_file);
+	fwrite(this->m_chunk.data(), 1, this->m_chunk.size(), this->m_file);
+	fflush(this->m_file);
+
+	index_entry entry;
+	entry.offset = this->m_bytes;
+	entry.frames = this->m_chunkHeader.frames;
+	entry.bytes = this->m_chunkHeader.bytes;
+	entry.firstTimestamp = this->m_chunkHeader.firstTimestamp;
+	entry.lastTimestamp = this->m_chunkHeader.lastTimestamp;
+	this->m_index.push_back(entry);
+
+	this->m_written += this->m_chunkHeader.frames;
+	this->m_bytes += sizeof(this->m_chunkHeader) + this->m_chunk.size();
+
+	this->m_chunk.clear();
+	std::memset(&this->m_chunkHeader, 0, sizeof(this->m_chunkHeader));
+}
+
+void MyRecorder::WriteIndex()
+{
+	index_footer footer = {};
+	std::memcpy(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	footer.count = (uint32_t)this->m_index.size();
+	footer.offset = this->m_bytes;
+	footer.crc = MyRecorder::Crc32(this->m_index.data(), this->m_index.size() * sizeof(index_entry));
+
+	fwrite(this->m_index.data(), sizeof(index_entry), this->m_index.size(), this->m_file);
+	fwrite(&footer, sizeof(footer), 1, this->m_file);
+	fflush(this->m_file);
+
+	this->m_bytes += this->m_index.size() * sizeof(index_entry) + sizeof(footer);
+}
@@ -0,0 +1,123 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MySpscQueue.h"
+#include "MyFrameCodec.h"
+
+// std
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Appends every sensor frame to a binary session log (*.ktr) without ever blocking the capture thread.
+// Push() copies the frame into a lock-free ring, a writer thread drains it into chunks and writes each
+// chunk in one go behind a header with its size and CRC, so a crash loses at most the chunk being filled.
+// Compressed chunks (the default) hold the frames coded by MyFrameCodec, starting from a keyframe so each chunk
+// decodes on its own. Stop() appends an index of the chunks so a player can seek without reading the whole file,
+// a recording cut short has no index and is scanned chunk by chunk instead.
+//
+// file:  file_header, chunk, chunk, ..., index_entry x count, index_footer
+// chunk: chunk_header, then `frames` times (frame_header, `count` x body_data), or the coded frames if FLAG_COMPRESSED
+class MyRecorder {
+public:		// data structures
+	static const uint32_t FILE_VERSION = 2;		// 1 had no flags and no index
+	static const uint32_t FLAG_COMPRESSED = 1;
+	static const uint32_t CHUNK_FRAMES = 64;		// frames per chunk at most
+	static const uint64_t CHUNK_USEC = 1000000;		// time covered by a chunk at most
+
+	struct file_header {
+		char magic[4];				// "KTRS"
+		uint32_t version;
+		uint32_t sensor;			// SENSOR_K4W or SENSOR_K4A
+		uint32_t joints;
+		uint32_t maxBodies;
+		uint32_t bodySize;			// sizeof(body_data)
+		uint32_t flags;				// FLAG_COMPRESSED
+		uint32_t reserved;
+	};
+
+	struct chunk_header {
+		char magic[4];				// "KTRC"
+		uint32_t frames;
+		uint32_t bytes;				// payload after this header
+		uint32_t crc;				// crc32 of the payload
+		uint64_t firstTimestamp;	// sensor time of the first and last frame, microseconds
+		uint64_t lastTimestamp;
+	};
+
+	struct frame_header {
+		uint64_t seq;
+		uint64_t timestamp;
+		uint32_t count;				// bodies following this header
+		uint32_t reserved;
+	};
+
+	struct index_entry {
+		uint64_t offset;			// chunk header, from the start of the file
+		uint32_t frames;
+		uint32_t bytes;
+		uint64_t firstTimestamp;
+		uint64_t lastTimestamp;
+	};
+
+	// last bytes of a recording that was stopped properly
+	struct index_footer {
+		char magic[4];				// "KTRI"
+		uint32_t count;				// index entries
+		uint64_t offset;			// first index entry, from the start of the file
+		uint32_t crc;				// crc32 of the entries
+		uint32_t reserved;
+	};
+
+private:	// variables
+	MySpscQueue<frame_data, 256> m_queue;	// ~8 seconds at 30 fps
+	std::thread* m_thread;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_busy;				// Push() is queueing a frame, Stop() waits for it
+	std::atomic<bool> m_finish;				// no Push() is left, the writer drains the queue and leaves
+	FILE* m_file;
+	bool m_compressed;
+
+	// writer thread only
+	std::vector<uint8_t> m_chunk;
+	chunk_header m_chunkHeader;
+	MyFrameCodec m_codec;
+	std::vector<index_entry> m_index;
+
+	// statistics
+	std::atomic<uint64_t> m_written;
+	std::atomic<uint64_t> m_dropped;
+	std::atomic<uint64_t> m_bytes;
+
+public:		// functions
+
+	// constructer
+	MyRecorder();
+	~MyRecorder();
+
+	// operations
+	bool Start(const char* path, bool compressed = true);
+	void Stop();
+
+	// capture thread, drops the frame if the writer fell behind
+	void Push(const frame_data& frame);
+
+	// get data
+	bool isRecording() const;
+	uint64_t getWritten() const;
+	uint64_t getDropped() const;
+	uint64_t getBytes() const;
+
+	// tools
+	static uint32_t Crc32(const void* data, size_t size);
+
+private:	// functions
+	void Writer();
+	void Append(const frame_data& frame);
+	void Flush();
+	void WriteIndex();
+};
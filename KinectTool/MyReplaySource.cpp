@@ -0,0 +1,425 @@
+#include "MyReplaySource.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char FILE_MAGIC[4] = { 'K', 'T', 'R', 'S' };
+static const char CHUNK_MAGIC[4] = { 'K', 'T', 'R', 'C' };
+static const char INDEX_MAGIC[4] = { 'K', 'T', 'R', 'I' };
+
+
+static bool SeekFile(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t FileSize(FILE* file)
+{
+#if defined(_WIN32)
+	_fseeki64(file, 0, SEEK_END);
+	return (uint64_t)_ftelli64(file);
+#else
+	fseeko(file, 0, SEEK_END);
+	return (uint64_t)ftello(file);
+#endif
+}
+
+MyReplaySource::MyReplaySource(const char* path, bool realtime, bool loop)
+{
+	this->m_path = path;
+	this->m_file = nullptr;
+	this->m_frames = 0;
+	this->m_period = 33333;
+	this->m_compressed = false;
+
+	this->m_current = 0;
+	this->m_offset = 0;
+	this->m_frame = 0;
+	this->m_hasNext = false;
+	this->m_startTimestamp = 0;
+	this->m_anchored = false;
+	this->m_timeOffset = 0;
+	this->m_lastTimestamp = 0;
+	this->m_resync = false;
+
+	this->m_realtime = realtime;
+	this->m_loop = loop;
+	this->m_seek = -1;
+
+	this->m_played = 0;
+	this->m_position = 0;
+	this->m_loops = 0;
+}
+
+MyReplaySource::~MyReplaySource()
+{
+	this->Close();
+}
+
+bool MyReplaySource::Open()
+{
+	this->m_file = fopen(this->m_path.c_str(), "rb");
+	if (!this->m_file)
+	{
+		printf("Can't open recording: %s\n", this->m_path.c_str());
+		return false;
+	}
+
+	MyRecorder::file_header header;
+	if (fread(&header, sizeof(header), 1, this->m_file) != 1 || std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+	{
+		printf("%s is not a recording\n", this->m_path.c_str());
+		this->Close();
+		return false;
+	}
+
+	// version 1 wrote zero where the flags are now
+	if (header.version < 1 || header.version > MyRecorder::FILE_VERSION || header.sensor != SENSOR_TYPE ||
+		header.joints != JOINTS || header.bodySize != sizeof(body_data))
+	{
+		printf("%s was recorded with another sensor or version (sensor %u, %u joints, version %u)\n",
+			this->m_path.c_str(), header.sensor, header.joints, header.version);
+		this->Close();
+		return false;
+	}
+
+	this->m_compressed = (header.flags & MyRecorder::FLAG_COMPRESSED) != 0;
+
+	const uint64_t size = FileSize(this->m_file);
+	this->m_index.clear();
+	if (!this->ReadIndex(size))
+		this->ScanChunks(size);
+
+	uint32_t largest = 0;
+	this->m_frames = 0;
+	for (const chunk_entry& entry : this->m_index)
+	{
+		this->m_frames += entry.frames;
+		largest = std::max(largest, entry.bytes);
+	}
+
+	if (this->m_index.empty())
+	{
+		printf("%s has no frames\n", this->m_path.c_str());
+		this->Close();
+		return false;
+	}
+
+	if (this->m_frames > 1)
+		this->m_period = std::max<uint64_t>(1, this->getDuration() / (this->m_frames - 1));
+
+	// the capture loop must not allocate, every chunk fits from now on
+	this->m_chunk.reserve(largest);
+	this->m_current = this->m_index.size();
+	this->m_frame = 0;
+	this->m_hasNext = false;
+	this->m_anchored = false;
+
+	printf("Replaying %s: %llu frames, %.1f s%s\n", this->m_path.c_str(),
+		(unsigned long long)this->m_frames, this->getDuration() / 1000000.0, this->m_compressed ? ", compressed" : "");
+	return true;
+}
+
+void MyReplaySource::Close()
+{
+	if (!this->m_file)
+		return;
+
+	fclose(this->m_file);
+	this->m_file = nullptr;
+}
+
+SOURCE_RESULT MyReplaySource::Acquire(frame_data& frame, uint32_t timeout)
+{
+	if (!this->m_file)
+		return SOURCE_ERROR;
+
+	const int64_t seek = this->m_seek.exchange(-1);
+	if (seek >= 0)
+		this->SeekTo((uint64_t)seek);
+
+	// move on to the next chunk once this one is used up
+	size_t failures = 0;
+	while (this->m_current >= this->m_index.size() || this->m_frame >= this->m_index[this->m_current].frames)
+	{
+		size_t next = this->m_current >= this->m_index.size() ? 0 : this->m_current + 1;
+		if (next >= this->m_index.size())
+		{
+			if (!this->m_loop)
+				return SOURCE_END;
+
+			next = 0;
+			++this->m_loops;
+			this->m_resync = true;
+			this->m_anchored = false;
+		}
+
+		if (!this->LoadChunk(next))
+		{
+			// skip the damaged chunk, give up if none of them can be read
+			if (++failures > this->m_index.size())
+				return SOURCE_ERROR;
+			this->m_current = next;
+			this->m_frame = this->m_index[next].frames;
+		}
+	}
+
+	// look at the frame without consuming it, it may not be due yet
+	if (!this->Peek())
+	{
+		printf("%s: bad frame in chunk %zu, skipping the rest of it\n", this->m_path.c_str(), this->m_current);
+		this->m_frame = this->m_index[this->m_current].frames;
+		return SOURCE_NONE;
+	}
+	const frame_data& next = this->m_next;
+
+	if (this->m_realtime)
+	{
+		if (!this->m_anchored || next.timestamp < this->m_startTimestamp)
+		{
+			this->m_startTime = std::chrono::steady_clock::now();
+			this->m_startTimestamp = next.timestamp;
+			this->m_anchored = true;
+		}
+
+		// a seek or Stop() wakes the wait up, the frame is looked at again next time
+		const std::chrono::steady_clock::time_point due =
+			this->m_startTime + std::chrono::microseconds(next.timestamp - this->m_startTimestamp);
+		if (!this->WaitUntil(due, timeout))
+			return SOURCE_NONE;
+	}
+	else
+	{
+		// re-anchor when switched back to real time
+		this->m_anchored = false;
+	}
+
+	frame.count = next.count;
+	std::memcpy(frame.bodies, next.bodies, next.count * sizeof(body_data));
+
+	// continue the clock from the last frame handed out instead of jumping
+	if (this->m_resync)
+	{
+		if (this->m_played > 0)
+			this->m_timeOffset = this->m_lastTimestamp + this->m_period - next.timestamp;
+		this->m_resync = false;
+	}
+	frame.timestamp = next.timestamp + this->m_timeOffset;
+	this->m_lastTimestamp = frame.timestamp;
+
+	this->m_hasNext = false;
+	++this->m_frame;
+	++this->m_played;
+	this->m_position = next.timestamp - this->m_index.front().firstTimestamp;
+	return SOURCE_FRAME;
+}
+
+bool MyReplaySource::canWait() const
+{
+	return !this->m_realtime;
+}
+
+void MyReplaySource::Seek(uint64_t position)
+{
+	this->m_seek = (int64_t)std::min(position, this->getDuration());
+	this->Wake();
+}
+
+void MyReplaySource::setRealtime(bool realtime)
+{
+	this->m_realtime = realtime;
+	this->Wake();
+}
+
+void MyReplaySource::setLoop(bool loop)
+{
+	this->m_loop = loop;
+}
+
+bool MyReplaySource::isRealtime() const
+{
+	return this->m_realtime;
+}
+
+bool MyReplaySource::isLoop() const
+{
+	return this->m_loop;
+}
+
+uint64_t MyReplaySource::getFrames() const
+{
+	return this->m_frames;
+}
+
+uint64_t MyReplaySource::getDuration() const
+{
+	if (this->m_index.empty())
+		return 0;
+	return this->m_index.back().lastTimestamp - this->m_index.front().firstTimestamp;
+}
+
+uint64_t MyReplaySource::getPosition() const
+{
+	return this->m_position;
+}
+
+uint64_t MyReplaySource::getPlayed() const
+{
+	return this->m_played;
+}
+
+uint32_t MyReplaySource::getLoops() const
+{
+	return this->m_loops;
+}
+
+bool MyReplaySource::LoadChunk(size_t chunk)
+{
+	const chunk_entry& entry = this->m_index[chunk];
+
+	// fits in the capacity reserved by Open()
+	MyRecorder::chunk_header header;
+	this->m_chunk.resize(entry.bytes);
+	if (!SeekFile(this->m_file, entry.offset) ||
+		fread(&header, sizeof(header), 1, this->m_file) != 1 ||
+		fread(this->m_chunk.data(), 1, entry.bytes, this->m_file) != entry.bytes)
+	{
+		printf("%s: can't read chunk %zu\n", this->m_path.c_str(), chunk);
+		return false;
+	}
+
+	if (MyRecorder::Crc32(this->m_chunk.data(), this->m_chunk.size()) != header.crc)
+	{
+		printf("%s: chunk %zu is corrupted\n", this->m_path.c_str(), chunk);
+		return false;
+	}
+
+	this->m_current = chunk;
+	this->m_offset = 0;
+	this->m_frame = 0;
+	this->m_hasNext = false;
+	if (this->m_compressed)
+	{
+		this->m_codec.Reset();
+		this->m_codec.Begin(this->m_chunk.data(), this->m_chunk.size(), header.frames);
+	}
+	return true;
+}
+
+void MyReplaySource::SeekTo(uint64_t position)
+{
+	const uint64_t target = this->m_index.front().firstTimestamp + position;
+
+	// first chunk still having frames at or after the target
+	const std::vector<chunk_entry>::const_iterator it = std::lower_bound(this->m_index.begin(), this->m_index.end(), target,
+		[](const chunk_entry& entry, uint64_t timestamp) { return entry.lastTimestamp < timestamp; });
+
+	this->m_resync = true;
+	this->m_anchored = false;
+	this->m_hasNext = false;
+
+	if (it == this->m_index.end() || !this->LoadChunk(it - this->m_index.begin()))
+	{
+		// past the end, the next Acquire() loops or ends
+		this->m_current = it == this->m_index.end() ? this->m_index.size() - 1 : it - this->m_index.begin();
+		this->m_frame = this->m_index[this->m_current].frames;
+		return;
+	}
+
+	// skip the frames before the target inside the chunk, compressed ones have to be decoded
+	while (this->m_frame < this->m_index[this->m_current].frames && this->Peek())
+	{
+		if (this->m_next.timestamp >= target)
+			break;
+
+		this->m_hasNext = false;
+		++this->m_frame;
+	}
+}
+
+bool MyReplaySource::Peek()
+{
+	if (this->m_hasNext)
+		return true;
+
+	if (this->m_compressed)
+	{
+		if (!this->m_codec.Decode(this->m_next))
+			return false;
+	}
+	else
+	{
+		MyRecorder::frame_header header;
+		const size_t bodies = this->m_offset + sizeof(header);
+		if (bodies > this->m_chunk.size())
+			return false;
+		std::memcpy(&header, &this->m_chunk[this->m_offset], sizeof(header));
+		if (header.count > MAX_BODIES || bodies + header.count * sizeof(body_data) > this->m_chunk.size())
+			return false;
+
+		this->m_next.count = (int)header.count;
+		this->m_next.seq = header.seq;
+		this->m_next.timestamp = header.timestamp;
+		std::memcpy(this->m_next.bodies, &this->m_chunk[bodies], header.count * sizeof(body_data));
+		this->m_offset = bodies + header.count * sizeof(body_data);
+	}
+
+	this->m_hasNext = true;
+	return true;
+}
+
+bool MyReplaySource::ReadIndex(uint64_t size)
+{
+	// the footer is only there if the recording was stopped properly
+	MyRecorder::index_footer footer;
+	if (size < sizeof(MyRecorder::file_header) + sizeof(footer) ||
+		!SeekFile(this->m_file, size - sizeof(footer)) || fread(&footer, sizeof(footer), 1, this->m_file) != 1 ||
+		std::memcmp(footer.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+		footer.offset + (uint64_t)footer.count * sizeof(chunk_entry) + sizeof(footer) != size)
+	{
+		return false;
+	}
+
+	this->m_index.resize(footer.count);
+	if (!SeekFile(this->m_file, footer.offset) ||
+		fread(this->m_index.data(), sizeof(chunk_entry), footer.count, this->m_file) != footer.count ||
+		MyRecorder::Crc32(this->m_index.data(), footer.count * sizeof(chunk_entry)) != footer.crc)
+	{
+		printf("%s: damaged index, scanning the chunks\n", this->m_path.c_str());
+		this->m_index.clear();
+		return false;
+	}
+	return true;
+}
+
+void MyReplaySource::ScanChunks(uint64_t size)
+{
+	// index every complete chunk, a crash while recording leaves a partial one at the end
+	uint64_t offset = sizeof(MyRecorder::file_header);
+	while (offset + sizeof(MyRecorder::chunk_header) <= size)
+	{
+		MyRecorder::chunk_header chunk;
+		if (!SeekFile(this->m_file, offset) || fread(&chunk, sizeof(chunk), 1, this->m_file) != 1)
+			break;
+		if (std::memcmp(chunk.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 ||
+			offset + sizeof(chunk) + chunk.bytes > size)
+		{
+			printf("%s: ignoring damaged data after byte %llu\n", this->m_path.c_str(), (unsigned long long)offset);
+			break;
+		}
+
+		chunk_entry entry;
+		entry.offset = offset;
+		entry.frames = chunk.frames;
+		entry.bytes = chunk.bytes;
+		entry.firstTimestamp = chunk.firstTimestamp;
+		entry.lastTimestamp = chunk.lastTimestamp;
+		this->m_index.push_back(entry);
+
+		offset += sizeof(chunk) + chunk.bytes;
+	}
+}
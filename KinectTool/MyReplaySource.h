@@ -0,0 +1,94 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MySkeletonSource.h"
+#include "MyRecorder.h"
+#include "MyFrameCodec.h"
+
+// std
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Plays a session recorded by MyRecorder (*.ktr) back as if it came from the sensor.
+// Frames come out either at the pace they were recorded at or as fast as the capture loop takes them,
+// the session can loop and be seeked while playing. Timestamps keep increasing across loops and seeks,
+// so the matcher never sees time go backwards. Seeking uses the index at the end of the file when there is one,
+// then decodes from the start of the chunk holding the position, at most CHUNK_FRAMES frames.
+class MyReplaySource : public MySkeletonSource {
+public:		// data structures
+	typedef MyRecorder::index_entry chunk_entry;
+
+private:	// variables
+	std::string m_path;
+	FILE* m_file;
+	std::vector<chunk_entry> m_index;		// every complete chunk, built by Open()
+	uint64_t m_frames;
+	uint64_t m_period;						// average frame interval, microseconds
+	bool m_compressed;						// chunks hold MyFrameCodec data
+
+	// capture thread only
+	std::vector<uint8_t> m_chunk;			// payload of the current chunk
+	size_t m_current;						// chunk in m_chunk, m_index.size() if none
+	size_t m_offset;						// next frame inside m_chunk, uncompressed chunks
+	uint32_t m_frame;						// frames handed out or skipped from the current chunk
+	MyFrameCodec m_codec;					// decoding the current chunk, compressed chunks
+	frame_data m_next;						// frame m_frame, read ahead to see its timestamp
+	bool m_hasNext;
+	std::chrono::steady_clock::time_point m_startTime;
+	uint64_t m_startTimestamp;
+	bool m_anchored;						// m_startTime / m_startTimestamp are valid
+	uint64_t m_timeOffset;					// added to recorded timestamps
+	uint64_t m_lastTimestamp;				// last timestamp handed out
+	bool m_resync;							// next frame follows a loop or seek
+
+	// controls, any thread
+	std::atomic<bool> m_realtime;
+	std::atomic<bool> m_loop;
+	std::atomic<int64_t> m_seek;			// requested position in microseconds, -1 if none
+
+	// statistics
+	std::atomic<uint64_t> m_played;
+	std::atomic<uint64_t> m_position;		// microseconds since the first recorded frame
+	std::atomic<uint32_t> m_loops;
+
+public:		// functions
+
+	// constructer
+	MyReplaySource(const char* path, bool realtime = true, bool loop = false);
+	~MyReplaySource();
+
+	// operations
+	bool Open();
+	void Close();
+	SOURCE_RESULT Acquire(frame_data& frame, uint32_t timeout);
+	bool canWait() const;
+
+	// jump to a position in microseconds from the first recorded frame
+	void Seek(uint64_t position);
+
+	// set data
+	void setRealtime(bool realtime);
+	void setLoop(bool loop);
+
+	// get data
+	bool isRealtime() const;
+	bool isLoop() const;
+	uint64_t getFrames() const;
+	uint64_t getDuration() const;
+	uint64_t getPosition() const;
+	uint64_t getPlayed() const;
+	uint32_t getLoops() const;
+
+private:	// functions
+	bool ReadIndex(uint64_t size);
+	void ScanChunks(uint64_t size);
+	bool LoadChunk(size_t chunk);
+	bool Peek();
+	void SeekTo(uint64_t position);
+};
@@ -0,0 +1,64 @@
+#pragma once
+// std
+#include <array>
+#include <cstddef>
+
+// Fixed-capacity FIFO that never touches the heap.
+// Storage lives inside the object, pushing into a full buffer overwrites the oldest element.
+template <typename T, size_t N>
+class MyRingBuffer {
+private:	// variables
+	std::array<T, N> m_data;
+	size_t m_head;		// index of the oldest element
+	size_t m_size;
+
+public:		// functions
+
+	// constructer
+	MyRingBuffer() : m_head(0), m_size(0) {}
+
+	// get data
+	size_t size() const { return this->m_size; }
+	bool empty() const { return this->m_size == 0; }
+	bool full() const { return this->m_size == N; }
+	static constexpr size_t capacity() { return N; }
+
+	T& front() { return this->m_data[this->m_head]; }
+	const T& front() const { return this->m_data[this->m_head]; }
+	T& back() { return this->m_data[(this->m_head + this->m_size - 1) % N]; }
+	const T& back() const { return this->m_data[(this->m_head + this->m_size - 1) % N]; }
+
+	// i = 0 is the oldest element
+	T& operator[](size_t i) { return this->m_data[(this->m_head + i) % N]; }
+	const T& operator[](size_t i) const { return this->m_data[(this->m_head + i) % N]; }
+
+	// operations
+	void push(const T& value)
+	{
+		if (this->m_size == N)
+		{
+			this->m_data[this->m_head] = value;
+			this->m_head = (this->m_head + 1) % N;
+		}
+		else
+		{
+			this->m_data[(this->m_head + this->m_size) % N] = value;
+			++this->m_size;
+		}
+	}
+
+	void pop()
+	{
+		if (this->m_size == 0)
+			return;
+
+		this->m_head = (this->m_head + 1) % N;
+		--this->m_size;
+	}
+
+	void clear()
+	{
+		this->m_head = 0;
+		this->m_size = 0;
+	}
+};
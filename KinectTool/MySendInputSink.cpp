@@ -0,0 +1,45 @@
+#include "MySendInputSink.h"
+
+#include <cstdio>
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+bool MySendInputSink::Open()
+{
+#if defined(_WIN32)
+	return true;
+#else
+	printf("SendInput is only available on Windows\n");
+	return false;
+#endif
+}
+
+void MySendInputSink::Close()
+{
+}
+
+bool MySendInputSink::Send(int key, KEY_ACTION action)
+{
+#if defined(_WIN32)
+	// a tap goes in one call, nothing else can get between the press and the release
+	INPUT inputs[2] = {};
+	inputs[0].type = INPUT_KEYBOARD;
+	inputs[0].ki.wVk = (WORD)key;
+	inputs[0].ki.dwFlags = action == KEY_RELEASE ? KEYEVENTF_KEYUP : 0;
+	inputs[1] = inputs[0];
+	inputs[1].ki.dwFlags = KEYEVENTF_KEYUP;
+
+	const UINT count = action == KEY_TAP ? 2 : 1;
+	return SendInput(count, inputs, sizeof(INPUT)) == count;
+#else
+	(void)key;
+	(void)action;
+	return false;
+#endif
+}
+
+const char* MySendInputSink::getName() const
+{
+	return "SendInput";
+}
@@ -0,0 +1,16 @@
+#pragma once
+// my classes
+#include "MyKeySink.h"
+
+// Keys go to the focused window through the Win32 SendInput queue, as if typed. Windows only.
+class MySendInputSink : public MyKeySink {
+public:		// functions
+
+	// operations
+	bool Open();
+	void Close();
+	bool Send(int key, KEY_ACTION action);
+
+	// get data
+	const char* getName() const;
+};
@@ -0,0 +1,432 @@
+#pragma once
+// std
+#include <cmath>
+#include <cstdint>
+
+// Everything that differs between sensors, as compile time traits, so code above them is written once.
+// A sensor is a tag type with a sensor_traits specialization holding:
+//   skeleton						joint data as the sensor delivers it, saved files keep this layout
+//   ID, NAME, JOINTS, ROOT			saved file id, short name, joint count, joint without a parent
+//   BONES, bones[]					joint, parent pairs, every parent comes before its children
+//   names[]						joint names for the GUI
+//   BONE_AXIS[], Y_DOWN			axis of a joint orientation along its bone, camera space y pointing down
+//   Tracked, Orientation, Position	read a joint, orientation as w, x, y, z and position in meters
+//   State							the sensor's own tracking state or confidence, 0 .. MAX_STATE
+//   SetTracked, SetOrientation, SetPosition, SetState
+// Everything is constexpr or inline, picking a sensor costs nothing at run time.
+// The code that only needs the traits (joint comparison, bone lengths, ghosts, the codec's quantizer, the pose library)
+// is templated on the sensor too, KinectBench runs it on test_sensor to keep it honest about joint counts and bone tables.
+
+// sensor ids written into saved files
+#define SENSOR_K4W 1
+#define SENSOR_K4A 2
+#define SENSOR_TEST 3
+
+// the K4W types are always there, from the sdk or from MyKinectTypes.h
+#if defined(K4W)
+#include <Kinect.h>
+#else
+#include "MyKinectTypes.h"
+#endif
+
+// the K4A ones only with the body tracking sdk
+#if defined(K4A)
+#define KT_HAS_K4A
+#elif defined(__has_include)
+#if __has_include(<k4abt.h>)
+#define KT_HAS_K4A
+#endif
+#endif
+#if defined(KT_HAS_K4A)
+#include <k4a/k4a.h>
+#include <k4abt.h>
+#endif
+
+template <typename Sensor>
+struct sensor_traits;
+
+// kinect for windows, also what KSIM replays
+struct k4w_sensor {};
+
+template <>
+struct sensor_traits<k4w_sensor> {
+	struct skeleton {
+		Joint joints[JointType_Count];
+		JointOrientation orientations[JointType_Count];
+	};
+
+	static constexpr int ID = SENSOR_K4W;
+	static constexpr const char* NAME = "k4w";
+	static constexpr int JOINTS = (int)JointType_Count;
+	static constexpr int ROOT = JointType_SpineBase;
+	static constexpr int BONES = 24;
+	static constexpr int bones[BONES * 2] = {
+		// joint					parent
+		JointType_SpineMid,			JointType_SpineBase,
+		JointType_SpineShoulder,	JointType_SpineMid,
+		JointType_Neck,				JointType_SpineShoulder,
+		JointType_ShoulderLeft,		JointType_SpineShoulder,
+		JointType_ElbowLeft,		JointType_ShoulderLeft,
+		JointType_WristLeft,		JointType_ElbowLeft,
+		JointType_HandLeft,			JointType_WristLeft,
+		JointType_HandTipLeft,		JointType_HandLeft,
+		JointType_ThumbLeft,		JointType_WristLeft,
+		JointType_ShoulderRight,	JointType_SpineShoulder,
+		JointType_ElbowRight,		JointType_ShoulderRight,
+		JointType_WristRight,		JointType_ElbowRight,
+		JointType_HandRight,		JointType_WristRight,
+		JointType_HandTipRight,		JointType_HandRight,
+		JointType_ThumbRight,		JointType_WristRight,
+		JointType_HipLeft,			JointType_SpineBase,
+		JointType_KneeLeft,			JointType_HipLeft,
+		JointType_AnkleLeft,		JointType_KneeLeft,
+		JointType_FootLeft,			JointType_AnkleLeft,
+		JointType_HipRight,			JointType_SpineBase,
+		JointType_KneeRight,		JointType_HipRight,
+		JointType_AnkleRight,		JointType_KneeRight,
+		JointType_FootRight,		JointType_AnkleRight,
+		JointType_Head,				JointType_Neck
+	};
+	static constexpr const char* names[JOINTS] = {
+		"JointType_SpineBase", "JointType_SpineMid", "JointType_Neck", "JointType_Head",
+		"JointType_ShoulderLeft", "JointType_ElbowLeft", "JointType_WristLeft", "JointType_HandLeft",
+		"JointType_ShoulderRight", "JointType_ElbowRight", "JointType_WristRight", "JointType_HandRight",
+		"JointType_HipLeft", "JointType_KneeLeft", "JointType_AnkleLeft", "JointType_FootLeft",
+		"JointType_HipRight", "JointType_KneeRight", "JointType_AnkleRight", "JointType_FootRight",
+		"JointType_SpineShoulder", "JointType_HandTipLeft", "JointType_ThumbLeft", "JointType_HandTipRight",
+		"JointType_ThumbRight"
+	};
+	static constexpr float BONE_AXIS[3] = { 0.0f, 1.0f, 0.0f };
+	static constexpr bool Y_DOWN = false;
+
+	static constexpr int MAX_STATE = TrackingState_Tracked;
+
+	static bool Tracked(const skeleton& s, int joint)
+	{
+		return s.joints[joint].TrackingState >= TrackingState_Tracked;
+	}
+
+	static int State(const skeleton& s, int joint)
+	{
+		return (int)s.joints[joint].TrackingState;
+	}
+
+	static void Orientation(const skeleton& s, int joint, float q[4])
+	{
+		q[0] = s.orientations[joint].Orientation.w;
+		q[1] = s.orientations[joint].Orientation.x;
+		q[2] = s.orientations[joint].Orientation.y;
+		q[3] = s.orientations[joint].Orientation.z;
+	}
+
+	static void Position(const skeleton& s, int joint, float p[3])
+	{
+		p[0] = s.joints[joint].Position.X;
+		p[1] = s.joints[joint].Position.Y;
+		p[2] = s.joints[joint].Position.Z;
+	}
+
+	static void SetTracked(skeleton& s, int joint, bool tracked)
+	{
+		s.joints[joint].JointType = (JointType)joint;
+		s.joints[joint].TrackingState = tracked ? TrackingState_Tracked : TrackingState_NotTracked;
+	}
+
+	static void SetOrientation(skeleton& s, int joint, const float q[4])
+	{
+		s.orientations[joint].JointType = (JointType)joint;
+		s.orientations[joint].Orientation.w = q[0];
+		s.orientations[joint].Orientation.x = q[1];
+		s.orientations[joint].Orientation.y = q[2];
+		s.orientations[joint].Orientation.z = q[3];
+	}
+
+	static void SetPosition(skeleton& s, int joint, const float p[3])
+	{
+		s.joints[joint].Position.X = p[0];
+		s.joints[joint].Position.Y = p[1];
+		s.joints[joint].Position.Z = p[2];
+	}
+
+	static void SetState(skeleton& s, int joint, int state)
+	{
+		s.joints[joint].JointType = (JointType)joint;
+		s.joints[joint].TrackingState = (TrackingState)state;
+	}
+};
+
+#if defined(KT_HAS_K4A)
+// kinect for azure
+struct k4a_sensor {};
+
+template <>
+struct sensor_traits<k4a_sensor> {
+	typedef k4abt_skeleton_t skeleton;
+
+	static constexpr int ID = SENSOR_K4A;
+	static constexpr const char* NAME = "k4a";
+	static constexpr int JOINTS = (int)K4ABT_JOINT_COUNT;
+	static constexpr int ROOT = K4ABT_JOINT_PELVIS;
+	static constexpr int BONES = 31;
+	static constexpr int bones[BONES * 2] = {
+		// joint						parent
+		K4ABT_JOINT_SPINE_NAVEL,		K4ABT_JOINT_PELVIS,
+		K4ABT_JOINT_SPINE_CHEST,		K4ABT_JOINT_SPINE_NAVEL,
+		K4ABT_JOINT_NECK,				K4ABT_JOINT_SPINE_CHEST,
+		K4ABT_JOINT_CLAVICLE_LEFT,		K4ABT_JOINT_SPINE_CHEST,
+		K4ABT_JOINT_SHOULDER_LEFT,		K4ABT_JOINT_CLAVICLE_LEFT,
+		K4ABT_JOINT_ELBOW_LEFT,			K4ABT_JOINT_SHOULDER_LEFT,
+		K4ABT_JOINT_WRIST_LEFT,			K4ABT_JOINT_ELBOW_LEFT,
+		K4ABT_JOINT_HAND_LEFT,			K4ABT_JOINT_WRIST_LEFT,
+		K4ABT_JOINT_HANDTIP_LEFT,		K4ABT_JOINT_HAND_LEFT,
+		K4ABT_JOINT_THUMB_LEFT,			K4ABT_JOINT_WRIST_LEFT,
+		K4ABT_JOINT_CLAVICLE_RIGHT,		K4ABT_JOINT_SPINE_CHEST,
+		K4ABT_JOINT_SHOULDER_RIGHT,		K4ABT_JOINT_CLAVICLE_RIGHT,
+		K4ABT_JOINT_ELBOW_RIGHT,		K4ABT_JOINT_SHOULDER_RIGHT,
+		K4ABT_JOINT_WRIST_RIGHT,		K4ABT_JOINT_ELBOW_RIGHT,
+		K4ABT_JOINT_HAND_RIGHT,			K4ABT_JOINT_WRIST_RIGHT,
+		K4ABT_JOINT_HANDTIP_RIGHT,		K4ABT_JOINT_HAND_RIGHT,
+		K4ABT_JOINT_THUMB_RIGHT,		K4ABT_JOINT_WRIST_RIGHT,
+		K4ABT_JOINT_HIP_LEFT,			K4ABT_JOINT_PELVIS,
+		K4ABT_JOINT_KNEE_LEFT,			K4ABT_JOINT_HIP_LEFT,
+		K4ABT_JOINT_ANKLE_LEFT,			K4ABT_JOINT_KNEE_LEFT,
+		K4ABT_JOINT_FOOT_LEFT,			K4ABT_JOINT_ANKLE_LEFT,
+		K4ABT_JOINT_HIP_RIGHT,			K4ABT_JOINT_PELVIS,
+		K4ABT_JOINT_KNEE_RIGHT,			K4ABT_JOINT_HIP_RIGHT,
+		K4ABT_JOINT_ANKLE_RIGHT,		K4ABT_JOINT_KNEE_RIGHT,
+		K4ABT_JOINT_FOOT_RIGHT,			K4ABT_JOINT_ANKLE_RIGHT,
+		K4ABT_JOINT_HEAD,				K4ABT_JOINT_NECK,
+		K4ABT_JOINT_NOSE,				K4ABT_JOINT_HEAD,
+		K4ABT_JOINT_EYE_LEFT,			K4ABT_JOINT_HEAD,
+		K4ABT_JOINT_EAR_LEFT,			K4ABT_JOINT_HEAD,
+		K4ABT_JOINT_EYE_RIGHT,			K4ABT_JOINT_HEAD,
+		K4ABT_JOINT_EAR_RIGHT,			K4ABT_JOINT_HEAD
+	};
+	static constexpr const char* names[JOINTS] = {
+		"K4ABT_JOINT_PELVIS", "K4ABT_JOINT_SPINE_NAVEL", "K4ABT_JOINT_SPINE_CHEST", "K4ABT_JOINT_NECK",
+		"K4ABT_JOINT_CLAVICLE_LEFT", "K4ABT_JOINT_SHOULDER_LEFT", "K4ABT_JOINT_ELBOW_LEFT", "K4ABT_JOINT_WRIST_LEFT",
+		"K4ABT_JOINT_HAND_LEFT", "K4ABT_JOINT_HANDTIP_LEFT", "K4ABT_JOINT_THUMB_LEFT", "K4ABT_JOINT_CLAVICLE_RIGHT",
+		"K4ABT_JOINT_SHOULDER_RIGHT", "K4ABT_JOINT_ELBOW_RIGHT", "K4ABT_JOINT_WRIST_RIGHT", "K4ABT_JOINT_HAND_RIGHT",
+		"K4ABT_JOINT_HANDTIP_RIGHT", "K4ABT_JOINT_THUMB_RIGHT", "K4ABT_JOINT_HIP_LEFT", "K4ABT_JOINT_KNEE_LEFT",
+		"K4ABT_JOINT_ANKLE_LEFT", "K4ABT_JOINT_FOOT_LEFT", "K4ABT_JOINT_HIP_RIGHT", "K4ABT_JOINT_KNEE_RIGHT",
+		"K4ABT_JOINT_ANKLE_RIGHT", "K4ABT_JOINT_FOOT_RIGHT", "K4ABT_JOINT_HEAD", "K4ABT_JOINT_NOSE",
+		"K4ABT_JOINT_EYE_LEFT", "K4ABT_JOINT_EAR_LEFT", "K4ABT_JOINT_EYE_RIGHT", "K4ABT_JOINT_EAR_RIGHT"
+	};
+	// approximate, the body tracking sdk turns most joints with x along the bone
+	static constexpr float BONE_AXIS[3] = { 1.0f, 0.0f, 0.0f };
+	static constexpr bool Y_DOWN = true;
+
+	static constexpr int MAX_STATE = K4ABT_JOINT_CONFIDENCE_HIGH;
+
+	static bool Tracked(const skeleton& s, int joint)
+	{
+		return s.joints[joint].confidence_level >= K4ABT_JOINT_CONFIDENCE_MEDIUM;
+	}
+
+	static int State(const skeleton& s, int joint)
+	{
+		return (int)s.joints[joint].confidence_level;
+	}
+
+	static void Orientation(const skeleton& s, int joint, float q[4])
+	{
+		for (int c = 0; c < 4; ++c)
+			q[c] = s.joints[joint].orientation.v[c];
+	}
+
+	// unit = millimeter
+	static void Position(const skeleton& s, int joint, float p[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			p[c] = s.joints[joint].position.v[c] / 1000.0f;
+	}
+
+	static void SetTracked(skeleton& s, int joint, bool tracked)
+	{
+		s.joints[joint].confidence_level = tracked ? K4ABT_JOINT_CONFIDENCE_MEDIUM : K4ABT_JOINT_CONFIDENCE_NONE;
+	}
+
+	static void SetOrientation(skeleton& s, int joint, const float q[4])
+	{
+		for (int c = 0; c < 4; ++c)
+			s.joints[joint].orientation.v[c] = q[c];
+	}
+
+	static void SetPosition(skeleton& s, int joint, const float p[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			s.joints[joint].position.v[c] = p[c] * 1000.0f;
+	}
+
+	static void SetState(skeleton& s, int joint, int state)
+	{
+		s.joints[joint].confidence_level = (k4abt_joint_confidence_level_t)state;
+	}
+};
+#endif
+
+// a five joint stick figure in plain arrays, no sdk types, for checking code written against the traits
+struct test_sensor {};
+
+template <>
+struct sensor_traits<test_sensor> {
+	static constexpr int JOINTS = 5;
+
+	struct skeleton {
+		float positions[JOINTS][3];
+		float orientations[JOINTS][4];
+		bool tracked[JOINTS];
+	};
+
+	static constexpr int ID = SENSOR_TEST;
+	static constexpr const char* NAME = "test";
+	static constexpr int ROOT = 0;
+	static constexpr int BONES = 4;
+	static constexpr int bones[BONES * 2] = {
+		// joint	parent
+		1,			0,		// spine
+		2,			1,		// head
+		3,			1,		// left arm
+		4,			1		// right arm
+	};
+	static constexpr const char* names[JOINTS] = { "root", "spine", "head", "left", "right" };
+	static constexpr float BONE_AXIS[3] = { 0.0f, 1.0f, 0.0f };
+	static constexpr bool Y_DOWN = false;
+
+	static constexpr int MAX_STATE = 1;
+
+	static bool Tracked(const skeleton& s, int joint) { return s.tracked[joint]; }
+	static int State(const skeleton& s, int joint) { return s.tracked[joint] ? 1 : 0; }
+	static void Orientation(const skeleton& s, int joint, float q[4])
+	{
+		for (int c = 0; c < 4; ++c)
+			q[c] = s.orientations[joint][c];
+	}
+	static void Position(const skeleton& s, int joint, float p[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			p[c] = s.positions[joint][c];
+	}
+	static void SetTracked(skeleton& s, int joint, bool tracked) { s.tracked[joint] = tracked; }
+	static void SetState(skeleton& s, int joint, int state) { s.tracked[joint] = state != 0; }
+	static void SetOrientation(skeleton& s, int joint, const float q[4])
+	{
+		for (int c = 0; c < 4; ++c)
+			s.orientations[joint][c] = q[c];
+	}
+	static void SetPosition(skeleton& s, int joint, const float p[3])
+	{
+		for (int c = 0; c < 3; ++c)
+			s.positions[joint][c] = p[c];
+	}
+};
+
+// true if every bone joins two joints of the sensor and every parent is placed before its children,
+// code walking the bones from the root (ghosts, bone lengths) relies on it
+template <typename Sensor>
+constexpr bool BonesOrdered()
+{
+	typedef sensor_traits<Sensor> traits;
+	bool placed[traits::JOINTS] = {};
+	placed[traits::ROOT] = true;
+	for (int b = 0; b < traits::BONES; ++b)
+	{
+		const int joint = traits::bones[b * 2];
+		const int parent = traits::bones[b * 2 + 1];
+		if (joint < 0 || joint >= traits::JOINTS || parent < 0 || parent >= traits::JOINTS)
+			return false;
+		if (!placed[parent] || placed[joint])
+			return false;
+		placed[joint] = true;
+	}
+	return true;
+}
+
+static_assert(BonesOrdered<k4w_sensor>(), "k4w bones out of order");
+static_assert(BonesOrdered<test_sensor>(), "test bones out of order");
+#if defined(KT_HAS_K4A)
+static_assert(BonesOrdered<k4a_sensor>(), "k4a bones out of order");
+#endif
+
+// first joint in order, among the checked ones, that either skeleton lost or that turned more than thresh,
+// -1 if none. evaluated counts the joints looked at
+template <typename Sensor>
+int CompareJoints(const typename sensor_traits<Sensor>::skeleton& lhs, const typename sensor_traits<Sensor>::skeleton& rhs,
+	const int order[], const bool checkList[], float thresh, int& evaluated)
+{
+	typedef sensor_traits<Sensor> traits;
+	evaluated = 0;
+	for (int k = 0; k < traits::JOINTS; ++k)
+	{
+		const int i = order[k];
+		if (!checkList[i])
+			continue;
+		++evaluated;
+		if (!traits::Tracked(lhs, i) || !traits::Tracked(rhs, i))
+			return i;
+
+		float a[4];
+		float b[4];
+		traits::Orientation(lhs, i, a);
+		traits::Orientation(rhs, i, b);
+		const float diff[4] = { a[0] - b[0], a[1] - b[1], a[2] - b[2], a[3] - b[3] };
+		if (std::sqrt(diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2] + diff[3] * diff[3]) > thresh)
+			return i;
+	}
+	return -1;
+}
+
+// length of every bone with both ends tracked, by joint, the others keep what they had
+template <typename Sensor>
+void BoneLengths(const typename sensor_traits<Sensor>::skeleton& s, float lengths[])
+{
+	typedef sensor_traits<Sensor> traits;
+	for (int b = 0; b < traits::BONES; ++b)
+	{
+		const int joint = traits::bones[b * 2];
+		const int parent = traits::bones[b * 2 + 1];
+		if (!traits::Tracked(s, joint) || !traits::Tracked(s, parent))
+			continue;
+
+		float a[3];
+		float p[3];
+		traits::Position(s, joint, a);
+		traits::Position(s, parent, p);
+		lengths[joint] = std::sqrt((a[0] - p[0]) * (a[0] - p[0]) + (a[1] - p[1]) * (a[1] - p[1]) + (a[2] - p[2]) * (a[2] - p[2]));
+	}
+}
+
+// a pose from its orientations alone, put together bone by bone from the root: every joint orientation
+// turns the bone axis into the bone from the parent to the joint, BonesOrdered makes parents come first
+template <typename Sensor>
+void GhostPositions(const float orientations[][4], const float root[3], const float lengths[], float positions[][3])
+{
+	typedef sensor_traits<Sensor> traits;
+	for (int i = 0; i < traits::JOINTS; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			positions[i][c] = root[c];
+	}
+
+	const float* v = traits::BONE_AXIS;
+	for (int b = 0; b < traits::BONES; ++b)
+	{
+		const int joint = traits::bones[b * 2];
+		const int parent = traits::bones[b * 2 + 1];
+
+		// rotate the axis by the w, x, y, z quaternion
+		const float* q = orientations[joint];
+		const float t[3] = {
+			2.0f * (q[2] * v[2] - q[3] * v[1]),
+			2.0f * (q[3] * v[0] - q[1] * v[2]),
+			2.0f * (q[1] * v[1] - q[2] * v[0])
+		};
+		const float bone[3] = {
+			v[0] + q[0] * t[0] + (q[2] * t[2] - q[3] * t[1]),
+			v[1] + q[0] * t[1] + (q[3] * t[0] - q[1] * t[2]),
+			v[2] + q[0] * t[2] + (q[1] * t[1] - q[2] * t[0])
+		};
+		for (int c = 0; c < 3; ++c)
+			positions[joint][c] = positions[parent][c] + bone[c] * lengths[joint];
+	}
+}
@@ -0,0 +1,164 @@
+#include "MySharedMemory.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MySharedMemory::MySharedMemory()
+{
+	this->m_data = nullptr;
+	this->m_size = 0;
+#if defined(_WIN32)
+	this->m_mapping = NULL;
+#else
+	this->m_fd = -1;
+	this->m_owner = false;
+#endif
+}
+
+MySharedMemory::~MySharedMemory()
+{
+	this->Close();
+}
+
+bool MySharedMemory::Create(const char* name, size_t size)
+{
+	this->Close();
+
+#if defined(_WIN32)
+	// the session namespace needs no privileges, an existing mapping of the same size is reused
+	this->m_name = std::string("Local\\") + name;
+	this->m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)((unsigned long long)size >> 32), (DWORD)size, this->m_name.c_str());
+	if (!this->m_mapping)
+		return false;
+
+	this->m_data = MapViewOfFile(this->m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!this->m_data)
+	{
+		this->Close();
+		return false;
+	}
+#else
+	// a crashed owner leaves the name behind, start over with a new object
+	this->m_name = std::string("/") + name;
+	shm_unlink(this->m_name.c_str());
+	this->m_fd = shm_open(this->m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (this->m_fd < 0)
+		return false;
+	this->m_owner = true;
+
+	if (ftruncate(this->m_fd, (off_t)size) != 0)
+	{
+		this->Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		this->Close();
+		return false;
+	}
+	this->m_data = data;
+#endif
+
+	this->m_size = size;
+	std::memset(this->m_data, 0, size);
+	return true;
+}
+
+bool MySharedMemory::Open(const char* name)
+{
+	this->Close();
+
+#if defined(_WIN32)
+	this->m_name = std::string("Local\\") + name;
+	this->m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, this->m_name.c_str());
+	if (!this->m_mapping)
+		return false;
+
+	this->m_data = MapViewOfFile(this->m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (!this->m_data)
+	{
+		this->Close();
+		return false;
+	}
+
+	MEMORY_BASIC_INFORMATION info;
+	if (!VirtualQuery(this->m_data, &info, sizeof(info)))
+	{
+		this->Close();
+		return false;
+	}
+	this->m_size = (size_t)info.RegionSize;
+#else
+	this->m_name = std::string("/") + name;
+	this->m_fd = shm_open(this->m_name.c_str(), O_RDWR, 0);
+	if (this->m_fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(this->m_fd, &st) != 0 || st.st_size == 0)
+	{
+		this->Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		this->Close();
+		return false;
+	}
+	this->m_data = data;
+	this->m_size = (size_t)st.st_size;
+#endif
+
+	return true;
+}
+
+void MySharedMemory::Close()
+{
+#if defined(_WIN32)
+	if (this->m_data)
+		UnmapViewOfFile(this->m_data);
+	if (this->m_mapping)
+		CloseHandle(this->m_mapping);
+	this->m_mapping = NULL;
+#else
+	if (this->m_data)
+		munmap(this->m_data, this->m_size);
+	if (this->m_fd >= 0)
+		close(this->m_fd);
+	if (this->m_owner)
+		shm_unlink(this->m_name.c_str());
+	this->m_fd = -1;
+	this->m_owner = false;
+#endif
+
+	this->m_data = nullptr;
+	this->m_size = 0;
+}
+
+bool MySharedMemory::isOpen() const
+{
+	return this->m_data != nullptr;
+}
+
+void* MySharedMemory::data() const
+{
+	return this->m_data;
+}
+
+size_t MySharedMemory::size() const
+{
+	return this->m_size;
+}
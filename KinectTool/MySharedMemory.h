@@ -0,0 +1,38 @@
+#pragma once
+// std
+#include <cstddef>
+#include <string>
+
+// Named read-write memory shared between processes on this machine.
+// Create() makes a new one (replacing what a crashed owner left behind), Open() maps one that exists.
+// The owner's Close() removes the name, processes that still map it keep their view until they close it.
+class MySharedMemory {
+private:	// variables
+	void* m_data;
+	size_t m_size;
+	std::string m_name;
+#if defined(_WIN32)
+	void* m_mapping;
+#else
+	int m_fd;
+	bool m_owner;				// removes the name on Close()
+#endif
+
+public:		// functions
+
+	// constructer
+	MySharedMemory();
+	~MySharedMemory();
+	MySharedMemory(const MySharedMemory&) = delete;
+	MySharedMemory& operator=(const MySharedMemory&) = delete;
+
+	// operations
+	bool Create(const char* name, size_t size);
+	bool Open(const char* name);
+	void Close();
+
+	// get data
+	bool isOpen() const;
+	void* data() const;
+	size_t size() const;
+};
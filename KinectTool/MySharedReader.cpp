@@ -0,0 +1,201 @@
+#include "MySharedReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+
+MySharedReader::MySharedReader()
+{
+	this->m_header = nullptr;
+	this->m_slots = nullptr;
+	this->m_reader = -1;
+	this->m_next = 0;
+
+	this->m_read = 0;
+	this->m_overruns = 0;
+	this->m_torn = 0;
+}
+
+MySharedReader::~MySharedReader()
+{
+	this->Close();
+}
+
+bool MySharedReader::Open(const char* name)
+{
+	this->Close();
+
+	if (!this->m_memory.Open(name))
+		return false;
+
+	// same sensor, same build of the frame layout
+	MySharedRing::shared_header* header = static_cast<MySharedRing::shared_header*>(this->m_memory.data());
+	if (this->m_memory.size() < sizeof(MySharedRing::shared_header) ||
+		std::memcmp(header->magic, MySharedRing::MAGIC, sizeof(MySharedRing::MAGIC)) != 0 ||
+		header->version != MySharedRing::VERSION || header->sensor != SENSOR_TYPE || header->joints != JOINTS ||
+		header->maxBodies != MAX_BODIES || header->frameSize != sizeof(frame_data) ||
+		header->slots != MySharedRing::SLOTS || header->slotSize != sizeof(MySharedRing::slot) ||
+		this->m_memory.size() < sizeof(MySharedRing::shared_header) + header->slots * header->slotSize)
+	{
+		printf("%s is not a frame ring of this version and sensor\n", name);
+		this->m_memory.Close();
+		return false;
+	}
+
+	this->m_header = header;
+	this->m_slots = reinterpret_cast<const MySharedRing::slot*>(header + 1);
+	this->m_next = header->head.load(std::memory_order_acquire);
+
+	// report progress through a free reader entry, reading works without one too
+	for (int i = 0; i < MySharedRing::MAX_READERS; ++i)
+	{
+		uint32_t expected = 0;
+		MySharedRing::reader_entry& entry = header->readers[i];
+		if (entry.active.compare_exchange_strong(expected, 1))
+		{
+			entry.next.store(this->m_next, std::memory_order_relaxed);
+			this->m_reader = i;
+			break;
+		}
+	}
+
+	this->m_read = 0;
+	this->m_overruns = 0;
+	this->m_torn = 0;
+	return true;
+}
+
+void MySharedReader::Close()
+{
+	if (!this->m_header)
+		return;
+
+	if (this->m_reader >= 0)
+		this->m_header->readers[this->m_reader].active.store(0, std::memory_order_release);
+	this->m_reader = -1;
+	this->m_header = nullptr;
+	this->m_slots = nullptr;
+	this->m_memory.Close();
+}
+
+bool MySharedReader::Next(view& v)
+{
+	if (!this->m_header)
+		return false;
+
+	uint64_t head = this->m_header->head.load(std::memory_order_acquire);
+
+	// the publisher started over in the same memory
+	if (this->m_next > head)
+		this->m_next = head;
+
+	while (this->m_next < head)
+	{
+		// the slot after the newest frame may be written right now, the ones before it are whole
+		if (head - this->m_next >= MySharedRing::SLOTS)
+		{
+			this->m_overruns += head - MySharedRing::SLOTS + 1 - this->m_next;
+			this->m_next = head - MySharedRing::SLOTS + 1;
+		}
+
+		const MySharedRing::slot& s = this->m_slots[this->m_next % MySharedRing::SLOTS];
+		const uint64_t version = s.version.load(std::memory_order_acquire);
+		if (version == 2 * this->m_next + 2)
+		{
+			v.frame = &s.frame;
+			v.index = this->m_next;
+			v.version = version;
+
+			++this->m_next;
+			++this->m_read;
+			if (this->m_reader >= 0)
+				this->m_header->readers[this->m_reader].next.store(this->m_next, std::memory_order_relaxed);
+			return true;
+		}
+
+		// overwritten by a later frame since head was read
+		++this->m_overruns;
+		++this->m_next;
+		head = this->m_header->head.load(std::memory_order_acquire);
+	}
+	return false;
+}
+
+bool MySharedReader::Latest(view& v)
+{
+	if (!this->m_header)
+		return false;
+
+	// skipped on purpose, not counted as overruns
+	const uint64_t head = this->m_header->head.load(std::memory_order_acquire);
+	if (head > 0 && this->m_next < head - 1)
+		this->m_next = head - 1;
+	return this->Next(v);
+}
+
+bool MySharedReader::Validate(const view& v)
+{
+	// seqlock read: everything read from the frame before the version is checked again
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const MySharedRing::slot& s = this->m_slots[v.index % MySharedRing::SLOTS];
+	if (s.version.load(std::memory_order_relaxed) == v.version)
+		return true;
+
+	++this->m_torn;
+	return false;
+}
+
+bool MySharedReader::Read(frame_data& frame, bool latest)
+{
+	view v;
+	while (latest ? this->Latest(v) : this->Next(v))
+	{
+		// a torn count must not overrun the copy
+		const int count = std::max(0, std::min(v.frame->count, MAX_BODIES));
+		frame.count = count;
+		frame.failed = v.frame->failed;
+		frame.timestamp = v.frame->timestamp;
+		frame.seq = v.frame->seq;
+		frame.acquired = v.frame->acquired;
+		std::memcpy(frame.bodies, v.frame->bodies, count * sizeof(body_data));
+		if (this->Validate(v))
+			return true;
+	}
+	return false;
+}
+
+bool MySharedReader::isOpen() const
+{
+	return this->m_header != nullptr;
+}
+
+bool MySharedReader::isLive() const
+{
+	return this->m_header && this->m_header->live.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t MySharedReader::getLag() const
+{
+	if (!this->m_header)
+		return 0;
+
+	const uint64_t head = this->m_header->head.load(std::memory_order_relaxed);
+	return head > this->m_next ? head - this->m_next : 0;
+}
+
+uint64_t MySharedReader::getRead() const
+{
+	return this->m_read;
+}
+
+uint64_t MySharedReader::getOverruns() const
+{
+	return this->m_overruns;
+}
+
+uint64_t MySharedReader::getTorn() const
+{
+	return this->m_torn;
+}
@@ -0,0 +1,70 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MySharedMemory.h"
+#include "MySharedRing.h"
+
+// std
+#include <cstdint>
+
+// Reads the frames MySharedRing publishes, from another process, without copies, locks or system calls.
+// Next() and Latest() point a view at a frame inside the shared memory, the frame can be read in place and
+// Validate() tells afterwards whether the publisher overwrote it meanwhile (then whatever was read is garbage,
+// including `count`). Read() does the same and copies the frame out, retrying until it gets a whole one.
+// When the publisher stops isLive() turns false, Open() again to follow a new one.
+//
+//   MySharedReader reader;
+//   MySharedReader::view v;
+//   if (reader.Open())
+//       while (reader.isLive())
+//           if (reader.Next(v)) { use(*v.frame); if (!reader.Validate(v)) discard(); }
+class MySharedReader {
+public:		// data structures
+	struct view {
+		const frame_data* frame;
+		uint64_t index;					// position in the ring, counts every published frame
+		uint64_t version;				// slot version the frame was seen with
+	};
+
+private:	// variables
+	MySharedMemory m_memory;
+	MySharedRing::shared_header* m_header;
+	const MySharedRing::slot* m_slots;
+	int m_reader;						// claimed reader entry, -1 if all were taken
+	uint64_t m_next;					// next frame to read
+
+	// statistics
+	uint64_t m_read;
+	uint64_t m_overruns;				// frames overwritten before they were read
+	uint64_t m_torn;					// frames overwritten while they were read
+
+public:		// functions
+
+	// constructer
+	MySharedReader();
+	~MySharedReader();
+
+	// operations
+	// starts at the next frame published
+	bool Open(const char* name = MySharedRing::DEFAULT_NAME);
+	void Close();
+
+	// oldest frame not read yet, false if there is none
+	bool Next(view& v);
+	// newest frame, skipping the ones in between, false if nothing new was published
+	bool Latest(view& v);
+	// true if the frame of the view was whole from Next() / Latest() until now
+	bool Validate(const view& v);
+	// copy of the next (or newest) whole frame
+	bool Read(frame_data& frame, bool latest = false);
+
+	// get data
+	bool isOpen() const;
+	bool isLive() const;				// the publisher still runs
+	uint64_t getLag() const;			// frames published and not read yet
+	uint64_t getRead() const;
+	uint64_t getOverruns() const;
+	uint64_t getTorn() const;
+};
@@ -0,0 +1,136 @@
+#include "MySharedRing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+
+static_assert(sizeof(MySharedRing::shared_header) % 64 == 0, "slots must start on a cache line");
+
+MySharedRing::MySharedRing()
+{
+	this->m_header = nullptr;
+	this->m_busy = false;
+	this->m_head = 0;
+}
+
+MySharedRing::~MySharedRing()
+{
+	this->Stop();
+}
+
+bool MySharedRing::Start(const char* name)
+{
+	if (this->m_header)
+		return false;
+
+	const size_t size = sizeof(shared_header) + SLOTS * sizeof(slot);
+	if (!this->m_memory.Create(name, size))
+	{
+		printf("Can't create shared memory: %s\n", name);
+		return false;
+	}
+
+	// zeroed by Create(), every slot starts at version 0 and every reader entry is free
+	shared_header& header = *static_cast<shared_header*>(this->m_memory.data());
+	header.version = VERSION;
+	header.sensor = SENSOR_TYPE;
+	header.joints = JOINTS;
+	header.maxBodies = MAX_BODIES;
+	header.frameSize = sizeof(frame_data);
+	header.slots = SLOTS;
+	header.slotSize = sizeof(slot);
+	header.head.store(0, std::memory_order_relaxed);
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.live.store(1, std::memory_order_release);
+
+	this->m_head = 0;
+	this->m_header = &header;
+
+	printf("Sharing frames as %s\n", name);
+	return true;
+}
+
+void MySharedRing::Stop()
+{
+	shared_header* header = this->m_header.exchange(nullptr);
+	if (!header)
+		return;
+
+	// a Publish() that saw the header finishes before the memory goes away
+	while (this->m_busy)
+		std::this_thread::yield();
+
+	// readers that still map the memory see the publisher gone
+	header->live.store(0, std::memory_order_release);
+	this->m_memory.Close();
+
+	printf("Sharing stopped, %llu frames published.\n", (unsigned long long)this->m_head.load());
+}
+
+void MySharedRing::Publish(const frame_data& frame)
+{
+	// seq_cst on both, so Stop() either sees m_busy or Publish() sees nullptr
+	this->m_busy = true;
+	shared_header* header = this->m_header;
+	if (!header)
+	{
+		this->m_busy = false;
+		return;
+	}
+
+	// seqlock write: odd version, the frame, even version
+	const uint64_t n = this->m_head.load(std::memory_order_relaxed);
+	slot& s = reinterpret_cast<slot*>(header + 1)[n % SLOTS];
+	s.version.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	CopyFrame(s.frame, frame);
+
+	s.version.store(2 * n + 2, std::memory_order_release);
+	this->m_head.store(n + 1, std::memory_order_relaxed);
+	header->head.store(n + 1, std::memory_order_release);
+	this->m_busy.store(false, std::memory_order_release);
+}
+
+bool MySharedRing::isPublishing() const
+{
+	return this->m_header != nullptr;
+}
+
+uint64_t MySharedRing::getPublished() const
+{
+	return this->m_head;
+}
+
+int MySharedRing::getReaders() const
+{
+	const shared_header* header = this->m_header;
+	if (!header)
+		return 0;
+
+	int count = 0;
+	for (const reader_entry& reader : header->readers)
+		count += reader.active.load(std::memory_order_relaxed) ? 1 : 0;
+	return count;
+}
+
+uint64_t MySharedRing::getReaderLag() const
+{
+	const shared_header* header = this->m_header;
+	if (!header)
+		return 0;
+
+	const uint64_t head = header->head.load(std::memory_order_relaxed);
+	uint64_t lag = 0;
+	for (const reader_entry& reader : header->readers)
+	{
+		if (!reader.active.load(std::memory_order_relaxed))
+			continue;
+		const uint64_t next = reader.next.load(std::memory_order_relaxed);
+		if (next < head)
+			lag = std::max(lag, head - next);
+	}
+	return lag;
+}
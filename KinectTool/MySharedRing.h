@@ -0,0 +1,77 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MySharedMemory.h"
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Publishes every matched frame into shared memory so other processes on this machine (game plugins,
+// analytics) see the bodies without opening the sensor. The memory holds a header and a ring of SLOTS frames,
+// frame n goes to slot n % SLOTS behind a seqlock: the slot's version is 2n + 1 while it is written and 2n + 2
+// once it is complete. Publish() never waits for readers, one that falls SLOTS frames behind loses frames.
+// Readers (MySharedReader) look at the slots in place, any number of them, and each one that found a free
+// reader entry reports how far it has read so the publisher can show the slowest reader's lag.
+class MySharedRing {
+public:		// data structures
+	static constexpr char MAGIC[4] = { 'K', 'T', 'S', 'M' };
+	static const uint32_t VERSION = 1;
+	static const uint32_t SLOTS = 16;				// ~0.5 s at 30 fps
+	static const int MAX_READERS = 8;
+	static constexpr const char* DEFAULT_NAME = "KinectTool.frames";
+
+	struct alignas(64) reader_entry {
+		std::atomic<uint32_t> active;		// claimed by a reader, 0 if free
+		std::atomic<uint64_t> next;			// frame the reader reads next
+	};
+
+	struct alignas(64) slot {
+		std::atomic<uint64_t> version;		// odd while written
+		frame_data frame;					// only `count` bodies are written
+	};
+
+	struct alignas(64) shared_header {
+		char magic[4];						// "KTSM"
+		uint32_t version;
+		uint32_t sensor;					// SENSOR_K4W or SENSOR_K4A
+		uint32_t joints;
+		uint32_t maxBodies;
+		uint32_t frameSize;					// sizeof(frame_data)
+		uint32_t slots;
+		uint32_t slotSize;					// sizeof(slot)
+		alignas(64) std::atomic<uint32_t> live;		// 1 while the publisher runs
+		std::atomic<uint64_t> head;					// frames published, frame head - 1 is the newest
+		reader_entry readers[MAX_READERS];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must be lock free");
+
+private:	// variables
+	MySharedMemory m_memory;
+	std::atomic<shared_header*> m_header;	// nullptr while stopped, slots follow it
+	std::atomic<bool> m_busy;				// Publish() is using the memory, Stop() waits for it
+	std::atomic<uint64_t> m_head;			// frames published, written by the publishing thread only
+
+public:		// functions
+
+	// constructer
+	MySharedRing();
+	~MySharedRing();
+
+	// operations, any thread
+	bool Start(const char* name = DEFAULT_NAME);
+	void Stop();
+
+	// match stage, copies the frame into the next slot
+	void Publish(const frame_data& frame);
+
+	// get data
+	bool isPublishing() const;
+	uint64_t getPublished() const;
+	int getReaders() const;
+	uint64_t getReaderLag() const;		// frames the slowest reader is behind
+};
@@ -1,370 +1,401 @@
 #include "MySkeleton.h"
+#include "MyAllocCounter.h"
+#include "MyKinectSource.h"
+#include "MySendInputSink.h"
+#include "MyUinputSink.h"
 
 #include <fstream>
 #include <cmath>
-#include <boost/tokenizer.hpp>
-#include <Windows.h>
-
-#define VERIFY(result, error)                                                                            \
-	if (result != K4A_RESULT_SUCCEEDED)                                                                  \
-	{                                                                                                    \
-		printf("%s \n - (File: %s, Function: %s, Line: %d)\n", error, __FILE__, __FUNCTION__, __LINE__); \
-		exit(1);                                                                                         \
-	}
+#include <algorithm>
+#include <cstring>
+
+#if !defined(KT_HEADLESS)
+static const int BONES = active_traits::BONES;
+static const int MAX_INSTANCES = MAX_BODIES + MySkeleton::MAX_GHOSTS;
+static const int INSTANCE_TEXELS = JOINTS + 1;		// joints as x, y, z, state, then the instance color
+static const int SEGMENT_TEXELS = MAX_INSTANCES * INSTANCE_TEXELS;
+
+// joint states the vertex shader colors points by
+static const float JOINT_UNTRACKED = 0.0f;
+static const float JOINT_TRACKED = 1.0f;
+static const float JOINT_FAILED = 2.0f;
+
+// sensor meters to the space main.cpp looks at, flat on z = 0
+static void ToRenderSpace(const float p[3], float* out)
+{
+	const float scale = active_traits::Y_DOWN ? -10.0f : 10.0f;
+	out[0] = p[0] * scale;
+	out[1] = p[1] * scale;
+	out[2] = 0.0f;
+}
+
+// the library keeps orientations only, a ghost gets the bone lengths from elsewhere
+static void GhostPositions(const MyPoseLibrary& library, size_t pose, const float root[3], const std::array<float, JOINTS>& lengths, float positions[][3])
+{
+	float orientations[JOINTS][4];
+	for (int i = 0; i < JOINTS; ++i)
+		library.getOrientation(pose, i, orientations[i]);
+	GhostPositions<active_sensor>(orientations, root, lengths.data(), positions);
+}
 
-#if defined(K4A)
-static const int indices[] = {
-	// joint						parent
-	K4ABT_JOINT_SPINE_NAVEL,		K4ABT_JOINT_PELVIS,
-	K4ABT_JOINT_SPINE_CHEST,		K4ABT_JOINT_SPINE_NAVEL,
-	K4ABT_JOINT_NECK,				K4ABT_JOINT_SPINE_CHEST,
-	K4ABT_JOINT_CLAVICLE_LEFT,		K4ABT_JOINT_SPINE_CHEST,
-	K4ABT_JOINT_SHOULDER_LEFT,		K4ABT_JOINT_CLAVICLE_LEFT,
-	K4ABT_JOINT_ELBOW_LEFT,			K4ABT_JOINT_SHOULDER_LEFT,
-	K4ABT_JOINT_WRIST_LEFT,			K4ABT_JOINT_ELBOW_LEFT,
-	K4ABT_JOINT_HAND_LEFT,			K4ABT_JOINT_WRIST_LEFT,
-	K4ABT_JOINT_HANDTIP_LEFT,		K4ABT_JOINT_HAND_LEFT,
-	K4ABT_JOINT_THUMB_LEFT,			K4ABT_JOINT_WRIST_LEFT,
-	K4ABT_JOINT_CLAVICLE_RIGHT,		K4ABT_JOINT_SPINE_CHEST,
-	K4ABT_JOINT_SHOULDER_RIGHT,		K4ABT_JOINT_CLAVICLE_RIGHT,
-	K4ABT_JOINT_ELBOW_RIGHT,		K4ABT_JOINT_SHOULDER_RIGHT,
-	K4ABT_JOINT_WRIST_RIGHT,		K4ABT_JOINT_ELBOW_RIGHT,
-	K4ABT_JOINT_HAND_RIGHT,			K4ABT_JOINT_WRIST_RIGHT,
-	K4ABT_JOINT_HANDTIP_RIGHT,		K4ABT_JOINT_HAND_RIGHT,
-	K4ABT_JOINT_THUMB_RIGHT,		K4ABT_JOINT_WRIST_RIGHT,
-	K4ABT_JOINT_HIP_LEFT,			K4ABT_JOINT_PELVIS,
-	K4ABT_JOINT_KNEE_LEFT,			K4ABT_JOINT_HIP_LEFT,
-	K4ABT_JOINT_ANKLE_LEFT,			K4ABT_JOINT_KNEE_LEFT,
-	K4ABT_JOINT_FOOT_LEFT,			K4ABT_JOINT_ANKLE_LEFT,
-	K4ABT_JOINT_HIP_RIGHT,			K4ABT_JOINT_PELVIS,
-	K4ABT_JOINT_KNEE_RIGHT,			K4ABT_JOINT_HIP_RIGHT,
-	K4ABT_JOINT_ANKLE_RIGHT,		K4ABT_JOINT_KNEE_RIGHT,
-	K4ABT_JOINT_FOOT_RIGHT,			K4ABT_JOINT_ANKLE_RIGHT,
-	K4ABT_JOINT_HEAD,				K4ABT_JOINT_NECK,
-	K4ABT_JOINT_NOSE,				K4ABT_JOINT_HEAD,
-	K4ABT_JOINT_EYE_LEFT,			K4ABT_JOINT_HEAD,
-	K4ABT_JOINT_EAR_LEFT,			K4ABT_JOINT_HEAD,
-	K4ABT_JOINT_EYE_RIGHT,			K4ABT_JOINT_HEAD,
-	K4ABT_JOINT_EAR_RIGHT,			K4ABT_JOINT_HEAD
-};
-#elif defined(K4W)
-static const int indices[] = {
-	// joint					parent
-	JointType_SpineMid,			JointType_SpineBase,
-	JointType_SpineShoulder,	JointType_SpineMid,
-	JointType_Neck,				JointType_SpineShoulder,
-	JointType_ShoulderLeft,		JointType_SpineShoulder,
-	JointType_ElbowLeft,		JointType_ShoulderLeft,
-	JointType_WristLeft,		JointType_ElbowLeft,
-	JointType_HandLeft,			JointType_WristLeft,
-	JointType_HandTipLeft,		JointType_HandLeft,
-	JointType_ThumbLeft,		JointType_WristLeft,
-	JointType_ShoulderRight,	JointType_SpineShoulder,
-	JointType_ElbowRight,		JointType_ShoulderRight,
-	JointType_WristRight,		JointType_ElbowRight,
-	JointType_HandRight,		JointType_WristRight,
-	JointType_HandTipRight,		JointType_HandRight,
-	JointType_ThumbRight,		JointType_WristRight,
-	JointType_HipLeft,			JointType_SpineBase,
-	JointType_KneeLeft,			JointType_HipLeft,
-	JointType_AnkleLeft,		JointType_KneeLeft,
-	JointType_FootLeft,			JointType_AnkleLeft,
-	JointType_HipRight,			JointType_SpineBase,
-	JointType_KneeRight,		JointType_HipRight,
-	JointType_AnkleRight,		JointType_KneeRight,
-	JointType_FootRight,		JointType_AnkleRight,
-	JointType_Head,				JointType_Neck,
-};
+// one instance: joints then the color
+static void WriteInstance(float* texels, const float positions[][3], const float* states, const float color[4])
+{
+	for (int i = 0; i < JOINTS; ++i)
+	{
+		ToRenderSpace(positions[i], texels + i * 4);
+		texels[i * 4 + 3] = states[i];
+	}
+	std::memcpy(texels + JOINTS * 4, color, sizeof(float) * 4);
+}
 #endif
 
-MySkeleton::MySkeleton()
+// indexes the configuration's library under its joints, extending the index it had where that one still fits
+static void Reindex(MySkeleton::matcher_config& config)
 {
-	this->m_window = nullptr;
-	this->m_thread = nullptr;
+	std::shared_ptr<MyPoseIndex> index = std::make_shared<MyPoseIndex>();
+	index->Build(*config.library, config.checkList, config.index.get());
+	config.index = index;
+}
 
-#if defined(K4A)
-	this->m_device = NULL;
-	this->m_tracker = NULL;
-#elif defined(K4W)
-	this->m_sensor = nullptr;
-	this->m_reader = nullptr;
-#endif
+// an empty library, no gestures, every joint checked, recording
+static MySkeleton::matcher_config* DefaultConfig()
+{
+	MySkeleton::matcher_config* config = new MySkeleton::matcher_config();
+	config->library = std::make_shared<MyPoseLibrary>();
+	config->gestures = std::make_shared<MyGestureMatcher::gesture_set>();
+	config->checkList.fill(true);
+	config->jointThresh = 1.0f;
+	config->gestureThresh = 0.3f;
+	config->holdTime = MyStabilityDetector().getHoldTime();
+	config->mode = RECORD;
+	Reindex(*config);
+	return config;
+}
 
-	this->m_currentSkeleton = nullptr;
-	this->m_matchPose = nullptr;
+MySkeleton::MySkeleton() : m_config(DefaultConfig())
+{
+	this->m_window = nullptr;
+	this->m_thread = nullptr;
+	this->m_matchThread = nullptr;
+	this->m_dispatchThread = nullptr;
+	this->m_running = false;
+	this->m_matching = false;
+	this->m_keyQueue.setPolicy(DROP_NEWEST);
+	this->m_keyQueue.setReserve(KEY_RESERVE);
+
+	this->m_source = nullptr;
+	this->m_ownSource = false;
+	this->m_sink = nullptr;
+	this->m_ownSink = false;
+	this->m_keysSent = 0;
+	this->m_keysFailed = 0;
+	this->m_keyDepth = 0;
+	this->m_emptyFrames = 0;
+
+	frame_data empty = {};
+	empty.failed = -1;
+	this->m_frames.reset(empty);
+	this->m_acquired = empty;
+	this->m_frameSeq = 0;
+	this->m_matchId = 0;
+	this->m_hasMatch = false;
 
-	this->m_checkList.fill(1);
 	this->m_failed = -1;
-	this->m_jointThresh = 1.0f;
+	this->m_matchConfig = nullptr;
 
-	this->m_mode = RECORD;
+	this->m_captureAllocs = 0;
 
+	for (body_state& body : this->m_bodies)
+	{
+		body.id = 0;
+		body.active = false;
+		body.lastSeen = 0;
+		body.held = false;
+		MySkeleton::ResetTrigger(body.trigger);
+	}
+	this->m_triggerGeneration = 0;
+	this->m_slots.fill(0);
+	this->m_tracked = 0;
+	this->m_jobFrame = nullptr;
+	this->m_jobTree = false;
+	this->m_indexUsage = { 0, 0.0f, 0 };
+
+	for (int j = 0; j < JOINTS; ++j)
+		this->m_compareOrder[j] = j;
+	this->m_compareRejects.fill(0);
+	this->m_compareJoints = 0;
+	this->m_compares = 0;
+
+	this->m_processed = 0;
+	this->m_processTime = 0;
+	this->m_processMax = 0;
+
+#if !defined(KT_HEADLESS)
+	this->m_vao = NULL;
 	this->m_ebo = NULL;
-	this->m_vbo = NULL;
-	this->m_vbo_confidence = NULL;
-
-	this->m_checkList.fill(1);
+	this->m_jointBuffer = NULL;
+	this->m_jointTexture = NULL;
+	this->m_segment = RING_SEGMENTS - 1;
+	this->m_instances = 0;
+	this->m_drawnSeq = 0;
+	this->m_drawnGeneration = 0;
+	this->m_program = NULL;
+	this->m_uJoints = -1;
+	this->m_uBase = -1;
+	this->m_uStride = -1;
+	this->m_uMode = -1;
+	this->m_ghosts.fill(-1);
+	this->m_ghostsChanged = false;
+	this->m_boneLength.fill(0.2f);
+#endif
 }
 
-MySkeleton::~MySkeleton() {}
+MySkeleton::~MySkeleton()
+{
+	if (this->m_ownSource)
+		delete this->m_source;
+	if (this->m_ownSink)
+		delete this->m_sink;
+}
 
-void MySkeleton::Init(GLFWwindow *window)
+void MySkeleton::Init(GLFWwindow *window, MySkeletonSource* source, MyKeySink* sink)
 {
 	this->m_window = window;
 
-	// - vbo for vertices position
-	glGenBuffers(1, &this->m_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, 3 * sizeof(float) * JOINTS, NULL, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	// - vbo for confidence level
-	glGenBuffers(1, &this->m_vbo_confidence);
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo_confidence);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(int) * JOINTS, NULL, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+#if !defined(KT_HEADLESS)
+	// - vao, the vertex shader fetches everything by instance and joint, so it only holds the bones
+	glGenVertexArrays(1, &this->m_vao);
+	glBindVertexArray(this->m_vao);
 
 	// - ebo
 	glGenBuffers(1, &this->m_ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), &indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(active_traits::bones), active_traits::bones, GL_STATIC_DRAW);
+	glBindVertexArray(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	// Setup camera
-#if defined(K4A)
-	k4a_device_configuration_t device_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-	device_config.depth_mode = K4A_DEPTH_MODE_NFOV_UNBINNED;
+	// - joint ring, RING_SEGMENTS uploads of every instance
+	glGenBuffers(1, &this->m_jointBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, this->m_jointBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, RING_SEGMENTS * SEGMENT_TEXELS * 4 * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-	VERIFY(k4a_device_open(0, &this->m_device), "Open K4A Device failed!");
-	VERIFY(k4a_device_start_cameras(this->m_device, &device_config), "Start K4A cameras failed!");
-
-	k4a_calibration_t sensor_calibration;
-	VERIFY(k4a_device_get_calibration(this->m_device, device_config.depth_mode, K4A_COLOR_RESOLUTION_OFF, &sensor_calibration),
-		"Get depth camera calibration failed!");
+	glGenTextures(1, &this->m_jointTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, this->m_jointTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->m_jointBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+#endif
 
-	k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
-	VERIFY(k4abt_tracker_create(&sensor_calibration, tracker_config, &m_tracker), "Body tracker initialization failed!");
-#elif defined(K4W)
-	if (GetDefaultKinectSensor(&this->m_sensor) != S_OK)
+	// Setup camera, or whatever feeds us frames instead
+	if (!source)
 	{
-		printf("Get Sensor failed\n");
+#if defined(K4A) || defined(K4W)
+		source = new MyKinectSource();
+		this->m_ownSource = true;
+#else
+		printf("No sensor in this build, a recording must be replayed\n");
 		exit(1);
+#endif
 	}
+	this->m_source = source;
 
-	if (this->m_sensor->Open() != S_OK)
-	{
-		printf("Can't open sensor\n");
+	if (!this->m_source->Open())
 		exit(1);
-	}
 
-	IBodyFrameSource* source = NULL;
-	if (this->m_sensor->get_BodyFrameSource(&source) != S_OK)
+	// keys go to the OS unless told otherwise, matching goes on without them if that fails
+	if (!sink)
 	{
-		printf("Can't open BodyFrameSource\n");
-		exit(1);
+#if defined(_WIN32)
+		sink = new MySendInputSink();
+		this->m_ownSink = true;
+#elif defined(__linux__)
+		sink = new MyUinputSink();
+		this->m_ownSink = true;
+#endif
 	}
-
-	if (source->OpenReader(&this->m_reader) != S_OK)
+	if (sink && !sink->Open())
 	{
-		printf("Can't open reader\n");
-		exit(1);
+		if (this->m_ownSink)
+			delete sink;
+		this->m_ownSink = false;
+		sink = nullptr;
 	}
-	source->Release();
-#endif
+	this->m_sink = sink;
+
+	// the match stage takes a body too, leave cores for the other stages and the GL thread
+	const int cores = (int)std::thread::hardware_concurrency();
+	this->m_pool.Start(std::max(0, std::min(MAX_BODIES - 1, cores - 3)));
+	this->m_scratch.resize(this->m_pool.size());
+
+	this->m_running = true;
 
 	printf("Done Init!\n");
 }
 
 void MySkeleton::Start()
 {
-	if (!this->m_window || this->m_thread)
+	if (!this->m_source || this->m_thread)
 		return;
 
+	// downstream first, so nothing is queued before its consumer runs
+	this->m_matching = true;
+	this->m_dispatchThread = new std::thread(&MySkeleton::DispatchStage, this);
+	this->m_matchThread = new std::thread(&MySkeleton::MatchStage, this);
 	this->m_thread = new std::thread(&MySkeleton::Update, this);
 }
 
 void MySkeleton::Update()
 {
-	while (this->m_window && !glfwWindowShouldClose(this->m_window))
+	while (this->m_running)
 	{
-#if defined(K4A)
-		k4a_capture_t sensor_capture;
-		k4a_wait_result_t get_capture_result = k4a_device_get_capture(this->m_device, &sensor_capture, K4A_WAIT_INFINITE);
-		if (get_capture_result == K4A_WAIT_RESULT_SUCCEEDED)
-		{
-			k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(m_tracker, sensor_capture, K4A_WAIT_INFINITE);
-
-			k4a_capture_release(sensor_capture);
-			if (queue_capture_result == K4A_WAIT_RESULT_TIMEOUT)
-			{
-				// It should never hit timeout when K4A_WAIT_INFINITE is set.
-				printf("Error! Add capture to tracker process queue timeout!\n");
-				break;
-			}
-			else if (queue_capture_result == K4A_WAIT_RESULT_FAILED)
-			{
-				printf("Error! Add capture to tracker process queue failed!\n");
-				break;
-			}
+		const uint64_t allocs = MyAllocCounter::ThisThread();
 
-			k4abt_frame_t body_frame = NULL;
-			k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(m_tracker, &body_frame, K4A_WAIT_INFINITE);
-			if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED)
-			{
-				this->m_currentSkeleton = nullptr;
-				if (k4abt_frame_get_num_bodies(body_frame) > 0)
-				{
-					//printf("Get!\n");
+		frame_data& current = this->m_acquired;
+		const SOURCE_RESULT result = this->m_source->Acquire(current, ACQUIRE_TIMEOUT);
+		if (result == SOURCE_END || result == SOURCE_ERROR)
+			break;
 
-					k4abt_body_t body;
-					VERIFY(k4abt_frame_get_body_skeleton(body_frame, 0, &body.skeleton), "Get body from body frame failed!");
-					body.id = k4abt_frame_get_body_id(body_frame, 0);
+		// nothing new from the source, keep the last published frame
+		if (result != SOURCE_FRAME)
+			continue;
 
-					this->m_currentSkeleton = &body.skeleton;
-				}
+		// gaps in seq show the frames the match stage had to drop
+		current.failed = -1;
+		current.seq = ++this->m_frameSeq;
+		current.acquired = Now();
 
-				k4abt_frame_release(body_frame);
-			}
-			else if (pop_frame_result == K4A_WAIT_RESULT_TIMEOUT)
-			{
-				//  It should never hit timeout when K4A_WAIT_INFINITE is set.
-				printf("Error! Pop body frame result timeout!\n");
-				break;
-			}
-			else
-			{
-				printf("Pop body frame result failed!\n");
-				break;
-			}
+		// back off while nobody is in front of the sensor, the first body brings the full rate back
+		if (current.count > 0)
+		{
+			if (this->m_emptyFrames >= IDLE_FRAMES)
+				this->m_source->setIdle(false);
+			this->m_emptyFrames = 0;
 		}
-		else if (get_capture_result == K4A_WAIT_RESULT_TIMEOUT)
+		else if (++this->m_emptyFrames == IDLE_FRAMES)
 		{
-			// It should never hit time out when K4A_WAIT_INFINITE is set.
-			printf("Error! Get depth frame time out!\n");
-			break;
+			this->m_source->setIdle(true);
+		}
+
+		// a live source never waits on the match stage, a full queue drops a frame instead
+		frame_data* slot = nullptr;
+		if (this->m_source->canWait())
+		{
+			while (!(slot = this->m_frameQueue.tryAcquire()) && this->m_running)
+				std::this_thread::yield();
 		}
 		else
 		{
-			printf("Get depth capture returned error: %d\n", get_capture_result);
-			break;
+			slot = this->m_frameQueue.acquire();
 		}
-#elif defined(K4W)
 
-		delete this->m_currentSkeleton;
-		this->m_currentSkeleton = nullptr;
-
-		IBodyFrame* bodyFrame = nullptr;
-		if (this->m_reader->AcquireLatestFrame(&bodyFrame) == S_OK)
+		if (slot)
 		{
-			IBody* bodies[6] = { 0 };
-			if (bodyFrame->GetAndRefreshBodyData(6, bodies) == S_OK)
-			{
-				for (int i = 0; i < 6; ++i)
-				{
-					IBody* body = bodies[i];
-					if (body)
-					{
-						BOOLEAN tracked = false;
-						if (body->get_IsTracked(&tracked) == S_OK && tracked)
-						{
-							this->m_currentSkeleton = new skeleton_data;
-							body->GetJoints(JOINTS, this->m_currentSkeleton->joints);
-							body->GetJointOrientations(JOINTS, this->m_currentSkeleton->orientations);
-							Sleep(10);
-							break;
-						}
-					}
-				}
-
-				for (int i = 0; i < 6; ++i)
-				{
-					bodies[i]->Release();;
-				}
-			}
+			CopyFrame(*slot, current);
+			this->m_frameQueue.commit();
 		}
-		if (bodyFrame)
-			bodyFrame->Release();
-#endif
 
-			// try to get pose
-		if (this->m_currentSkeleton)
+		// the first frames are allowed to warm up the sensor runtime and printf buffers
+		if (this->m_frameSeq > 30)
+			this->m_captureAllocs += MyAllocCounter::ThisThread() - allocs;
+	}
+
+	this->m_running = false;
+	this->m_frameQueue.wake();
+	this->m_source->Close();
+
+	printf("Stopped.\n");
+}
+
+void MySkeleton::MatchStage()
+{
+	while (true)
+	{
+		const frame_data* frame = this->m_frameQueue.wait(ACQUIRE_TIMEOUT);
+		if (!frame)
 		{
-			if (this->m_mode == RECORD)
-			{
-				if (!this->m_matchPose)
-				{
-					this->m_skeletonLog.push(*this->m_currentSkeleton);
-
-					// check the difference between the first skeleton in the queue and the current skeleton,
-					// pop the queue until finds a match.
-					while (this->m_skeletonLog.size() > 0)
-					{
-						if (MySkeleton::CompareJoint(this->m_skeletonLog.front(), this->m_skeletonLog.back()) >= 0)
-						{
-							this->m_skeletonLog.pop();
-						}
-						else
-						{
-							printf("Matched Frames: %zu\n", this->m_skeletonLog.size());
-							break;
-						}
-					}
-
-					// if the last 30 frames all matched, save this skeleton
-					if (this->m_skeletonLog.size() > 30)
-					{
-						delete this->m_matchPose;
-						this->m_matchPose = new skeleton_data(this->m_skeletonLog.front());
-					}
-				}
-				else
-				{
-					this->m_failed = MySkeleton::CompareJoint(*this->m_matchPose, *this->m_currentSkeleton);
-				}
-			}
-			else
-			{
-				for (const data& d : this->m_savedPose)
-				{
-					this->m_failed = MySkeleton::CompareJoint(d.skeleton, *this->m_currentSkeleton);
-					if (this->m_failed < 0)
-					{
-						printf("Pressing key[%d]\n", d.key);
-
-						INPUT input;
-						input.type = INPUT_KEYBOARD;
-						input.ki.wVk = d.key;
-						input.ki.wScan = 0;
-						input.ki.dwFlags = 0;
-						input.ki.time = 0;
-						input.ki.dwExtraInfo = 0;
-						SendInput(1, &input, sizeof(INPUT));
-
-						input.ki.dwFlags = KEYEVENTF_KEYUP;
-						SendInput(1, &input, sizeof(INPUT));
-
-						break;
-					}
-				}
-			}
+			// the acquire stage is done and everything it queued is matched
+			if (!this->m_running && this->m_frameQueue.size() == 0)
+				break;
+
+			// waiting, configurations replaced meanwhile can go, a take stopped meanwhile too
+			this->m_config.quiescent();
+			this->m_gestures.Tick();
+			continue;
 		}
+
+		const uint64_t allocs = MyAllocCounter::ThisThread();
+		const uint64_t begin = Now();
+
+		// write straight into the slot the GL thread is not looking at
+		frame_data& current = this->m_frames.back();
+		CopyFrame(current, *frame);
+		this->m_frameQueue.release();
+		const uint64_t acquired = current.acquired;
+
+		this->Process(current);
+		current.failed = this->m_failed;
+
+		// copied into the recorder ring, shared memory and the network queue, the slot is no longer ours after publish()
+		this->m_recorder.Push(current);
+		this->m_shared.Publish(current);
+		this->m_network.Push(current);
+
+		// hand the frame over to the GL thread
+		this->m_frames.publish();
+
+		const uint64_t end = Now();
+		const uint64_t elapsed = end - begin;
+		this->m_latency[LATENCY_QUEUE].Record(begin - acquired);
+		this->m_latency[LATENCY_MATCH].Record(elapsed);
+		this->m_latency[LATENCY_FRAME].Record(end - acquired);
+		this->m_processTime += elapsed;
+		if (elapsed > this->m_processMax)
+			this->m_processMax = elapsed;
+		++this->m_processed;
+
+		if (current.seq > 30)
+			this->m_captureAllocs += MyAllocCounter::ThisThread() - allocs;
 	}
 
-#if defined(K4A)
-	// Close camera
-	k4abt_tracker_shutdown(this->m_tracker);
-	k4abt_tracker_destroy(this->m_tracker);
-	k4a_device_stop_cameras(this->m_device);
-	k4a_device_close(this->m_device);
-#elif defined(K4W)
-	this->m_reader->Release();
-	this->m_reader = nullptr;
-	this->m_sensor->Close();
-	this->m_sensor->Release();
-	this->m_sensor = nullptr;
-#endif
+	// nothing may stay pressed once matching stops
+	this->ReleaseAll(this->m_frames.back().timestamp, Now());
+	this->m_matchConfig = nullptr;
+	this->m_config.offline();
 
-	printf("Stopped.\n");
+	// after m_matching, StopGesture sees one or the other
+	this->m_matching = false;
+	this->m_gestures.Tick();
+	this->m_keyQueue.wake();
+}
+
+void MySkeleton::DispatchStage()
+{
+	while (true)
+	{
+		const key_event* event = this->m_keyQueue.wait(ACQUIRE_TIMEOUT);
+		if (!event)
+		{
+			if (!this->m_matching && this->m_keyQueue.size() == 0)
+				break;
+			continue;
+		}
+
+		// the one just taken is still counted
+		const size_t depth = this->m_keyQueue.size() + 1;
+		if (depth > this->m_keyDepth)
+			this->m_keyDepth = depth;
+
+		if (this->m_sink && this->m_sink->Send(event->key, event->action))
+			++this->m_keysSent;
+		else
+			++this->m_keysFailed;
+
+		const uint64_t sent = Now();
+		this->m_latency[LATENCY_DISPATCH].Record(sent - event->queued);
+		this->m_latency[LATENCY_KEY].Record(sent - event->acquired);
+		this->m_keyQueue.release();
+	}
 }
 
 void MySkeleton::Stop()
@@ -376,287 +407,818 @@ void MySkeleton::Stop()
 	}
 
 	printf("Stopping skeleton worker...\n");
-	this->m_window = nullptr;
+	this->m_running = false;
+	this->m_source->Wake();
 	this->m_thread->join();
 	delete this->m_thread;
 	this->m_thread = nullptr;
+
+	// both stages drain what is left and stop on their own
+	this->m_matchThread->join();
+	delete this->m_matchThread;
+	this->m_matchThread = nullptr;
+
+	this->m_dispatchThread->join();
+	delete this->m_dispatchThread;
+	this->m_dispatchThread = nullptr;
+	if (this->m_sink)
+		this->m_sink->Close();
+
+	this->m_pool.Stop();
+}
+
+bool MySkeleton::isRunning()
+{
+	return this->m_running || this->m_matching;
 }
 
 size_t MySkeleton::getSavedAmount()
 {
-	return this->m_savedPose.size();
+	return this->m_config.current().library->size();
+}
+
+size_t MySkeleton::getGestureAmount()
+{
+	return this->m_config.current().gestures->size();
 }
 
-std::array<bool, JOINTS>& MySkeleton::getCheckList()
+const std::array<bool, JOINTS>& MySkeleton::getCheckList()
 {
-	return this->m_checkList;
+	return this->m_config.current().checkList;
 }
 
 bool MySkeleton::hasMatch()
 {
-	return this->m_matchPose ? true : false;
+	return this->m_hasMatch;
+}
+
+float MySkeleton::getHoldTime()
+{
+	return this->m_config.current().holdTime;
+}
+
+uint64_t MySkeleton::getCaptureAllocations()
+{
+	return this->m_captureAllocs;
+}
+
+uint64_t MySkeleton::getProcessedFrames()
+{
+	return this->m_processed;
+}
+
+double MySkeleton::getAverageProcessTime()
+{
+	const uint64_t frames = this->m_processed;
+	return frames ? this->m_processTime / 1000.0 / frames : 0.0;
+}
+
+double MySkeleton::getCompareJoints()
+{
+	const uint64_t compares = this->m_compares;
+	return compares ? (double)this->m_compareJoints / compares : 0.0;
+}
+
+double MySkeleton::getLibraryJoints()
+{
+	return this->m_config.current().library->getAverageJoints();
+}
+
+int MySkeleton::getEnabledJoints()
+{
+	const matcher_config& config = this->m_config.current();
+	int count = 0;
+	for (int j = 0; j < JOINTS; ++j)
+		count += config.checkList[j] ? 1 : 0;
+	return count;
+}
+
+double MySkeleton::getMaxProcessTime()
+{
+	return this->m_processMax / 1000.0;
+}
+
+MyRecorder& MySkeleton::getRecorder()
+{
+	return this->m_recorder;
+}
+
+MySharedRing& MySkeleton::getShared()
+{
+	return this->m_shared;
+}
+
+MyNetPublisher& MySkeleton::getNetwork()
+{
+	return this->m_network;
+}
+
+MyGestureMatcher& MySkeleton::getGestures()
+{
+	return this->m_gestures;
+}
+
+int MySkeleton::getTrackedBodies()
+{
+	return this->m_tracked;
+}
+
+int MySkeleton::getWorkers()
+{
+	return this->m_pool.size();
+}
+
+uint64_t MySkeleton::getDroppedFrames()
+{
+	return this->m_frameQueue.getDropped();
+}
+
+size_t MySkeleton::getQueuedFrames()
+{
+	return this->m_frameQueue.size();
+}
+
+int MySkeleton::getDropPolicy()
+{
+	return this->m_frameQueue.getPolicy();
+}
+
+const char* MySkeleton::getKeySink()
+{
+	return this->m_sink ? this->m_sink->getName() : nullptr;
+}
+
+uint64_t MySkeleton::getSentKeys()
+{
+	return this->m_keysSent;
+}
+
+uint64_t MySkeleton::getFailedKeys()
+{
+	return this->m_keysFailed;
+}
+
+uint64_t MySkeleton::getDroppedKeys()
+{
+	return this->m_keyQueue.getDropped();
+}
+
+size_t MySkeleton::getQueuedKeys()
+{
+	return this->m_keyQueue.size();
+}
+
+size_t MySkeleton::getMaxQueuedKeys()
+{
+	return this->m_keyDepth;
+}
+
+const MyLatencyHistogram& MySkeleton::getLatency(int stage)
+{
+	return this->m_latency[stage];
+}
+
+const char* MySkeleton::getLatencyName(int stage)
+{
+	static const char* names[LATENCY_COUNT] = { "queue", "match", "frame", "dispatch", "key" };
+	return names[stage];
+}
+
+void MySkeleton::setCheckList(const std::array<bool, JOINTS>& checkList)
+{
+	if (checkList == this->m_config.current().checkList)
+		return;
+
+	matcher_config* config = this->EditConfig();
+	config->checkList = checkList;
+	Reindex(*config);
+	this->m_config.publish(config);
 }
 
 void MySkeleton::setThresh(const float& thresh)
 {
-	this->m_jointThresh = thresh;
+	if (thresh == this->m_config.current().jointThresh)
+		return;
+
+	matcher_config* config = this->EditConfig();
+	config->jointThresh = thresh;
+	this->m_config.publish(config);
 }
 
-void MySkeleton::setMode(int mode)
+void MySkeleton::setHoldTime(float ms)
+{
+	if (ms == this->m_config.current().holdTime)
+		return;
+
+	matcher_config* config = this->EditConfig();
+	config->holdTime = ms;
+	this->m_config.publish(config);
+}
+
+void MySkeleton::setGestureThresh(float thresh)
 {
-	this->m_mode = mode;
+	if (thresh == this->m_config.current().gestureThresh)
+		return;
+
+	matcher_config* config = this->EditConfig();
+	config->gestureThresh = thresh;
+	this->m_config.publish(config);
 }
 
-void MySkeleton::Clear()
+void MySkeleton::setMode(int mode)
 {
-	if (!this->m_matchPose)
+	if (mode == this->m_config.current().mode)
 		return;
 
-	delete (this->m_matchPose);
-	this->m_matchPose = nullptr;
+	matcher_config* config = this->EditConfig();
+	config->mode = mode;
+	this->m_config.publish(config);
+}
 
-	this->m_failed = -1;
+void MySkeleton::setDropPolicy(int policy)
+{
+	this->m_frameQueue.setPolicy((DROP_POLICY)policy);
+}
 
-	while (!this->m_skeletonLog.empty())
+void MySkeleton::ResetLatency()
+{
+	for (MyLatencyHistogram& histogram : this->m_latency)
+		histogram.Reset();
+}
+
+bool MySkeleton::ExportLatency(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
 	{
-		this->m_skeletonLog.pop();
+		printf("Can't write latency to %s\n", path);
+		return false;
 	}
+
+	for (int stage = 0; stage < LATENCY_COUNT; ++stage)
+		this->m_latency[stage].Write(file, MySkeleton::getLatencyName(stage));
+	fclose(file);
+	return true;
+}
+
+void MySkeleton::Clear()
+{
+	if (!this->m_hasMatch)
+		return;
+
+	// the match stage stops highlighting on its next frame
+	this->m_hasMatch = false;
 }
 
 void MySkeleton::ClearAll()
 {
-	this->m_savedPose.clear();
+	matcher_config* config = this->EditConfig();
+	config->library = std::make_shared<MyPoseLibrary>();
+	Reindex(*config);
+	this->m_config.publish(config);
 	this->Clear();
 }
 
-void MySkeleton::Save(int key)
+void MySkeleton::Save(int key, const MyPoseLibrary::binding& bind)
 {
-	if (!this->m_matchPose)
+	if (!this->m_hasMatch)
 		return;
 
-	this->m_savedPose.push_back({
-		*this->m_matchPose,
-		key
-		});
+	// the match stage may be reading the library, the pose goes into a copy
+	std::shared_ptr<MyPoseLibrary> library = std::make_shared<MyPoseLibrary>();
+	library->CopyFrom(*this->m_config.current().library);
+	library->Append(this->m_matchPose, key, bind);
+
+	matcher_config* config = this->EditConfig();
+	config->library = library;
+	Reindex(*config);
+	this->m_config.publish(config);
 
 	this->Clear();
 }
 
 void MySkeleton::Import(const char *path)
 {
-	std::ifstream ifs;
-	ifs.open(path);
-	if (ifs.is_open())
+	// csv or binary library, detected from the file content, behind the poses there are.
+	// an empty library is not copied, so a binary file is still mapped in place
+	const MyPoseLibrary& current = *this->m_config.current().library;
+	std::shared_ptr<MyPoseLibrary> library = std::make_shared<MyPoseLibrary>();
+	if (current.size())
+		library->CopyFrom(current);
+	if (!library->Import(path))
 	{
-		std::string buf = "";
-		while (std::getline(ifs, buf))
-		{
-			MySkeleton::data data;
-			data.key = std::stoi(buf);
+		printf("Can't import %s\n", path);
+		return;
+	}
 
-#if defined(K4A)
-			for (int i = 0; i < JOINTS; ++i)
-			{
-				data.skeleton.joints[i].confidence_level = K4ABT_JOINT_CONFIDENCE_MEDIUM;
-				std::memset(data.skeleton.joints[i].orientation.v, 0, sizeof(data.skeleton.joints[i].orientation.v));
-
-				std::getline(ifs, buf);
-				boost::escaped_list_separator<char> sep;
-				boost::tokenizer<boost::escaped_list_separator<char>> tok(buf, sep);
-				auto it = tok.begin();
-				data.skeleton.joints[i].orientation.v[0] = std::stof(*it); ++it;
-				data.skeleton.joints[i].orientation.v[1] = std::stof(*it); ++it;
-				data.skeleton.joints[i].orientation.v[2] = std::stof(*it); ++it;
-				data.skeleton.joints[i].orientation.v[3] = std::stof(*it);
-			}
-#elif defined(K4W)
-			for (int i = 0; i < JOINTS; ++i)
-			{
-				data.skeleton.joints[i].TrackingState = TrackingState_Tracked;
-
-				std::getline(ifs, buf);
-				boost::escaped_list_separator<char> sep;
-				boost::tokenizer<boost::escaped_list_separator<char>> tok(buf, sep);
-				auto it = tok.begin();
-				data.skeleton.orientations[i].Orientation.w = stof(*it); ++it;
-				data.skeleton.orientations[i].Orientation.x = stof(*it); ++it;
-				data.skeleton.orientations[i].Orientation.y = stof(*it); ++it;
-				data.skeleton.orientations[i].Orientation.z = stof(*it);
-			}
-#endif
+	matcher_config* config = this->EditConfig();
+	config->library = library;
+	Reindex(*config);
+	this->m_config.publish(config);
+}
 
-			this->m_savedPose.push_back(data);
-		}
+void MySkeleton::SaveGesture(int key)
+{
+	std::shared_ptr<const MyGestureMatcher::gesture_set> gestures = this->m_gestures.Save(*this->m_config.current().gestures, key);
+	if (!gestures)
+		return;
 
-		ifs.close();
-	}
+	matcher_config* config = this->EditConfig();
+	config->gestures = gestures;
+	this->m_config.publish(config);
+}
+
+void MySkeleton::StopGesture()
+{
+	// the match stage hands the take over on its next frame or wait, without it nobody would
+	this->m_gestures.StopRecording();
+	if (!this->m_matching)
+		this->m_gestures.Tick();
+}
+
+void MySkeleton::ClearGestures()
+{
+	if (this->m_config.current().gestures->empty())
+		return;
+
+	matcher_config* config = this->EditConfig();
+	config->gestures = std::make_shared<MyGestureMatcher::gesture_set>();
+	this->m_config.publish(config);
 }
 
 bool MySkeleton::Export(const char *path)
 {
-	std::ofstream ofs;
-	ofs.open(path);
-	if (ofs.is_open())
-	{
-		for (const MySkeleton::data& data : this->m_savedPose)
-		{
-			ofs << data.key << std::endl;
-			for (int i = 0; i < JOINTS; ++i)
-			{
-#if defined(K4A)
-				ofs << data.skeleton.joints[i].orientation.v[0] << ',';
-				ofs << data.skeleton.joints[i].orientation.v[1] << ',';
-				ofs << data.skeleton.joints[i].orientation.v[2] << ',';
-				ofs << data.skeleton.joints[i].orientation.v[3] << '\n';
-#elif defined(K4W)
-				assert(data.skeleton.orientations[i].JointType == i);
-				ofs << data.skeleton.orientations[i].Orientation.w << ',';
-				ofs << data.skeleton.orientations[i].Orientation.x << ',';
-				ofs << data.skeleton.orientations[i].Orientation.y << ',';
-				ofs << data.skeleton.orientations[i].Orientation.z << '\n';
-#endif
-			}
-		}
-		ofs.close();
-		return true;
-	}
-	else
-		return false;
+	// *.kpl is written as a binary library, everything else as csv
+	return this->m_config.current().library->Export(path);
 }
 
+#if !defined(KT_HEADLESS)
 void MySkeleton::Load2Shader()
 {
-	skeleton_data data;
-	if (this->m_currentSkeleton)
-		data = skeleton_data(*this->m_currentSkeleton);
-	else
+	// the front slot belongs to this thread until the next update(), no copy needed
+	this->m_frames.update();
+	const frame_data& current = this->m_frames.front();
+
+	// nothing new since the last upload, the segment drawn last frame is still good
+	const MyPoseLibrary& library = *this->m_config.current().library;
+	const uint64_t generation = library.generation();
+	if (current.seq == this->m_drawnSeq && generation == this->m_drawnGeneration && !this->m_ghostsChanged)
 		return;
 
-	static std::array<float, 3 * JOINTS> vertices;
-	static std::array<int, JOINTS> confidence;
-	vertices.fill(0.0f);
-	confidence.fill(0);
+	static const float bodyColors[MAX_BODIES][4] = {
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+		{ 0.2f, 0.2f, 0.6f, 1.0f },
+		{ 0.6f, 0.2f, 0.2f, 1.0f },
+		{ 0.2f, 0.5f, 0.2f, 1.0f },
+		{ 0.5f, 0.3f, 0.0f, 1.0f },
+		{ 0.4f, 0.0f, 0.4f, 1.0f }
+	};
+	static const float ghostColor[4] = { 0.1f, 0.4f, 1.0f, 0.4f };
+
+	// next segment of the ring, the whole buffer is orphaned on wrapping so the driver hands out
+	// fresh memory while earlier draws still read the old one, and no segment is written while in use
+	const int segment = (this->m_segment + 1) % RING_SEGMENTS;
+	const GLsizeiptr segmentBytes = SEGMENT_TEXELS * 4 * sizeof(float);
+	glBindBuffer(GL_TEXTURE_BUFFER, this->m_jointBuffer);
+	if (segment == 0)
+		glBufferData(GL_TEXTURE_BUFFER, RING_SEGMENTS * segmentBytes, NULL, GL_STREAM_DRAW);
+	float* texels = (float*)glMapBufferRange(GL_TEXTURE_BUFFER, segment * segmentBytes, segmentBytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!texels)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		return;
+	}
 
-#if defined(K4A)
-	// copy to prevent async update from altering data
-	m_currentSkeleton = nullptr;
-	for (int i = 0; i < JOINTS; ++i)
+	float positions[JOINTS][3];
+	float states[JOINTS];
+	int instances = 0;
+
+	// - bodies, the failed joint belongs to the first one
+	for (int b = 0; b < current.count; ++b)
 	{
-		// unit = millimeter
-		vertices[i * 3 + 0] = (-data.joints[i].position.v[0] / 100.0f);
-		vertices[i * 3 + 1] = (-data.joints[i].position.v[1] / 100.0f);
-		vertices[i * 3 + 2] = (0.0f);
+		const skeleton_data& data = current.bodies[b].skeleton;
+		for (int i = 0; i < JOINTS; ++i)
+		{
+			GetJointPosition(data, i, positions[i]);
+			states[i] = IsJointTracked(data, i) ? JOINT_TRACKED : JOINT_UNTRACKED;
+		}
+		if (b == 0 && current.failed >= 0)
+			states[current.failed] = JOINT_FAILED;
+
+		// ghosts borrow the bone lengths of the first body
+		if (b == 0)
+			BoneLengths<active_sensor>(data, this->m_boneLength.data());
 
-		confidence[i] = data.joints[i].confidence_level < K4ABT_JOINT_CONFIDENCE_MEDIUM ? 0 : 1;
+		WriteInstance(texels + instances * INSTANCE_TEXELS * 4, positions, states, bodyColors[b]);
+		++instances;
 	}
-#elif defined(K4W)
-	//this->m_currentSkeleton = nullptr;
-	for (int i = 0; i < JOINTS; ++i)
+
+	// - ghosts, standing where the first body stands
+	float root[3] = { 0.0f, 0.0f, 0.0f };
+	if (current.count > 0)
+		GetJointPosition(current.bodies[0].skeleton, active_traits::ROOT, root);
+	for (int g = 0; g < MAX_GHOSTS; ++g)
 	{
-		// unit = meter
-		vertices[i * 3 + 0] = data.joints[i].Position.X * 10.0f;
-		vertices[i * 3 + 1] = data.joints[i].Position.Y * 10.0f;
-		vertices[i * 3 + 2] = 0;
+		const int pose = this->m_ghosts[g];
+		if (pose < 0 || (size_t)pose >= library.size())
+			continue;
 
-		confidence[i] = data.joints[i].TrackingState < TrackingState_Tracked ? 0 : 1;
+		GhostPositions(library, (size_t)pose, root, this->m_boneLength, positions);
+		for (int i = 0; i < JOINTS; ++i)
+			states[i] = library.isTracked((size_t)pose, i) ? JOINT_TRACKED : JOINT_UNTRACKED;
+		WriteInstance(texels + instances * INSTANCE_TEXELS * 4, positions, states, ghostColor);
+		++instances;
 	}
-#endif
 
-	//printf("Updating...\n");
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices.data());
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUnmapBuffer(GL_TEXTURE_BUFFER);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo_confidence);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(confidence), confidence.data());
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	this->m_segment = segment;
+	this->m_instances = instances;
+	this->m_drawnSeq = current.seq;
+	this->m_drawnGeneration = generation;
+	this->m_ghostsChanged = false;
 }
 
 void MySkeleton::Render(const GLuint& program)
 {
-	//printf("Drawing...\n");
+	if (this->m_instances == 0)
+		return;
+
+	// uniform locations only change with the program
+	if (program != this->m_program)
+	{
+		this->m_program = program;
+		this->m_uJoints = glGetUniformLocation(program, "uJoints");
+		this->m_uBase = glGetUniformLocation(program, "uBase");
+		this->m_uStride = glGetUniformLocation(program, "uStride");
+		this->m_uMode = glGetUniformLocation(program, "uMode");
+	}
 
-	// get uniform to control color
-	GLint uColor = glGetUniformLocation(program, "uColor");
-	GLint uMode = glGetUniformLocation(program, "uMode");
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, this->m_jointTexture);
+	glUniform1i(this->m_uJoints, 0);
+	glUniform1i(this->m_uBase, this->m_segment * SEGMENT_TEXELS);
+	glUniform1i(this->m_uStride, INSTANCE_TEXELS);
 
-	// bind buffers
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(0);
+	// ghosts are see-through
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindVertexArray(this->m_vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo_confidence);
-	glVertexAttribIPointer(1, 1, GL_INT, 0, 0);
-	glEnableVertexAttribArray(1);
+	// 1. draw every skeleton
+	glUniform1i(this->m_uMode, 0);
+	glDrawElementsInstanced(GL_LINES, BONES * 2, GL_UNSIGNED_INT, 0, this->m_instances);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->m_ebo);
+	// 2. draw every joint, colored by confidence, the failed one larger
+	glUniform1i(this->m_uMode, 1);
+	glDrawArraysInstanced(GL_POINTS, 0, JOINTS, this->m_instances);
+
+	glBindVertexArray(0);
+	glDisable(GL_BLEND);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+int MySkeleton::getGhost(int slot)
+{
+	return this->m_ghosts[slot];
+}
+
+void MySkeleton::setGhost(int slot, int pose)
+{
+	if (slot < 0 || slot >= MAX_GHOSTS || this->m_ghosts[slot] == pose)
+		return;
+	this->m_ghosts[slot] = pose;
+	this->m_ghostsChanged = true;
+}
+#endif
+
+int MySkeleton::CompareJoint(const skeleton_data& lhs, const skeleton_data& rhs)
+{
+	return this->CompareJoint(lhs, rhs, this->m_config.current());
+}
 
-	// 1. draw skeleton
-	glUniform1i(uMode, 0);
-	glUniform4f(uColor, 0.0f, 0.0f, 0.0f, 1.0f);
-	glDrawElements(GL_LINES, 62, GL_UNSIGNED_INT, 0);
+int MySkeleton::CompareJoint(const skeleton_data& lhs, const skeleton_data& rhs, const matcher_config& config)
+{
+	// joints that failed most often go first, the first failing joint ends the comparison
+	int evaluated = 0;
+	const int failed = CompareJoints<active_sensor>(lhs, rhs, this->m_compareOrder.data(), config.checkList.data(), config.jointThresh, evaluated);
 
-	// 2. draw joint confident
-	glUniform1i(uMode, 1);
-	glDrawArrays(GL_POINTS, 0, JOINTS);
+	this->m_compareJoints += evaluated;
+	++this->m_compares;
+	if (failed >= 0)
+		++this->m_compareRejects[failed];
 
-	// 3. draw which joint failed the test
-	if (this->m_failed >= 0)
+	// refresh the order now and then, forgetting slowly so it follows the user
+	if (this->m_compares % COMPARE_REORDER_INTERVAL == 0)
 	{
-		glUniform1i(uMode, 2);
-		glDrawArrays(GL_POINTS, this->m_failed, 1);
+		// insertion sort, std::stable_sort may allocate
+		for (int i = 1; i < JOINTS; ++i)
+		{
+			const int joint = this->m_compareOrder[i];
+			int k = i;
+			while (k > 0 && this->m_compareRejects[this->m_compareOrder[k - 1]] < this->m_compareRejects[joint])
+			{
+				this->m_compareOrder[k] = this->m_compareOrder[k - 1];
+				--k;
+			}
+			this->m_compareOrder[k] = joint;
+		}
+		for (int j = 0; j < JOINTS; ++j)
+			this->m_compareRejects[j] /= 2;
 	}
+	return failed;
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void MySkeleton::Process(const frame_data& frame)
+{
+	// one configuration for the whole frame, whatever the UI publishes meanwhile
+	const matcher_config& config = *this->m_config.read();
+	this->m_matchConfig = &config;
+	const MyPoseLibrary& library = *config.library;
+
+	if (config.holdTime != this->m_bodies[0].stability.getHoldTime())
+	{
+		for (body_state& body : this->m_bodies)
+			body.stability.setHoldTime(config.holdTime);
+	}
+
+	// a take stopped with nobody in view is finished all the same
+	this->m_gestures.Tick();
+
+	this->AssignBodies(frame);
+	this->m_tracked = frame.count;
+	if (frame.count == 0)
+		return;
+
+	// new templates are recorded from the first tracked body
+	this->m_gestures.Record(frame.bodies[0].skeleton);
+
+	// keys held into a library that is gone, or into RECORD mode, go up
+	const int mode = config.mode;
+	if (mode != EXECUTE || library.generation() != this->m_triggerGeneration)
+	{
+		this->ReleaseAll(frame.timestamp, frame.acquired);
+		this->m_triggerGeneration = library.generation();
+	}
+
+	// every body on its own thread, the match stage takes one as well
+	this->m_jobFrame = &frame;
+	this->m_jobTree = mode == EXECUTE && config.index->Prepare(library, this->m_indexUsage);
+	this->m_pool.Run(&MySkeleton::MatchBody, this, frame.count);
+
+	for (MyPoseLibrary::scratch& work : this->m_scratch)
+		config.index->Merge(library, work, this->m_indexUsage);
+
+	// results in body order, so keys come out the same way every run
+	if (mode == RECORD)
+	{
+		if (!this->m_hasMatch)
+		{
+			this->m_failed = -1;
+			for (int i = 0; i < frame.count; ++i)
+			{
+				body_state& body = this->m_bodies[this->m_slots[i]];
+				if (!body.held)
+					continue;
+
+				printf("Body %llu held a pose for %.0f ms over %zu frames\n", (unsigned long long)body.id, body.stability.getHeld() / 1000.0, body.stability.size());
+				body.stability.getMeanPose(this->m_matchPose);
+				this->m_matchId = body.id;
+
+				// everybody starts over once the pose is saved or cleared
+				for (body_state& other : this->m_bodies)
+					other.stability.Reset();
+				this->m_hasMatch = true;
+				break;
+			}
+		}
+		else
+		{
+			// the body that held the pose, if it is still here
+			this->m_failed = -1;
+			for (int i = 0; i < frame.count; ++i)
+			{
+				if (frame.bodies[i].id == this->m_matchId)
+					this->m_failed = MySkeleton::CompareJoint(this->m_matchPose, frame.bodies[i].skeleton, config);
+			}
+		}
+	}
+	else
+	{
+		this->m_failed = this->m_bodies[this->m_slots[0]].pose.failed;
+		for (int i = 0; i < frame.count; ++i)
+			this->Trigger(this->m_bodies[this->m_slots[i]], frame);
+	}
+
+	// gestures fire keys only while executing
+	for (int i = 0; i < frame.count; ++i)
+	{
+		const body_state& body = this->m_bodies[this->m_slots[i]];
+		if (body.gesture.gesture >= 0)
+		{
+			const int key = (*config.gestures)[body.gesture.gesture].key;
+			printf("Body %llu, gesture %d, pressing key[%d] (distance %.3f)\n", (unsigned long long)body.id, body.gesture.gesture, key, body.gesture.distance);
+			this->PushKey(key, KEY_TAP, body.id, frame.timestamp, frame.acquired);
+		}
+	}
 }
 
-int MySkeleton::CompareJoint(const skeleton_data& lhs, const skeleton_data& rhs)
+void MySkeleton::AssignBodies(const frame_data& frame)
 {
-	// skip joints below hip for now
-	for (int i = 0; i < JOINTS; ++i)
+	// people that left a while ago are forgotten
+	for (body_state& body : this->m_bodies)
 	{
-		// skip these joints for now
-		if (!this->m_checkList[i])
+		if (body.active && frame.timestamp > body.lastSeen + BODY_TIMEOUT)
 		{
-			continue;
+			this->Release(body, frame.timestamp, frame.acquired);
+			body.active = false;
 		}
-#if defined(K4A)
-		// if can not capture joint
-		if (lhs.joints[i].confidence_level < K4ABT_JOINT_CONFIDENCE_MEDIUM || 
-			rhs.joints[i].confidence_level < K4ABT_JOINT_CONFIDENCE_MEDIUM)
+	}
+
+	// known ids keep their state
+	std::array<bool, MAX_BODIES> taken;
+	taken.fill(false);
+	for (int i = 0; i < frame.count; ++i)
+	{
+		this->m_slots[i] = -1;
+		for (int b = 0; b < MAX_BODIES; ++b)
 		{
-			return i;
+			if (this->m_bodies[b].active && !taken[b] && this->m_bodies[b].id == frame.bodies[i].id)
+			{
+				this->m_slots[i] = b;
+				taken[b] = true;
+				break;
+			}
 		}
-#elif defined(K4W)
-		if (lhs.joints[i].TrackingState < TrackingState_Tracked ||
-			rhs.joints[i].TrackingState < TrackingState_Tracked)
+	}
+
+	// new ids get a free slot, or the one unseen the longest
+	for (int i = 0; i < frame.count; ++i)
+	{
+		if (this->m_slots[i] >= 0)
+			continue;
+
+		int slot = -1;
+		for (int b = 0; b < MAX_BODIES; ++b)
 		{
-			return i;
+			if (taken[b])
+				continue;
+			if (slot < 0 || !this->m_bodies[b].active ||
+				(this->m_bodies[slot].active && this->m_bodies[b].lastSeen < this->m_bodies[slot].lastSeen))
+			{
+				slot = b;
+			}
 		}
-#endif
 
-		float diff[4] = {0, 0, 0, 0};
-#if defined(K4A)
-		diff[0] = lhs.joints[i].orientation.v[0] - rhs.joints[i].orientation.v[0];
-		diff[1] = lhs.joints[i].orientation.v[1] - rhs.joints[i].orientation.v[1];
-		diff[2] = lhs.joints[i].orientation.v[2] - rhs.joints[i].orientation.v[2];
-		diff[3] = lhs.joints[i].orientation.v[3] - rhs.joints[i].orientation.v[3];
-#elif defined(K4W)
-		diff[0] = lhs.orientations[i].Orientation.w - rhs.orientations[i].Orientation.w;
-		diff[1] = lhs.orientations[i].Orientation.x - rhs.orientations[i].Orientation.x;
-		diff[2] = lhs.orientations[i].Orientation.y - rhs.orientations[i].Orientation.y;
-		diff[3] = lhs.orientations[i].Orientation.z - rhs.orientations[i].Orientation.z;
-#endif
+		body_state& body = this->m_bodies[slot];
+		this->Release(body, frame.timestamp, frame.acquired);
+		MySkeleton::ResetTrigger(body.trigger);
+		body.id = frame.bodies[i].id;
+		body.active = true;
+		body.stability.Reset();
+		body.gestures.Reset();
+		this->m_slots[i] = slot;
+		taken[slot] = true;
+	}
 
-		float mag = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2] + diff[3] * diff[3];
-		mag = std::sqrt(mag);
+	for (int i = 0; i < frame.count; ++i)
+		this->m_bodies[this->m_slots[i]].lastSeen = frame.timestamp;
+}
+
+void MySkeleton::MatchBody(void* context, int job, int worker)
+{
+	MySkeleton* self = static_cast<MySkeleton*>(context);
+	const matcher_config& config = *self->m_matchConfig;
+	const skeleton_data& skeleton = self->m_jobFrame->bodies[job].skeleton;
+	body_state& body = self->m_bodies[self->m_slots[job]];
+
+	body.held = false;
+	body.pose = { -1, -1, -1, 0.0f, 0.0f };
+	if (config.mode == RECORD)
+	{
+		// constant work per frame, the pose is the mean of the frames held
+		if (!self->m_hasMatch)
+			body.held = body.stability.Push(skeleton, self->m_jobFrame->timestamp, config.checkList, config.jointThresh);
+	}
+	else
+	{
+		// every saved pose in one pass, the closest one under the threshold wins
+		body.pose = config.index->Match(*config.library, skeleton, config.checkList, config.jointThresh, self->m_jobTree, self->m_scratch[worker]);
+
+		// the pose already entered is left by its own distance, whatever is closest now
+		if (body.trigger.pose >= 0)
+			body.trigger.distance = config.library->Distance(body.trigger.pose, skeleton, config.checkList);
+	}
+
+	body.gesture = self->m_gestures.Push(body.gestures, *config.gestures, skeleton, config.checkList, config.gestureThresh, config.mode == EXECUTE);
+}
+
+void MySkeleton::Trigger(body_state& body, const frame_data& frame)
+{
+	pose_trigger& trigger = body.trigger;
+	const uint64_t now = frame.timestamp;
+	const matcher_config& config = *this->m_matchConfig;
+	const float thresh = config.jointThresh;
+
+	// left once it is clearly gone, not as soon as it crosses the threshold
+	if (trigger.pose >= 0 && trigger.distance > trigger.bind.exit * thresh)
+		this->Release(body, frame.timestamp, frame.acquired);
 
-		if (mag > this->m_jointThresh)
+	// still in the pose, only a repeat can fire
+	if (trigger.pose >= 0)
+	{
+		if (trigger.bind.mode == BIND_REPEAT && now >= trigger.repeatAt)
 		{
-			//printf("Failed ad joint[%d] with error of: %.3f\n", i, mag);
-			return i;
+			this->PushKey(trigger.key, KEY_TAP, body.id, frame.timestamp, frame.acquired);
+
+			// a gap in the frames skips the repeats it missed instead of sending them all at once
+			const uint64_t interval = trigger.bind.repeatMs * 1000ull;
+			trigger.repeatAt = std::max(trigger.repeatAt + interval, now + interval / 2);
 		}
+		return;
+	}
+
+	// enter the closest pose if it is close enough for its binding and not cooling down
+	const int pose = body.pose.pose;
+	if (pose < 0)
+		return;
+
+	const MyPoseLibrary::binding bind = config.library->getBinding(pose);
+	if (body.pose.distance > bind.enter * thresh)
+		return;
+	for (int c = 0; c < COOLDOWNS; ++c)
+	{
+		if (trigger.coolPose[c] == pose && now < trigger.coolUntil[c])
+			return;
+	}
+
+	trigger.pose = pose;
+	trigger.key = config.library->getKey(pose);
+	trigger.bind = bind;
+	trigger.repeatAt = now + bind.repeatMs * 1000ull;
+	trigger.distance = body.pose.distance;
+
+	printf("Body %llu entered pose %d, key[%d] (margin %.3f)\n", (unsigned long long)body.id, pose, trigger.key, body.pose.margin);
+	this->PushKey(trigger.key, bind.mode == BIND_HOLD ? KEY_PRESS : KEY_TAP, body.id, frame.timestamp, frame.acquired);
+}
+
+void MySkeleton::Release(body_state& body, uint64_t timestamp, uint64_t acquired)
+{
+	pose_trigger& trigger = body.trigger;
+	if (trigger.pose < 0)
+		return;
+
+	if (trigger.bind.mode == BIND_HOLD)
+		this->PushKey(trigger.key, KEY_RELEASE, body.id, timestamp, acquired);
+
+	// the oldest cooldown makes room
+	trigger.coolPose[trigger.coolNext] = trigger.pose;
+	trigger.coolUntil[trigger.coolNext] = timestamp + trigger.bind.cooldownMs * 1000ull;
+	trigger.coolNext = (trigger.coolNext + 1) % COOLDOWNS;
+	trigger.pose = -1;
+}
+
+void MySkeleton::ReleaseAll(uint64_t timestamp, uint64_t acquired)
+{
+	for (body_state& body : this->m_bodies)
+		this->Release(body, timestamp, acquired);
+}
+
+MySkeleton::matcher_config* MySkeleton::EditConfig()
+{
+	// what the UI changed last, to be changed further and published
+	return new matcher_config(this->m_config.current());
+}
+
+void MySkeleton::ResetTrigger(pose_trigger& trigger)
+{
+	trigger.pose = -1;
+	trigger.key = 0;
+	trigger.bind = MyPoseLibrary::DefaultBinding();
+	trigger.repeatAt = 0;
+	trigger.distance = 0.0f;
+	trigger.coolPose.fill(-1);
+	trigger.coolUntil.fill(0);
+	trigger.coolNext = 0;
+}
+
+void MySkeleton::PushKey(int key, KEY_ACTION action, uint64_t id, uint64_t timestamp, uint64_t acquired)
+{
+	const key_event event = { key, action, id, timestamp, acquired, Now() };
+	this->m_network.PushEvent(id, timestamp, acquired, key, action);
+	if (action == KEY_TAP)
+	{
+		this->m_keyQueue.push(event);
+		return;
 	}
-	return -1;
-}
\ No newline at end of file
+
+	// a lost release would leave the key down, a lost press would be followed by a stray release:
+	// they take the cells taps leave free, and sleep until the dispatch stage makes room when those are gone
+	key_event* slot;
+	while (!(slot = this->m_keyQueue.waitAcquire(ACQUIRE_TIMEOUT)))
+		;
+	*slot = event;
+	this->m_keyQueue.commit();
+}
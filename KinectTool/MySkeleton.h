@@ -1,31 +1,39 @@
 #pragma once
+#if !defined(KT_HEADLESS)
 // glfw
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-
-#define K4W
-// kinect for azure
-#if defined(K4A)
-#include <k4a/k4a.h>
-#include <k4abt.h>
-#define JOINTS (int)K4ABT_JOINT_COUNT
-typedef k4abt_skeleton_t skeleton_data;
-
-// kinect for windows
-#elif defined(K4W)
-#include <Kinect.h>
-#define JOINTS (int)JointType_Count
-typedef struct {
-	Joint joints[JOINTS];
-	JointOrientation orientations[JOINTS];
-} skeleton_data;
+#else
+// no window, frames only go through the matcher
+typedef struct GLFWwindow GLFWwindow;
 #endif
 
+// kinect
+#include "MySkeletonData.h"
+
 // std
 #include <thread>
 #include <vector>
 #include <array>
-#include <queue>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// my classes
+#include "MyTripleBuffer.h"
+#include "MySnapshot.h"
+#include "MyStabilityDetector.h"
+#include "MyGestureMatcher.h"
+#include "MyPoseLibrary.h"
+#include "MyPoseIndex.h"
+#include "MyRecorder.h"
+#include "MySharedRing.h"
+#include "MyNetPublisher.h"
+#include "MySkeletonSource.h"
+#include "MyKeySink.h"
+#include "MyWorkerPool.h"
+#include "MyStageQueue.h"
+#include "MyLatencyHistogram.h"
 
 typedef enum {
 	RECORD,
@@ -33,43 +41,190 @@ typedef enum {
 	MODE_COUNT
 }GUI_MODE;
 
+typedef enum {
+	LATENCY_QUEUE,		// acquired -> match stage picks the frame up
+	LATENCY_MATCH,		// match stage, picked up -> published
+	LATENCY_FRAME,		// acquired -> published
+	LATENCY_DISPATCH,	// queued by the match stage -> key sent
+	LATENCY_KEY,		// acquired -> key sent
+	LATENCY_COUNT
+}LATENCY_STAGE;
+
 class MySkeleton {
 public:		// data structures
+	static const int COMPARE_REORDER_INTERVAL = 64;
+	static const uint64_t BODY_TIMEOUT = 1000000;	// microseconds a body may vanish before its state is dropped
+	static const uint32_t ACQUIRE_TIMEOUT = 100;	// milliseconds a stage waits for its input at most
+	static const int IDLE_FRAMES = 30;				// frames without a body before the source is told to idle
+	static const size_t FRAME_QUEUE = 4;			// frames between the acquire and match stages
+	static const size_t KEY_QUEUE = 64;				// key presses between the match and dispatch stages
+	static const size_t KEY_RESERVE = 2 * MAX_BODIES;	// of those, left to presses and releases: one pair per body
+	static const int COOLDOWNS = 4;					// poses a body remembers leaving, for their cooldown
+	static const int MAX_GHOSTS = 4;				// library poses drawn over the bodies
+	static const int RING_SEGMENTS = 3;				// uploads the GL thread writes before orphaning the joint buffer
+
 	struct data {
 		skeleton_data skeleton;		// joint oreantion
 		int key;					// bind to which key
 	};
 
+	// a key press on its way to the dispatch stage
+	struct key_event {
+		int key;
+		KEY_ACTION action;
+		uint64_t id;				// body that triggered it
+		uint64_t timestamp;			// sensor time of the frame
+		uint64_t acquired;			// steady clock nanoseconds the frame was acquired
+		uint64_t queued;			// steady clock nanoseconds the match stage queued it
+	};
+
+	// the pose a body is in and what its key does, keys fire on entering and leaving rather than every frame
+	struct pose_trigger {
+		int pose;								// pose entered, -1 if none
+		int key;
+		MyPoseLibrary::binding bind;			// copied on entering, edits apply the next time
+		uint64_t repeatAt;						// sensor time of the next BIND_REPEAT press
+		float distance;							// to the entered pose this frame, from MatchBody
+		std::array<int, COOLDOWNS> coolPose;	// poses left lately
+		std::array<uint64_t, COOLDOWNS> coolUntil;	// sensor time each can be entered again
+		int coolNext;
+	};
+
+	// everything the match stage matches against, published by the UI as a whole and never changed after.
+	// Configurations share the library and the gestures until one changes them, a pose or gesture saved copies them.
+	// The index belongs to the library and the checked joints, it is built by whoever publishes a change to either
+	struct matcher_config {
+		std::shared_ptr<const MyPoseLibrary> library;
+		std::shared_ptr<const MyPoseIndex> index;
+		std::shared_ptr<const MyGestureMatcher::gesture_set> gestures;
+		std::array<bool, JOINTS> checkList;
+		float jointThresh;
+		float gestureThresh;
+		float holdTime;							// milliseconds
+		int mode;								// GUI_MODE
+	};
+
+	// everything remembered about one person, kept by tracking id across frames
+	struct body_state {
+		uint64_t id;
+		bool active;
+		uint64_t lastSeen;						// sensor timestamp
+		MyStabilityDetector stability;
+		MyGestureMatcher::stream gestures;
+		pose_trigger trigger;
+
+		// results of the current frame, written by the worker that took the body
+		bool held;
+		MyPoseLibrary::match pose;
+		MyGestureMatcher::match gesture;
+	};
+
 private:	// variables
 
 	// main brain
 	GLFWwindow* m_window;
+
+	// pipeline: acquire (m_thread) -> match (m_matchThread) -> dispatch (m_dispatchThread),
+	// each stage drains its queue after the one before it stopped
 	std::thread* m_thread;
+	std::thread* m_matchThread;
+	std::thread* m_dispatchThread;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_matching;
+	MyStageQueue<frame_data, FRAME_QUEUE> m_frameQueue;
+	MyStageQueue<key_event, KEY_QUEUE> m_keyQueue;
+	frame_data m_acquired;				// acquire stage only
 
-	// camera
-#if defined(K4A)
-	k4a_device_t m_device;
-	k4abt_tracker_t m_tracker;
-#elif defined(K4W)
-	IKinectSensor* m_sensor;
-	IBodyFrameReader* m_reader;
-#endif
+	// camera or recording
+	MySkeletonSource* m_source;
+	bool m_ownSource;
+
+	// where the dispatch stage sends keys, nullptr if none could be opened
+	MyKeySink* m_sink;
+	bool m_ownSink;
+	std::atomic<uint64_t> m_keysSent;
+	std::atomic<uint64_t> m_keysFailed;
+	std::atomic<size_t> m_keyDepth;		// most keys waiting at once
+	int m_emptyFrames;					// frames in a row without a body
 
-	// poses data
-	std::queue<skeleton_data> m_skeletonLog;
-	skeleton_data* m_currentSkeleton;
-	skeleton_data* m_matchPose;
-	std::vector<data> m_savedPose;
-	std::array<bool, JOINTS> m_checkList;
+	// poses data, all fixed size so the capture loop never allocates
+	MyTripleBuffer<frame_data> m_frames;		// match stage -> GL thread
+	uint64_t m_frameSeq;
+	skeleton_data m_matchPose;
+	uint64_t m_matchId;					// body that held the pose, compared against it until saved or cleared
+	std::atomic<bool> m_hasMatch;
 	int m_failed;
-	float m_jointThresh;
 
-	int m_mode;
+	// library and settings, replaced by the UI thread, read once per frame by the match stage without a lock
+	MySnapshot<matcher_config> m_config;
+	const matcher_config* m_matchConfig;	// what the match stage and its workers use this frame
+	MyPoseIndex::usage m_indexUsage;	// how the index did lately, match stage only
+	uint64_t m_triggerGeneration;		// library the triggers point into, match stage only
 
-	// GL
-	GLuint m_vbo;
+	// CompareJoint visits the joints that fail most often first
+	std::array<int, JOINTS> m_compareOrder;
+	std::array<uint32_t, JOINTS> m_compareRejects;
+	std::atomic<uint64_t> m_compareJoints;		// joints evaluated, all comparisons
+	std::atomic<uint64_t> m_compares;
+
+	// motion gestures, recorded from the first body, matched for every body against config.gestures
+	MyGestureMatcher m_gestures;
+
+	// per body state by tracking id, m_slots[i] is the state of frame body i
+	std::array<body_state, MAX_BODIES> m_bodies;
+	std::array<int, MAX_BODIES> m_slots;
+	std::atomic<int> m_tracked;
+
+	// bodies of a frame are matched in parallel, one scratch per thread of the pool
+	MyWorkerPool m_pool;
+	std::vector<MyPoseLibrary::scratch> m_scratch;
+	const frame_data* m_jobFrame;
+	bool m_jobTree;
+
+	// session recording
+	MyRecorder m_recorder;
+
+	// frames for other processes on this machine
+	MySharedRing m_shared;
+
+	// frames and key events for other machines
+	MyNetPublisher m_network;
+
+	// heap allocations made by the capture loop after warm-up, should stay 0
+	std::atomic<uint64_t> m_captureAllocs;
+
+	// latency of every frame and key press through the pipeline
+	std::array<MyLatencyHistogram, LATENCY_COUNT> m_latency;
+
+	// throughput, time spent on a frame from the match stage picking it up to publishing it
+	std::atomic<uint64_t> m_processed;
+	std::atomic<uint64_t> m_processTime;		// nanoseconds, all frames
+	std::atomic<uint64_t> m_processMax;			// nanoseconds, slowest frame
+
+#if !defined(KT_HEADLESS)
+	// GL, every body and ghost is an instance of the same bones and joints,
+	// read from a ring of joint segments through m_jointTexture
+	GLuint m_vao;
 	GLuint m_ebo;
-	GLuint m_vbo_confidence;
+	GLuint m_jointBuffer;
+	GLuint m_jointTexture;
+	int m_segment;						// segment of the last upload
+	int m_instances;					// bodies and ghosts in it
+	uint64_t m_drawnSeq;				// frame it was made from
+	uint64_t m_drawnGeneration;			// library the ghosts came from
+
+	// uniform locations, looked up once per program
+	GLuint m_program;
+	GLint m_uJoints;
+	GLint m_uBase;
+	GLint m_uStride;
+	GLint m_uMode;
+
+	// library poses drawn over the first body, -1 if none, GL thread only
+	std::array<int, MAX_GHOSTS> m_ghosts;
+	bool m_ghostsChanged;
+	std::array<float, JOINTS> m_boneLength;		// meters, last seen on the first body
+#endif
 
 public:		// functions
 
@@ -78,31 +233,94 @@ public:		// functions
 	~MySkeleton();
 
 	// operations
-	void Init(GLFWwindow* window);
+	// reads the sensor unless another source is given, sends keys to the OS unless another sink is given,
+	// the caller keeps ownership of both
+	void Init(GLFWwindow* window, MySkeletonSource* source = nullptr, MyKeySink* sink = nullptr);
 	void Start();
-	void Update();
+	void Update();			// the acquire stage
 	void Stop();
 
 	// get data
+	bool isRunning();
 	size_t getSavedAmount();
-	std::array<bool, JOINTS>& getCheckList();
+	size_t getGestureAmount();
+	const std::array<bool, JOINTS>& getCheckList();
 	bool hasMatch();
+	float getHoldTime();
+	uint64_t getCaptureAllocations();
+	uint64_t getProcessedFrames();
+	double getAverageProcessTime();		// microseconds
+	double getMaxProcessTime();			// microseconds
+	double getCompareJoints();			// joints evaluated per CompareJoint
+	double getLibraryJoints();			// joints evaluated per pose block and Match
+	int getEnabledJoints();
+	MyRecorder& getRecorder();
+	MySharedRing& getShared();
+	MyNetPublisher& getNetwork();
+	MyGestureMatcher& getGestures();
+	int getTrackedBodies();
+	int getWorkers();
+	uint64_t getDroppedFrames();		// frames the match stage never saw
+	size_t getQueuedFrames();
+	int getDropPolicy();
+	const char* getKeySink();			// nullptr when keys go nowhere
+	uint64_t getSentKeys();
+	uint64_t getFailedKeys();			// the sink refused them
+	uint64_t getDroppedKeys();			// the dispatch stage fell KEY_QUEUE keys behind
+	size_t getQueuedKeys();
+	size_t getMaxQueuedKeys();
+	const MyLatencyHistogram& getLatency(int stage);
+	static const char* getLatencyName(int stage);
 
 	// set data
+	// each publishes a new configuration, nothing happens if the value did not change
+	void setCheckList(const std::array<bool, JOINTS>& checkList);
 	void setThresh(const float& thresh);
+	void setHoldTime(float ms);
+	void setGestureThresh(float thresh);
 	void setMode(int mode);
+	void setDropPolicy(int policy);
+
+	// latency histograms, Export writes them all as text
+	void ResetLatency();
+	bool ExportLatency(const char* path);
 
 	// operations for poses
 	void Clear();
 	void ClearAll();
-	void Save(int key);
+	void Save(int key, const MyPoseLibrary::binding& bind = MyPoseLibrary::DefaultBinding());
 	void Import(const char* path);
 	bool Export(const char* path);
 
+	// operations for gestures, the take is started from getGestures() and stopped here, where it can not get stuck
+	void StopGesture();
+	void SaveGesture(int key);
+	void ClearGestures();
+
+#if !defined(KT_HEADLESS)
 	// render functions
+	// Load2Shader uploads only when a new frame or a ghost change arrived
 	void Load2Shader();
 	void Render(const GLuint& program);
+	int getGhost(int slot);
+	void setGhost(int slot, int pose);
+#endif
 
 	// tools
+	// with the current joint mask and threshold
 	int CompareJoint(const skeleton_data& lhs, const skeleton_data& rhs);
+
+private:	// functions
+	void MatchStage();
+	int CompareJoint(const skeleton_data& lhs, const skeleton_data& rhs, const matcher_config& config);
+	matcher_config* EditConfig();
+	void DispatchStage();
+	void Process(const frame_data& frame);
+	void AssignBodies(const frame_data& frame);
+	static void MatchBody(void* context, int job, int worker);
+	void Trigger(body_state& body, const frame_data& frame);
+	void Release(body_state& body, uint64_t timestamp, uint64_t acquired);
+	void ReleaseAll(uint64_t timestamp, uint64_t acquired);
+	static void ResetTrigger(pose_trigger& trigger);
+	void PushKey(int key, KEY_ACTION action, uint64_t id, uint64_t timestamp, uint64_t acquired);
 };
\ No newline at end of file
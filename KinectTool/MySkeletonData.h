@@ -0,0 +1,98 @@
+#pragma once
+// std
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// pick a sensor with K4A, K4W or KSIM (sensor data types without the sdk, for replays), K4W by default
+#if !defined(K4A) && !defined(K4W) && !defined(KSIM)
+#define K4W
+#endif
+
+// my classes
+#include "MySensorTraits.h"
+
+// the sensor frames, saved files and the GUI are made for, everything below goes through its traits
+#if defined(K4A)
+typedef k4a_sensor active_sensor;
+#else
+typedef k4w_sensor active_sensor;
+#endif
+typedef sensor_traits<active_sensor> active_traits;
+typedef active_traits::skeleton skeleton_data;
+constexpr int JOINTS = active_traits::JOINTS;
+constexpr int SENSOR_TYPE = active_traits::ID;
+
+// both sensors report at most six people
+#define MAX_BODIES 6
+
+typedef struct {
+	uint64_t id;				// tracking id from the sensor
+	skeleton_data skeleton;
+} body_data;
+
+// everything one sensor frame produced
+typedef struct {
+	body_data bodies[MAX_BODIES];
+	int count;					// tracked bodies, bodies[0] is the one drawn and recorded from
+	int failed;					// joint that failed the last comparison, -1 if none
+	uint64_t timestamp;			// sensor timestamp in microseconds
+	uint64_t seq;				// frame sequence number, increases by one per sensor frame
+	uint64_t acquired;			// steady clock nanoseconds when the capture loop got the frame
+} frame_data;
+
+// steady clock nanoseconds, the clock acquired and every stage after it are stamped with
+inline uint64_t Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// copies a frame between queues and rings, only the tracked bodies are worth copying
+inline void CopyFrame(frame_data& to, const frame_data& from)
+{
+	to.count = from.count;
+	to.failed = from.failed;
+	to.timestamp = from.timestamp;
+	to.seq = from.seq;
+	to.acquired = from.acquired;
+	std::memcpy(to.bodies, from.bodies, from.count * sizeof(body_data));
+}
+
+// read a joint without caring which sensor produced the skeleton
+
+// true if the sensor is confident about the joint
+inline bool IsJointTracked(const skeleton_data& skeleton, int joint)
+{
+	return active_traits::Tracked(skeleton, joint);
+}
+
+// orientation quaternion in w, x, y, z order
+inline void GetJointOrientation(const skeleton_data& skeleton, int joint, float q[4])
+{
+	active_traits::Orientation(skeleton, joint, q);
+}
+
+// position in meters
+inline void GetJointPosition(const skeleton_data& skeleton, int joint, float p[3])
+{
+	active_traits::Position(skeleton, joint, p);
+}
+
+// write a joint, for generated skeletons
+
+inline void SetJointTracked(skeleton_data& skeleton, int joint, bool tracked)
+{
+	active_traits::SetTracked(skeleton, joint, tracked);
+}
+
+// orientation quaternion in w, x, y, z order
+inline void SetJointOrientation(skeleton_data& skeleton, int joint, const float q[4])
+{
+	active_traits::SetOrientation(skeleton, joint, q);
+}
+
+// position in meters
+inline void SetJointPosition(skeleton_data& skeleton, int joint, const float p[3])
+{
+	active_traits::SetPosition(skeleton, joint, p);
+}
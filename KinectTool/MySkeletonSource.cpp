@@ -0,0 +1,29 @@
+#include "MySkeletonSource.h"
+
+MySkeletonSource::MySkeletonSource()
+{
+	this->m_woken = false;
+}
+
+void MySkeletonSource::Wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->m_waitMutex);
+		this->m_woken = true;
+	}
+	this->m_waitCondition.notify_all();
+}
+
+bool MySkeletonSource::WaitUntil(std::chrono::steady_clock::time_point due, uint32_t timeout)
+{
+	const std::chrono::steady_clock::time_point limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	const bool early = limit < due;
+
+	std::unique_lock<std::mutex> lock(this->m_waitMutex);
+	this->m_waitCondition.wait_until(lock, early ? limit : due, [this]() { return this->m_woken; });
+
+	// a wake up is used by the wait it ended
+	const bool woken = this->m_woken;
+	this->m_woken = false;
+	return !woken && !early;
+}
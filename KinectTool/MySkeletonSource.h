@@ -0,0 +1,53 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+typedef enum {
+	SOURCE_FRAME,		// frame filled in
+	SOURCE_NONE,		// nothing new before the timeout or Wake(), ask again
+	SOURCE_END,			// no more frames will come
+	SOURCE_ERROR		// the source broke, stop capturing
+}SOURCE_RESULT;
+
+// Where MySkeleton gets its frames from: the sensor, or a recorded session.
+// Open() and Close() are called once each, Acquire() is called in a loop on the capture thread and blocks
+// until a frame arrives, so the loop costs nothing between frames. Wake() lets another thread cut a wait short.
+class MySkeletonSource {
+private:	// variables
+	std::mutex m_waitMutex;
+	std::condition_variable m_waitCondition;
+	bool m_woken;
+
+public:		// functions
+
+	// constructer
+	MySkeletonSource();
+	virtual ~MySkeletonSource() {}
+
+	// operations
+	virtual bool Open() = 0;
+	virtual void Close() = 0;
+
+	// wait up to timeout ms for the next frame and fill bodies, count and timestamp,
+	// failed and seq are left to the caller
+	virtual SOURCE_RESULT Acquire(frame_data& frame, uint32_t timeout) = 0;
+
+	// any thread, a blocked Acquire() returns SOURCE_NONE early
+	virtual void Wake();
+
+	// nobody tracked for a while, a live source may hand out fewer frames until someone shows up
+	virtual void setIdle(bool /*idle*/) {}
+
+	// true when frames don't come on a clock (a fast replay), the capture loop then waits for room instead of dropping
+	virtual bool canWait() const { return false; }
+
+protected:	// functions
+	// sleep until due, the timeout or Wake(), returns true only if due was reached
+	bool WaitUntil(std::chrono::steady_clock::time_point due, uint32_t timeout);
+};
@@ -0,0 +1,102 @@
+#pragma once
+// std
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Read-copy-update cell for data one thread changes now and then and one reader thread uses every frame.
+// The writer never changes a published value: it builds a new one and publish() swaps the pointer, the old
+// value is retired. The reader calls read() at a point where it holds nothing from an earlier read(), which
+// also tells the writer every value retired before that point is out of use, so reclaim() deletes it.
+// While the reader is offline() nothing is in use. Reading is two atomic loads and a store, no lock and no
+// allocation, so the reader never waits for the writer and always sees one whole value.
+//
+// Only the writer thread may call current(), publish() and reclaim(), only the reader read(), quiescent()
+// and offline(). Anything the reader shares with threads of its own must be done before its next read().
+template <typename T>
+class MySnapshot {
+public:		// data structures
+	static const uint64_t OFFLINE = UINT64_MAX;
+
+private:	// data structures
+	struct retired {
+		T* value;
+		uint64_t epoch;			// in use until the reader saw this epoch
+	};
+
+private:	// variables
+	alignas(64) std::atomic<T*> m_current;
+	alignas(64) std::atomic<uint64_t> m_epoch;		// values published so far
+	alignas(64) std::atomic<uint64_t> m_seen;		// epoch of the reader's last read(), OFFLINE if it reads nothing
+	std::vector<retired> m_retired;					// writer only
+
+public:		// functions
+
+	// constructer
+	explicit MySnapshot(T* initial) : m_current(initial), m_epoch(0), m_seen(OFFLINE) {}
+	MySnapshot(const MySnapshot&) = delete;
+	MySnapshot& operator=(const MySnapshot&) = delete;
+
+	// only while the reader is offline
+	~MySnapshot()
+	{
+		for (const retired& r : this->m_retired)
+			delete r.value;
+		delete this->m_current.load(std::memory_order_relaxed);
+	}
+
+	// reader side: the value to use until the next read()
+	const T* read()
+	{
+		this->quiescent();
+		return this->m_current.load(std::memory_order_acquire);
+	}
+
+	// nothing read earlier is in use anymore, for a reader waiting for work
+	void quiescent()
+	{
+		this->m_seen.store(this->m_epoch.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+	// the reader stops, read() again before using anything
+	void offline()
+	{
+		this->m_seen.store(OFFLINE, std::memory_order_release);
+	}
+
+	// writer side: the value the reader gets from its next read()
+	const T& current() const
+	{
+		return *this->m_current.load(std::memory_order_relaxed);
+	}
+
+	// takes ownership of next, the old value is deleted once the reader is done with it
+	void publish(T* next)
+	{
+		T* old = this->m_current.exchange(next, std::memory_order_acq_rel);
+		const uint64_t epoch = this->m_epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+		this->m_retired.push_back({ old, epoch });
+		this->reclaim();
+	}
+
+	// deletes what the reader is done with, returns how many values still wait
+	size_t reclaim()
+	{
+		const uint64_t seen = this->m_seen.load(std::memory_order_acquire);
+		size_t kept = 0;
+		for (const retired& r : this->m_retired)
+		{
+			if (r.epoch <= seen)
+				delete r.value;
+			else
+				this->m_retired[kept++] = r;
+		}
+		this->m_retired.resize(kept);
+		return kept;
+	}
+
+	size_t getRetired() const
+	{
+		return this->m_retired.size();
+	}
+};
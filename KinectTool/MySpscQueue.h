@@ -0,0 +1,82 @@
+#pragma once
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free single-producer / single-consumer queue.
+// Elements are filled and read in place: the producer asks for a free slot with acquire() and hands it over with commit(),
+// the consumer looks at the oldest slot with peek() and frees it with release(), so large values are never copied twice.
+// N must be a power of two.
+template <typename T, size_t N>
+class MySpscQueue {
+private:	// variables
+	static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+	std::array<T, N> m_slots;
+	alignas(64) std::atomic<size_t> m_head;		// next slot to read, written by the consumer
+	alignas(64) std::atomic<size_t> m_tail;		// next slot to write, written by the producer
+
+public:		// functions
+
+	// constructer
+	MySpscQueue() : m_head(0), m_tail(0) {}
+	MySpscQueue(const MySpscQueue&) = delete;
+	MySpscQueue& operator=(const MySpscQueue&) = delete;
+
+	// producer side, acquire() returns nullptr when the queue is full
+	T* acquire()
+	{
+		const size_t tail = this->m_tail.load(std::memory_order_relaxed);
+		if (tail - this->m_head.load(std::memory_order_acquire) == N)
+			return nullptr;
+		return &this->m_slots[tail & (N - 1)];
+	}
+
+	void commit()
+	{
+		this->m_tail.store(this->m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool push(const T& value)
+	{
+		T* slot = this->acquire();
+		if (!slot)
+			return false;
+		*slot = value;
+		this->commit();
+		return true;
+	}
+
+	// consumer side, peek() returns nullptr when the queue is empty
+	T* peek()
+	{
+		const size_t head = this->m_head.load(std::memory_order_relaxed);
+		if (head == this->m_tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &this->m_slots[head & (N - 1)];
+	}
+
+	void release()
+	{
+		this->m_head.store(this->m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool pop(T& value)
+	{
+		T* slot = this->peek();
+		if (!slot)
+			return false;
+		value = *slot;
+		this->release();
+		return true;
+	}
+
+	// approximate when called from a third thread
+	size_t size() const
+	{
+		return this->m_tail.load(std::memory_order_acquire) - this->m_head.load(std::memory_order_acquire);
+	}
+
+	static constexpr size_t capacity() { return N; }
+};
@@ -0,0 +1,180 @@
+#include "MyStabilityDetector.h"
+
+#include <cmath>
+
+MyStabilityDetector::MyStabilityDetector()
+{
+	this->m_holdTime = 1000000;
+	this->Reset();
+}
+
+bool MyStabilityDetector::Push(const skeleton_data& skeleton, uint64_t timestamp, const std::array<bool, JOINTS>& mask, float thresh)
+{
+	// a checked joint we can not see, or time went backwards: nothing to hold
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		if (mask[j] && !IsJointTracked(skeleton, j))
+		{
+			this->Reset();
+			return false;
+		}
+	}
+	if (!this->m_window.empty() && timestamp < this->m_window.back().timestamp)
+		this->Reset();
+
+	// too far from the window mean, start over from this frame
+	const size_t count = this->m_window.size();
+	if (count > 0)
+	{
+		const double inverse = 1.0 / count;
+		for (int j = 0; j < JOINTS; ++j)
+		{
+			if (!mask[j])
+				continue;
+
+			float q[4];
+			GetJointOrientation(skeleton, j, q);
+			const float* r = &this->m_reference[j * 4];
+			const float sign = (q[0] * r[0] + q[1] * r[1] + q[2] * r[2] + q[3] * r[3]) < 0.0f ? -1.0f : 1.0f;
+
+			double distance = 0.0;
+			for (int c = 0; c < 4; ++c)
+			{
+				const double d = sign * q[c] - this->m_sum[j * 4 + c] * inverse;
+				distance += d * d;
+			}
+			if (distance > (double)thresh * thresh)
+			{
+				this->Reset();
+				break;
+			}
+		}
+	}
+
+	if (this->m_window.empty())
+		this->m_since = timestamp;
+
+	// the window only needs to cover the hold time, and never more than it can store
+	while (this->m_window.size() > 1 && timestamp - this->m_window[1].timestamp >= this->m_holdTime)
+		this->PopSample();
+	if (this->m_window.full())
+		this->PopSample();
+	this->PushSample(skeleton, timestamp);
+
+	if (timestamp - this->m_since < this->m_holdTime)
+		return false;
+
+	// held long enough, but only stable if no checked joint wobbles too much around the mean
+	const double inverse = 1.0 / this->m_window.size();
+	const double spread = (double)thresh * SPREAD_RATIO;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		if (!mask[j])
+			continue;
+
+		double mean = 0.0;
+		for (int c = 0; c < 4; ++c)
+		{
+			const double m = this->m_sum[j * 4 + c] * inverse;
+			mean += m * m;
+		}
+		const double variance = this->m_sumSquares[j] * inverse - mean;
+		if (variance > spread * spread)
+			return false;
+	}
+	return true;
+}
+
+void MyStabilityDetector::Reset()
+{
+	this->m_window.clear();
+	this->m_sum.fill(0.0);
+	this->m_sumSquares.fill(0.0);
+	this->m_since = 0;
+}
+
+void MyStabilityDetector::setHoldTime(float ms)
+{
+	this->m_holdTime = (uint64_t)(ms * 1000.0f);
+}
+
+float MyStabilityDetector::getHoldTime() const
+{
+	return this->m_holdTime / 1000.0f;
+}
+
+uint64_t MyStabilityDetector::getHeld() const
+{
+	if (this->m_window.empty())
+		return 0;
+	return this->m_window.back().timestamp - this->m_since;
+}
+
+size_t MyStabilityDetector::size() const
+{
+	return this->m_window.size();
+}
+
+void MyStabilityDetector::getMeanPose(skeleton_data& pose) const
+{
+	pose = this->m_latest;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		float q[4];
+		double length = 0.0;
+		for (int c = 0; c < 4; ++c)
+			length += this->m_sum[j * 4 + c] * this->m_sum[j * 4 + c];
+		if (length <= 0.0)
+			continue;
+
+		length = 1.0 / std::sqrt(length);
+		for (int c = 0; c < 4; ++c)
+			q[c] = (float)(this->m_sum[j * 4 + c] * length);
+		SetJointOrientation(pose, j, q);
+	}
+}
+
+void MyStabilityDetector::PushSample(const skeleton_data& skeleton, uint64_t timestamp)
+{
+	// the ring has room, the caller made sure of it
+	this->m_window.push(sample());
+	sample& s = this->m_window.back();
+	s.timestamp = timestamp;
+
+	const bool first = this->m_window.size() == 1;
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		float* q = s.q[j];
+		GetJointOrientation(skeleton, j, q);
+
+		float* r = &this->m_reference[j * 4];
+		if (first)
+		{
+			r[0] = q[0]; r[1] = q[1]; r[2] = q[2]; r[3] = q[3];
+		}
+		else if (q[0] * r[0] + q[1] * r[1] + q[2] * r[2] + q[3] * r[3] < 0.0f)
+		{
+			// q and -q are the same rotation, keep them on one side so they average
+			q[0] = -q[0]; q[1] = -q[1]; q[2] = -q[2]; q[3] = -q[3];
+		}
+
+		for (int c = 0; c < 4; ++c)
+			this->m_sum[j * 4 + c] += q[c];
+		this->m_sumSquares[j] += (double)q[0] * q[0] + (double)q[1] * q[1] + (double)q[2] * q[2] + (double)q[3] * q[3];
+	}
+
+	this->m_latest = skeleton;
+}
+
+void MyStabilityDetector::PopSample()
+{
+	const sample& s = this->m_window.front();
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		const float* q = s.q[j];
+		for (int c = 0; c < 4; ++c)
+			this->m_sum[j * 4 + c] -= q[c];
+		this->m_sumSquares[j] -= (double)q[0] * q[0] + (double)q[1] * q[1] + (double)q[2] * q[2] + (double)q[3] * q[3];
+	}
+	this->m_window.pop();
+}
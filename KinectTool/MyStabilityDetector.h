@@ -0,0 +1,61 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MyRingBuffer.h"
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Decides when the user has held still long enough to record a pose.
+// The last frames sit in a fixed ring with running per-joint sums of the quaternions and of their squares,
+// so every frame costs the same no matter how long the user holds: add the new frame, drop what left the window,
+// check each joint against the window mean and its spread. A frame too far from the mean, or missing a checked
+// joint, starts the hold over. Time comes from the sensor timestamps, so dropped frames do not shorten the hold.
+class MyStabilityDetector {
+public:		// data structures
+	static const size_t WINDOW = 256;			// frames kept for the mean, ~2 s at 120 Hz
+	static constexpr float SPREAD_RATIO = 0.5f;	// joint standard deviation allowed, relative to the threshold
+
+private:	// data structures
+	struct sample {
+		float q[JOINTS][4];			// w, x, y, z, sign aligned with m_reference
+		uint64_t timestamp;
+	};
+
+private:	// variables
+	MyRingBuffer<sample, WINDOW> m_window;
+	std::array<double, JOINTS * 4> m_sum;		// sum of the window quaternions
+	std::array<double, JOINTS> m_sumSquares;	// sum of their squared lengths
+	std::array<float, JOINTS * 4> m_reference;	// first frame of the hold, picks q or -q
+	skeleton_data m_latest;
+	uint64_t m_since;				// timestamp the hold started
+	uint64_t m_holdTime;				// microseconds, set by the match stage from its configuration
+
+public:		// functions
+
+	// constructer
+	MyStabilityDetector();
+
+	// operations, Push returns true once the pose has been held for the hold time
+	bool Push(const skeleton_data& skeleton, uint64_t timestamp, const std::array<bool, JOINTS>& mask, float thresh);
+	void Reset();
+
+	// set data
+	void setHoldTime(float ms);
+
+	// get data
+	float getHoldTime() const;
+	uint64_t getHeld() const;		// microseconds held so far
+	size_t size() const;
+
+	// the newest frame with every orientation replaced by the window mean
+	void getMeanPose(skeleton_data& pose) const;
+
+private:	// functions
+	void PushSample(const skeleton_data& skeleton, uint64_t timestamp);
+	void PopSample();
+};
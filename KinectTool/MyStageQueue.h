@@ -0,0 +1,263 @@
+#pragma once
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+typedef enum {
+	DROP_NEWEST,		// a full queue refuses the new element
+	DROP_OLDEST			// a full queue discards its oldest unread element to make room
+}DROP_POLICY;
+
+// Bounded lock-free queue between two pipeline stages, one producer and one consumer.
+// Every cell carries a sequence number saying whose turn it is, so the producer can take the oldest element
+// away from the consumer with a single compare-and-swap when the queue is full and the policy is DROP_OLDEST.
+// An element the consumer is already reading is never dropped, the new one is refused instead.
+// With DROP_NEWEST a few cells can be reserved for elements that must not be dropped, those wait for room instead.
+// Either side can sleep until the other one moves, the other one only touches the mutex when it is asleep.
+// N must be a power of two.
+template <typename T, size_t N>
+class MyStageQueue {
+private:	// data structures
+	static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+	struct alignas(64) cell {
+		std::atomic<size_t> seq;		// == position: free to write, == position + 1: ready to read
+		T value;
+	};
+
+private:	// variables
+	std::array<cell, N> m_cells;
+	alignas(64) std::atomic<size_t> m_tail;		// next position to write, written by the producer only
+	alignas(64) std::atomic<size_t> m_head;		// next position to read, moved by the consumer or a drop
+	size_t m_reading;							// position the consumer holds, consumer only
+
+	std::atomic<int> m_policy;
+	std::atomic<size_t> m_reserve;				// cells acquire() leaves to tryAcquire() and waitAcquire()
+	std::atomic<uint64_t> m_pushed;
+	std::atomic<uint64_t> m_dropped;
+
+	// sleeping consumer
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::atomic<bool> m_sleeping;
+	bool m_woken;
+
+	// producer waiting for room
+	std::condition_variable m_room;
+	std::atomic<bool> m_blocked;
+
+public:		// functions
+
+	// constructer
+	MyStageQueue(DROP_POLICY policy = DROP_OLDEST) : m_tail(0), m_head(0), m_reading(0), m_policy(policy),
+		m_reserve(0), m_pushed(0), m_dropped(0), m_sleeping(false), m_woken(false), m_blocked(false)
+	{
+		for (size_t i = 0; i < N; ++i)
+			this->m_cells[i].seq.store(i, std::memory_order_relaxed);
+	}
+	MyStageQueue(const MyStageQueue&) = delete;
+	MyStageQueue& operator=(const MyStageQueue&) = delete;
+
+	// producer side, fill acquire() then commit() it, acquire() returns nullptr when the element has to be dropped
+	T* acquire()
+	{
+		// only the reserved cells left, the size is never too small on the producer side
+		const size_t reserve = this->m_reserve.load(std::memory_order_relaxed);
+		if (reserve > 0 && this->m_policy.load(std::memory_order_relaxed) == DROP_NEWEST && this->size() + reserve >= N)
+		{
+			++this->m_dropped;
+			return nullptr;
+		}
+
+		T* slot = this->tryAcquire();
+		if (slot)
+			return slot;
+
+		const size_t tail = this->m_tail.load(std::memory_order_relaxed);
+		cell& c = this->m_cells[tail & (N - 1)];
+
+		// full, the cell still holds the element N positions back: take it unless the consumer got to it first
+		size_t oldest = tail - N;
+		if (this->m_policy.load(std::memory_order_relaxed) == DROP_OLDEST &&
+			this->m_head.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel))
+		{
+			++this->m_dropped;
+			return &c.value;
+		}
+
+		++this->m_dropped;
+		return nullptr;
+	}
+
+	// same without dropping anything, nullptr while the queue is full
+	T* tryAcquire()
+	{
+		const size_t tail = this->m_tail.load(std::memory_order_relaxed);
+		cell& c = this->m_cells[tail & (N - 1)];
+		if (c.seq.load(std::memory_order_seq_cst) == tail)
+			return &c.value;
+		return nullptr;
+	}
+
+	// tryAcquire(), sleeping up to timeout ms for the consumer to make room, nullptr on timeout
+	T* waitAcquire(uint32_t timeout)
+	{
+		T* slot = this->tryAcquire();
+		if (slot)
+			return slot;
+
+		std::unique_lock<std::mutex> lock(this->m_mutex);
+		this->m_blocked.store(true, std::memory_order_seq_cst);
+		this->m_room.wait_for(lock, std::chrono::milliseconds(timeout), [this]() {
+			return this->tryAcquire() != nullptr;
+		});
+		this->m_blocked.store(false, std::memory_order_relaxed);
+		lock.unlock();
+
+		return this->tryAcquire();
+	}
+
+	void commit()
+	{
+		const size_t tail = this->m_tail.load(std::memory_order_relaxed);
+		this->m_cells[tail & (N - 1)].seq.store(tail + 1, std::memory_order_release);
+		this->m_tail.store(tail + 1, std::memory_order_seq_cst);
+		++this->m_pushed;
+
+		if (this->m_sleeping.load(std::memory_order_seq_cst))
+		{
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_ready.notify_one();
+		}
+	}
+
+	bool push(const T& value)
+	{
+		T* slot = this->acquire();
+		if (!slot)
+			return false;
+		*slot = value;
+		this->commit();
+		return true;
+	}
+
+	// consumer side, peek() claims the oldest element or returns nullptr when empty, release() hands the cell back
+	T* peek()
+	{
+		size_t head = this->m_head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell& c = this->m_cells[head & (N - 1)];
+			const intptr_t diff = (intptr_t)(c.seq.load(std::memory_order_acquire) - (head + 1));
+			if (diff < 0)
+				return nullptr;
+
+			// lost the race against a drop, or head is stale: look again from the new head
+			if (diff == 0 && this->m_head.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel))
+			{
+				this->m_reading = head;
+				return &c.value;
+			}
+			if (diff > 0)
+				head = this->m_head.load(std::memory_order_relaxed);
+		}
+	}
+
+	void release()
+	{
+		// seq_cst against m_blocked so a waiting producer is never missed
+		this->m_cells[this->m_reading & (N - 1)].seq.store(this->m_reading + N, std::memory_order_seq_cst);
+
+		if (this->m_blocked.load(std::memory_order_seq_cst))
+		{
+			std::lock_guard<std::mutex> lock(this->m_mutex);
+			this->m_room.notify_one();
+		}
+	}
+
+	bool pop(T& value)
+	{
+		T* slot = this->peek();
+		if (!slot)
+			return false;
+		value = *slot;
+		this->release();
+		return true;
+	}
+
+	// peek(), sleeping up to timeout ms for an element, nullptr on timeout or wake()
+	T* wait(uint32_t timeout)
+	{
+		T* slot = this->peek();
+		if (slot)
+			return slot;
+
+		std::unique_lock<std::mutex> lock(this->m_mutex);
+		this->m_sleeping.store(true, std::memory_order_seq_cst);
+		this->m_ready.wait_for(lock, std::chrono::milliseconds(timeout), [this]() {
+			return this->m_woken || this->ready();
+		});
+		this->m_sleeping.store(false, std::memory_order_relaxed);
+		this->m_woken = false;
+		lock.unlock();
+
+		return this->peek();
+	}
+
+	// any thread, a sleeping wait() returns
+	void wake()
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_woken = true;
+		this->m_ready.notify_one();
+	}
+
+	// set data
+	void setPolicy(DROP_POLICY policy)
+	{
+		this->m_policy = policy;
+	}
+
+	// cells only tryAcquire() and waitAcquire() may fill, DROP_NEWEST only
+	void setReserve(size_t reserve)
+	{
+		this->m_reserve = reserve;
+	}
+
+	// get data, approximate when called from a third thread
+	size_t size() const
+	{
+		const size_t tail = this->m_tail.load(std::memory_order_acquire);
+		const size_t head = this->m_head.load(std::memory_order_acquire);
+		return tail > head ? tail - head : 0;
+	}
+
+	DROP_POLICY getPolicy() const
+	{
+		return (DROP_POLICY)this->m_policy.load();
+	}
+
+	uint64_t getPushed() const
+	{
+		return this->m_pushed;
+	}
+
+	uint64_t getDropped() const
+	{
+		return this->m_dropped;
+	}
+
+	static constexpr size_t capacity() { return N; }
+
+private:	// functions
+	bool ready() const
+	{
+		// m_tail is stored after the cell, and seq_cst against m_sleeping so a commit is never missed
+		return this->m_tail.load(std::memory_order_seq_cst) != this->m_head.load(std::memory_order_seq_cst);
+	}
+};
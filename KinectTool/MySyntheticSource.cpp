@@ -0,0 +1,210 @@
+#include "MySyntheticSource.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// poses made up when there is no library to borrow from
+static const int RANDOM_POSES = 16;
+
+MySyntheticSource::MySyntheticSource(const settings& config, const MyPoseLibrary* library)
+{
+	this->m_settings = config;
+	this->m_settings.bodies = std::min(std::max(config.bodies, 1), MAX_BODIES);
+	this->m_settings.hz = std::max(config.hz, 1.0f);
+	this->m_library = library;
+	this->m_poseCount = 0;
+
+	this->m_noise = std::normal_distribution<float>(0.0f, std::max(config.jitter, 0.0f));
+	this->m_chance = std::uniform_real_distribution<float>(0.0f, 1.0f);
+	this->m_frame = 0;
+
+	this->m_generated = 0;
+}
+
+MySyntheticSource::settings MySyntheticSource::Defaults()
+{
+	settings config;
+	config.bodies = 1;
+	config.hz = 30.0f;
+	config.realtime = true;
+	config.frames = 0;
+	config.jitter = 0.01f;
+	config.holdMs = 2000.0f;
+	config.transitionMs = 500.0f;
+	config.dropRate = 0.0f;
+	config.dropMs = 200.0f;
+	config.dropJoints.fill(false);
+	config.seed = 1;
+	return config;
+}
+
+bool MySyntheticSource::Open()
+{
+	this->m_random.seed(this->m_settings.seed);
+
+	// copy the poses, the library may change while we run
+	this->m_poses.clear();
+	if (this->m_library && this->m_library->size() > 0)
+	{
+		this->m_poseCount = (int)this->m_library->size();
+		this->m_poses.resize((size_t)this->m_poseCount * JOINTS * 4);
+		for (int p = 0; p < this->m_poseCount; ++p)
+			for (int j = 0; j < JOINTS; ++j)
+				this->m_library->getOrientation(p, j, &this->m_poses[((size_t)p * JOINTS + j) * 4]);
+	}
+	else
+	{
+		// random unit quaternions
+		std::normal_distribution<float> normal(0.0f, 1.0f);
+		this->m_poseCount = RANDOM_POSES;
+		this->m_poses.resize((size_t)this->m_poseCount * JOINTS * 4);
+		for (size_t i = 0; i < this->m_poses.size(); i += 4)
+		{
+			float* q = &this->m_poses[i];
+			float norm = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				q[c] = normal(this->m_random);
+				norm += q[c] * q[c];
+			}
+			norm = std::sqrt(norm);
+			for (int c = 0; c < 4; ++c)
+				q[c] /= norm;
+		}
+	}
+
+	// start every body somewhere else in its hold so they do not all move at once
+	for (int b = 0; b < MAX_BODIES; ++b)
+	{
+		body_state& state = this->m_bodies[b];
+		state.from = this->PickPose(-1);
+		state.to = state.from;
+		state.phaseStart = -(int64_t)(this->m_chance(this->m_random) * this->m_settings.holdMs * 1000.0f);
+		state.moving = false;
+		state.droppedUntil.fill(0);
+	}
+
+	this->m_frame = 0;
+	this->m_start = std::chrono::steady_clock::now();
+
+	printf("Synthetic source: %d bodies at %.0f Hz over %d poses\n", this->m_settings.bodies, this->m_settings.hz, this->m_poseCount);
+	return true;
+}
+
+void MySyntheticSource::Close() {}
+
+SOURCE_RESULT MySyntheticSource::Acquire(frame_data& frame, uint32_t timeout)
+{
+	if (this->m_settings.frames && this->m_frame >= this->m_settings.frames)
+		return SOURCE_END;
+
+	const int64_t timestamp = (int64_t)(this->m_frame * 1000000.0 / this->m_settings.hz);
+	if (this->m_settings.realtime)
+	{
+		const std::chrono::steady_clock::time_point due = this->m_start + std::chrono::microseconds(timestamp);
+		if (!this->WaitUntil(due, timeout))
+			return SOURCE_NONE;
+	}
+
+	frame.count = this->m_settings.bodies;
+	frame.timestamp = (uint64_t)timestamp;
+	for (int b = 0; b < this->m_settings.bodies; ++b)
+		this->Generate(b, timestamp, frame.bodies[b]);
+
+	++this->m_frame;
+	++this->m_generated;
+	return SOURCE_FRAME;
+}
+
+bool MySyntheticSource::canWait() const
+{
+	return !this->m_settings.realtime;
+}
+
+uint64_t MySyntheticSource::getGenerated() const
+{
+	return this->m_generated;
+}
+
+void MySyntheticSource::Generate(int index, int64_t timestamp, body_data& body)
+{
+	body_state& state = this->m_bodies[index];
+	const int64_t hold = (int64_t)(this->m_settings.holdMs * 1000.0f);
+	const int64_t transition = std::max<int64_t>(1, (int64_t)(this->m_settings.transitionMs * 1000.0f));
+
+	// hold -> move -> hold on the next pose
+	if (!state.moving && timestamp - state.phaseStart >= hold)
+	{
+		state.to = this->PickPose(state.from);
+		state.moving = state.to != state.from;
+		state.phaseStart = timestamp;
+	}
+	float t = 0.0f;
+	if (state.moving)
+	{
+		t = (float)(timestamp - state.phaseStart) / (float)transition;
+		if (t >= 1.0f)
+		{
+			state.from = state.to;
+			state.moving = false;
+			state.phaseStart = timestamp;
+			t = 0.0f;
+		}
+	}
+
+	body.id = (uint64_t)index + 1;
+
+	const float* from = &this->m_poses[(size_t)state.from * JOINTS * 4];
+	const float* to = &this->m_poses[(size_t)state.to * JOINTS * 4];
+	for (int j = 0; j < JOINTS; ++j)
+	{
+		// normalized lerp along the shorter arc, then noise
+		const float* a = from + j * 4;
+		const float* b = to + j * 4;
+		const float sign = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]) < 0.0f ? -1.0f : 1.0f;
+
+		float q[4];
+		float norm = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			q[c] = a[c] + (sign * b[c] - a[c]) * t;
+			if (this->m_settings.jitter > 0.0f)
+				q[c] += this->m_noise(this->m_random);
+			norm += q[c] * q[c];
+		}
+		norm = norm > 0.0f ? 1.0f / std::sqrt(norm) : 0.0f;
+		for (int c = 0; c < 4; ++c)
+			q[c] *= norm;
+		SetJointOrientation(body.skeleton, j, q);
+
+		// the matcher only reads orientations, positions just need to be drawable: a 5 x 5 grid per body
+		const float p[3] = {
+			(index - (this->m_settings.bodies - 1) * 0.5f) * 1.0f + (j % 5 - 2) * 0.15f,
+			0.8f - (j / 5) * 0.35f,
+			2.5f
+		};
+		SetJointPosition(body.skeleton, j, p);
+
+		// dropouts
+		if (this->m_settings.dropJoints[j] && timestamp >= state.droppedUntil[j] &&
+			this->m_chance(this->m_random) < this->m_settings.dropRate)
+		{
+			state.droppedUntil[j] = timestamp + (int64_t)(this->m_settings.dropMs * 1000.0f);
+		}
+		SetJointTracked(body.skeleton, j, timestamp >= state.droppedUntil[j]);
+	}
+}
+
+int MySyntheticSource::PickPose(int except)
+{
+	if (this->m_poseCount < 2)
+		return 0;
+
+	// uniform over every pose for a first pick, over the other poses after that
+	if (except < 0)
+		return std::uniform_int_distribution<int>(0, this->m_poseCount - 1)(this->m_random);
+	std::uniform_int_distribution<int> pick(0, this->m_poseCount - 2);
+	const int pose = pick(this->m_random);
+	return pose >= except ? pose + 1 : pose;
+}
@@ -0,0 +1,83 @@
+#pragma once
+// kinect
+#include "MySkeletonData.h"
+
+// my classes
+#include "MySkeletonSource.h"
+#include "MyPoseLibrary.h"
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Generates skeletons instead of reading them, to load the matcher harder than a sensor can.
+// Every body holds a pose with jitter, moves to another pose, holds it, and so on. Poses are taken from a
+// library (copied at Open) or made up at random. Selected joints can drop out for a while to mimic tracking loss.
+// Timestamps follow the configured rate whether frames are paced in real time or produced as fast as asked for.
+class MySyntheticSource : public MySkeletonSource {
+public:		// data structures
+	struct settings {
+		int bodies;							// 1 to MAX_BODIES
+		float hz;							// frame rate of the timestamps
+		bool realtime;						// sleep to keep the rate, otherwise never wait
+		uint64_t frames;					// frames to produce, 0 for no end
+		float jitter;						// standard deviation added to every quaternion component
+		float holdMs;						// time spent on a pose
+		float transitionMs;					// time spent moving between two poses
+		float dropRate;						// chance per frame that a selected joint drops out
+		float dropMs;						// how long a dropped joint stays untracked
+		std::array<bool, JOINTS> dropJoints;	// joints allowed to drop out
+		uint32_t seed;
+	};
+
+private:	// data structures
+	struct body_state {
+		int from;							// pose held, or left while moving
+		int to;								// pose moved to
+		int64_t phaseStart;					// timestamp the hold or move started
+		bool moving;
+		std::array<int64_t, JOINTS> droppedUntil;
+	};
+
+private:	// variables
+	settings m_settings;
+	const MyPoseLibrary* m_library;
+	std::vector<float> m_poses;				// [pose][joint][w, x, y, z]
+	int m_poseCount;
+
+	// capture thread only
+	std::array<body_state, MAX_BODIES> m_bodies;
+	std::mt19937 m_random;
+	std::normal_distribution<float> m_noise;
+	std::uniform_real_distribution<float> m_chance;
+	uint64_t m_frame;
+	std::chrono::steady_clock::time_point m_start;
+
+	// statistics
+	std::atomic<uint64_t> m_generated;
+
+public:		// functions
+
+	// constructer
+	MySyntheticSource(const settings& config, const MyPoseLibrary* library = nullptr);
+
+	// one body, 30 Hz, paced, light jitter, no dropouts
+	static settings Defaults();
+
+	// operations
+	bool Open();
+	void Close();
+	SOURCE_RESULT Acquire(frame_data& frame, uint32_t timeout);
+	bool canWait() const;
+
+	// get data
+	uint64_t getGenerated() const;
+
+private:	// functions
+	void Generate(int index, int64_t timestamp, body_data& body);
+	int PickPose(int except);
+};
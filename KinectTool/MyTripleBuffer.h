@@ -0,0 +1,68 @@
+#pragma once
+// std
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer / single-consumer triple buffer.
+// The producer always owns one slot to write into and the consumer always owns one slot to read from,
+// the third slot is exchanged between them atomically, so neither side ever blocks the other
+// and the consumer never sees a half-written value.
+template <typename T>
+class MyTripleBuffer {
+private:	// data structures
+	struct alignas(64) slot {
+		T value;
+	};
+
+private:	// variables
+	static const uint8_t INDEX_MASK = 0x3;
+	static const uint8_t DIRTY = 0x4;	// set when the shared slot holds data the consumer has not seen
+
+	slot m_slots[3];
+	alignas(64) std::atomic<uint8_t> m_middle;
+	alignas(64) uint8_t m_back;		// owned by the producer
+	alignas(64) uint8_t m_front;	// owned by the consumer
+
+public:		// functions
+
+	// constructer
+	MyTripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+	MyTripleBuffer(const MyTripleBuffer&) = delete;
+	MyTripleBuffer& operator=(const MyTripleBuffer&) = delete;
+
+	// fill every slot with the same value, only call this while no thread is using the buffer
+	void reset(const T& value)
+	{
+		for (slot& s : this->m_slots)
+			s.value = value;
+		this->m_middle.store(1, std::memory_order_relaxed);
+		this->m_back = 0;
+		this->m_front = 2;
+	}
+
+	// producer side: fill back() then publish() it
+	T& back()
+	{
+		return this->m_slots[this->m_back].value;
+	}
+
+	void publish()
+	{
+		this->m_back = this->m_middle.exchange(this->m_back | DIRTY, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// consumer side: update() grabs the newest published value, returns false if nothing new arrived
+	bool update()
+	{
+		if (!(this->m_middle.load(std::memory_order_relaxed) & DIRTY))
+			return false;
+
+		this->m_front = this->m_middle.exchange(this->m_front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& front() const
+	{
+		return this->m_slots[this->m_front].value;
+	}
+};
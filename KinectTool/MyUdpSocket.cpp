@@ -0,0 +1,176 @@
+#include "MyUdpSocket.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+static const uintptr_t NO_SOCKET = (uintptr_t)INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+static const int NO_SOCKET = -1;
+#endif
+
+#if defined(_WIN32)
+// Winsock wants one WSAStartup before the first socket, it is never undone
+static bool Startup()
+{
+	static const bool started = []() {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return started;
+}
+#endif
+
+static sockaddr_in ToSockaddr(const MyUdpSocket::address& address)
+{
+	sockaddr_in result;
+	std::memset(&result, 0, sizeof(result));
+	result.sin_family = AF_INET;
+	result.sin_addr.s_addr = htonl(address.ip);
+	result.sin_port = htons(address.port);
+	return result;
+}
+
+MyUdpSocket::MyUdpSocket()
+{
+	this->m_socket = NO_SOCKET;
+}
+
+MyUdpSocket::~MyUdpSocket()
+{
+	this->Close();
+}
+
+bool MyUdpSocket::Open(uint16_t port)
+{
+	this->Close();
+
+#if defined(_WIN32)
+	if (!Startup())
+		return false;
+	this->m_socket = (uintptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#else
+	this->m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#endif
+	if (this->m_socket == NO_SOCKET)
+		return false;
+
+	// never block the sender, a full buffer drops the datagram like the network would
+#if defined(_WIN32)
+	u_long nonBlocking = 1;
+	ioctlsocket((SOCKET)this->m_socket, FIONBIO, &nonBlocking);
+#else
+	fcntl(this->m_socket, F_SETFL, fcntl(this->m_socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+	// room for bursts of frames
+	const int buffer = 1 << 20;
+	setsockopt(this->m_socket, SOL_SOCKET, SO_RCVBUF, (const char*)&buffer, sizeof(buffer));
+	setsockopt(this->m_socket, SOL_SOCKET, SO_SNDBUF, (const char*)&buffer, sizeof(buffer));
+
+	const address any = { INADDR_ANY, port };
+	const sockaddr_in local = ToSockaddr(any);
+	if (bind(this->m_socket, (const sockaddr*)&local, sizeof(local)) != 0)
+	{
+		this->Close();
+		return false;
+	}
+	return true;
+}
+
+void MyUdpSocket::Close()
+{
+	if (this->m_socket == NO_SOCKET)
+		return;
+
+#if defined(_WIN32)
+	closesocket((SOCKET)this->m_socket);
+#else
+	close(this->m_socket);
+#endif
+	this->m_socket = NO_SOCKET;
+}
+
+bool MyUdpSocket::Send(const address& to, const void* data, size_t size)
+{
+	const sockaddr_in remote = ToSockaddr(to);
+	return sendto(this->m_socket, (const char*)data, (int)size, 0, (const sockaddr*)&remote, sizeof(remote)) == (int)size;
+}
+
+int MyUdpSocket::Receive(void* data, size_t size, uint32_t timeout, address* from)
+{
+#if defined(_WIN32)
+	WSAPOLLFD fd = { (SOCKET)this->m_socket, POLLRDNORM, 0 };
+	const int ready = WSAPoll(&fd, 1, (INT)timeout);
+#else
+	pollfd fd = { this->m_socket, POLLIN, 0 };
+	const int ready = poll(&fd, 1, (int)timeout);
+#endif
+	if (ready < 0)
+		return -1;
+	if (ready == 0)
+		return 0;
+
+	sockaddr_in remote;
+	socklen_t length = sizeof(remote);
+	const int received = (int)recvfrom(this->m_socket, (char*)data, (int)size, 0, (sockaddr*)&remote, &length);
+	if (received < 0)
+		return 0;
+
+	if (from)
+	{
+		from->ip = ntohl(remote.sin_addr.s_addr);
+		from->port = ntohs(remote.sin_port);
+	}
+	return received;
+}
+
+bool MyUdpSocket::isOpen() const
+{
+	return this->m_socket != NO_SOCKET;
+}
+
+bool MyUdpSocket::Resolve(const char* text, address& result)
+{
+	const char* colon = strrchr(text, ':');
+	if (!colon || colon == text)
+		return false;
+
+	const int port = atoi(colon + 1);
+	if (port <= 0 || port > 65535)
+		return false;
+
+#if defined(_WIN32)
+	if (!Startup())
+		return false;
+#endif
+
+	const std::string host(text, colon - text);
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* found = nullptr;
+	if (getaddrinfo(host.c_str(), nullptr, &hints, &found) != 0 || !found)
+	{
+		printf("Can't resolve %s\n", host.c_str());
+		return false;
+	}
+
+	result.ip = ntohl(((const sockaddr_in*)found->ai_addr)->sin_addr.s_addr);
+	result.port = (uint16_t)port;
+	freeaddrinfo(found);
+	return true;
+}
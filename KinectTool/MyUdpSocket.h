@@ -0,0 +1,43 @@
+#pragma once
+// std
+#include <cstddef>
+#include <cstdint>
+
+// Non-blocking IPv4 UDP socket, Winsock or BSD sockets underneath.
+class MyUdpSocket {
+public:		// data structures
+	struct address {
+		uint32_t ip;				// host byte order
+		uint16_t port;
+	};
+
+private:	// variables
+#if defined(_WIN32)
+	uintptr_t m_socket;
+#else
+	int m_socket;
+#endif
+
+public:		// functions
+
+	// constructer
+	MyUdpSocket();
+	~MyUdpSocket();
+	MyUdpSocket(const MyUdpSocket&) = delete;
+	MyUdpSocket& operator=(const MyUdpSocket&) = delete;
+
+	// operations
+	// port 0 lets the system pick one, for sending only
+	bool Open(uint16_t port = 0);
+	void Close();
+	bool Send(const address& to, const void* data, size_t size);
+	// waits up to timeout ms for a datagram, returns its size, 0 if none came, -1 on error
+	int Receive(void* data, size_t size, uint32_t timeout, address* from = nullptr);
+
+	// get data
+	bool isOpen() const;
+
+	// tools
+	// "host:port", the host as a name or dotted quad
+	static bool Resolve(const char* text, address& result);
+};
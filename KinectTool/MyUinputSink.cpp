@@ -0,0 +1,157 @@
+#include "MyUinputSink.h"
+
+#include <cstdio>
+#include <cstring>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#endif
+
+#if defined(__linux__)
+// virtual-key code -> linux key code, 0 where there is none
+static const unsigned short letters[26] = {
+	KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+	KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+};
+static const unsigned short digits[10] = {
+	KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9
+};
+static const unsigned short functions[12] = {
+	KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12
+};
+#endif
+
+MyUinputSink::MyUinputSink()
+{
+	this->m_fd = -1;
+}
+
+MyUinputSink::~MyUinputSink()
+{
+	this->Close();
+}
+
+bool MyUinputSink::Open()
+{
+#if defined(__linux__)
+	if (this->m_fd >= 0)
+		return true;
+
+	this->m_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (this->m_fd < 0)
+	{
+		printf("Can't open /dev/uinput, keys will not be sent\n");
+		return false;
+	}
+
+	// announce every key we may send
+	ioctl(this->m_fd, UI_SET_EVBIT, EV_KEY);
+	for (int key = 0; key < 256; ++key)
+	{
+		const int code = MyUinputSink::ToLinux(key);
+		if (code)
+			ioctl(this->m_fd, UI_SET_KEYBIT, code);
+	}
+
+	struct uinput_setup setup;
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_VIRTUAL;
+	setup.id.vendor = 0x4b54;		// "KT"
+	setup.id.product = 0x0001;
+	strncpy(setup.name, "KinectTool virtual keyboard", UINPUT_MAX_NAME_SIZE - 1);
+
+	if (ioctl(this->m_fd, UI_DEV_SETUP, &setup) < 0 || ioctl(this->m_fd, UI_DEV_CREATE) < 0)
+	{
+		printf("Can't create the uinput keyboard, keys will not be sent\n");
+		close(this->m_fd);
+		this->m_fd = -1;
+		return false;
+	}
+	return true;
+#else
+	printf("uinput is only available on Linux\n");
+	return false;
+#endif
+}
+
+void MyUinputSink::Close()
+{
+#if defined(__linux__)
+	if (this->m_fd < 0)
+		return;
+
+	ioctl(this->m_fd, UI_DEV_DESTROY);
+	close(this->m_fd);
+	this->m_fd = -1;
+#endif
+}
+
+bool MyUinputSink::Send(int key, KEY_ACTION action)
+{
+#if defined(__linux__)
+	const int code = MyUinputSink::ToLinux(key);
+	if (this->m_fd < 0 || !code)
+		return false;
+
+	// every change is followed by a report
+	if (action != KEY_RELEASE && !(this->Emit(EV_KEY, code, 1) && this->Emit(EV_SYN, SYN_REPORT, 0)))
+		return false;
+	if (action != KEY_PRESS && !(this->Emit(EV_KEY, code, 0) && this->Emit(EV_SYN, SYN_REPORT, 0)))
+		return false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char* MyUinputSink::getName() const
+{
+	return "uinput";
+}
+
+int MyUinputSink::ToLinux(int key)
+{
+#if defined(__linux__)
+	if (key >= 'A' && key <= 'Z')
+		return letters[key - 'A'];
+	if (key >= '0' && key <= '9')
+		return digits[key - '0'];
+	if (key >= 0x70 && key <= 0x7B)		// VK_F1 to VK_F12
+		return functions[key - 0x70];
+
+	switch (key)
+	{
+	case 0x08: return KEY_BACKSPACE;	// VK_BACK
+	case 0x09: return KEY_TAB;			// VK_TAB
+	case 0x0D: return KEY_ENTER;		// VK_RETURN
+	case 0x10: return KEY_LEFTSHIFT;	// VK_SHIFT
+	case 0x11: return KEY_LEFTCTRL;		// VK_CONTROL
+	case 0x12: return KEY_LEFTALT;		// VK_MENU
+	case 0x1B: return KEY_ESC;			// VK_ESCAPE
+	case 0x20: return KEY_SPACE;		// VK_SPACE
+	case 0x25: return KEY_LEFT;			// VK_LEFT
+	case 0x26: return KEY_UP;			// VK_UP
+	case 0x27: return KEY_RIGHT;		// VK_RIGHT
+	case 0x28: return KEY_DOWN;			// VK_DOWN
+	default: return 0;
+	}
+#else
+	return 0;
+#endif
+}
+
+bool MyUinputSink::Emit(int type, int code, int value)
+{
+#if defined(__linux__)
+	struct input_event event;
+	memset(&event, 0, sizeof(event));
+	event.type = (unsigned short)type;
+	event.code = (unsigned short)code;
+	event.value = value;
+	return write(this->m_fd, &event, sizeof(event)) == (ssize_t)sizeof(event);
+#else
+	return false;
+#endif
+}
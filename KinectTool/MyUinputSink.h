@@ -0,0 +1,29 @@
+#pragma once
+// my classes
+#include "MyKeySink.h"
+
+// Keys go through a virtual keyboard created with /dev/uinput, so every application sees them,
+// under X11 and Wayland alike. Linux only, needs write access to /dev/uinput.
+// Virtual-key codes without a Linux counterpart are not sent.
+class MyUinputSink : public MyKeySink {
+private:	// variables
+	int m_fd;
+
+public:		// functions
+
+	// constructer
+	MyUinputSink();
+	~MyUinputSink();
+
+	// operations
+	bool Open();
+	void Close();
+	bool Send(int key, KEY_ACTION action);
+
+	// get data
+	const char* getName() const;
+
+private:	// functions
+	static int ToLinux(int key);
+	bool Emit(int type, int code, int value);
+};
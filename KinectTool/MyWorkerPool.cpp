@@ -0,0 +1,131 @@
+#include "MyWorkerPool.h"
+
+MyWorkerPool::MyWorkerPool()
+{
+	this->m_stopping = false;
+	this->m_fn = nullptr;
+	this->m_context = nullptr;
+	this->m_count = 0;
+	this->m_generation = 0;
+	this->m_next = 0;
+	this->m_done = 0;
+}
+
+MyWorkerPool::~MyWorkerPool()
+{
+	this->Stop();
+}
+
+void MyWorkerPool::Start(int workers)
+{
+	if (!this->m_threads.empty())
+		return;
+
+	this->m_stopping = false;
+	for (int i = 0; i < workers; ++i)
+		this->m_threads.push_back(new std::thread(&MyWorkerPool::Worker, this, i + 1));
+}
+
+void MyWorkerPool::Stop()
+{
+	if (this->m_threads.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_stopping = true;
+	}
+	this->m_wake.notify_all();
+
+	for (std::thread* thread : this->m_threads)
+	{
+		thread->join();
+		delete thread;
+	}
+	this->m_threads.clear();
+}
+
+void MyWorkerPool::Run(job_fn fn, void* context, int count)
+{
+	if (count <= 0)
+		return;
+
+	// nothing to share, skip the wake up
+	if (this->m_threads.empty() || count == 1)
+	{
+		for (int job = 0; job < count; ++job)
+			fn(context, job, 0);
+		return;
+	}
+
+	uint32_t generation;
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_fn = fn;
+		this->m_context = context;
+		this->m_count = count;
+		this->m_done.store(0, std::memory_order_relaxed);
+
+		generation = this->m_generation.load(std::memory_order_relaxed) + 1;
+		this->m_next.store((uint64_t)generation << 32, std::memory_order_relaxed);
+		this->m_generation.store(generation, std::memory_order_release);
+	}
+	this->m_wake.notify_all();
+
+	this->Drain(generation, fn, context, count, 0);
+
+	// the last jobs may still run on the workers, they are short
+	while (this->m_done.load(std::memory_order_acquire) < count)
+		std::this_thread::yield();
+}
+
+int MyWorkerPool::size() const
+{
+	return (int)this->m_threads.size() + 1;
+}
+
+void MyWorkerPool::Worker(int worker)
+{
+	uint32_t seen = 0;
+	while (true)
+	{
+		uint32_t generation;
+		job_fn fn;
+		void* context;
+		int count;
+		{
+			// the run is read under the lock, Run() may already be setting up the next one
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_wake.wait(lock, [&]() {
+				return this->m_stopping || this->m_generation.load(std::memory_order_relaxed) != seen;
+			});
+			if (this->m_stopping)
+				return;
+			generation = this->m_generation.load(std::memory_order_relaxed);
+			fn = this->m_fn;
+			context = this->m_context;
+			count = this->m_count;
+		}
+
+		seen = generation;
+		this->Drain(generation, fn, context, count, worker);
+	}
+}
+
+void MyWorkerPool::Drain(uint32_t generation, job_fn fn, void* context, int count, int worker)
+{
+	uint64_t next = this->m_next.load(std::memory_order_acquire);
+	while (true)
+	{
+		// another run started, or every job of this one is taken
+		if ((uint32_t)(next >> 32) != generation || (int)(uint32_t)next >= count)
+			return;
+
+		if (!this->m_next.compare_exchange_weak(next, next + 1, std::memory_order_acq_rel))
+			continue;
+
+		fn(context, (int)(uint32_t)next, worker);
+		this->m_done.fetch_add(1, std::memory_order_release);
+		next = this->m_next.load(std::memory_order_acquire);
+	}
+}
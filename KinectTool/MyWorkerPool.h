@@ -0,0 +1,52 @@
+#pragma once
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*job_fn)(void* context, int job, int worker);
+
+// A few threads that split small batches of jobs with the caller, e.g. one match per tracked body.
+// Run() wakes the workers, takes jobs itself as worker 0 and returns once every job is done.
+// Jobs are claimed with a compare-and-swap on (run, next job), so a worker that wakes up late
+// can never take a job of the following run. Nothing is allocated after Start().
+class MyWorkerPool {
+private:	// variables
+	std::vector<std::thread*> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping;
+
+	// the current run, written by Run() under the lock together with the generation
+	job_fn m_fn;
+	void* m_context;
+	int m_count;
+	std::atomic<uint32_t> m_generation;
+	std::atomic<uint64_t> m_next;		// generation << 32 | next job
+	std::atomic<int> m_done;
+
+public:		// functions
+
+	// constructer
+	MyWorkerPool();
+	~MyWorkerPool();
+	MyWorkerPool(const MyWorkerPool&) = delete;
+	MyWorkerPool& operator=(const MyWorkerPool&) = delete;
+
+	// operations
+	void Start(int workers);
+	void Stop();
+
+	// calls fn(context, job, worker) for job in [0, count), worker is in [0, size())
+	void Run(job_fn fn, void* context, int count);
+
+	// get data, threads taking jobs including the caller
+	int size() const;
+
+private:	// functions
+	void Worker(int worker);
+	void Drain(uint32_t generation, job_fn fn, void* context, int count, int worker);
+};
@@ -1,25 +1,42 @@
 #version 330
 
-layout(location = 0) in vec3 iPos;
-layout(location = 1) in int iCon;
+// every body and ghost is an instance, uStride texels each: x, y, z and state per joint, then its color,
+// lines come from the bone indices and points from 0 .. joints, so gl_VertexID is the joint either way
+uniform samplerBuffer uJoints;
+uniform int uBase = 0;
+uniform int uStride = 1;
 
 uniform mat4 uProj = mat4(1.0);
 uniform mat4 uView = mat4(1.0);
 uniform mat4 uModel = mat4(1.0);
 
-uniform vec4 uColor = vec4(1.0, 0.0, 0.0, 1.0);
 uniform int uMode = 0;
 
 out vec4 oColor;
 
 void main(void)
 {
-	gl_Position = uProj * uView * uModel * vec4(iPos, 1.0);
+	int first = uBase + gl_InstanceID * uStride;
+	vec4 joint = texelFetch(uJoints, first + gl_VertexID);
+	vec4 color = texelFetch(uJoints, first + uStride - 1);
+
+	gl_Position = uProj * uView * uModel * vec4(joint.xyz, 1.0);
 
 	if(uMode == 1)
 	{
 		gl_PointSize = 5;
-		if(iCon > 0)
+		if(color.a < 1.0f)
+		{
+			// ghost
+			oColor = color;
+		}
+		else if(joint.w > 1.5f)
+		{
+			// failed the test
+			gl_PointSize = 10;
+			oColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);
+		}
+		else if(joint.w > 0.5f)
 		{
 			oColor = vec4(0.0f, 1.0f, 0.0f, 1.0f);
 		}
@@ -28,14 +45,9 @@ void main(void)
 			oColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);
 		}
 	}
-	else if(uMode == 2)
-	{
-		gl_PointSize = 10;
-		oColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);
-	}
 	else
 	{
 		gl_PointSize = 1;
-		oColor = uColor;
+		oColor = color;
 	}
 }
\ No newline at end of file
@@ -14,12 +14,17 @@
 
 // std
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 // my classes
 #include "MySkeleton.h"
+#include "MyReplaySource.h"
+#include "MySyntheticSource.h"
 
 int lastKey = 0;
 
@@ -111,17 +116,66 @@ static void RenderTriangle()
 /*************************************************************************************************/
 /*                                     Main Function                                             */
 /*************************************************************************************************/
-int main(int, char**)
+int main(int argc, char** argv)
 {
+	// KinectTool [--replay session.ktr [--fast] [--loop]]
+	//            [--synthetic [--bodies n] [--hz f] [--jitter f] [--drop rate] [--fast]] [--library poses.kpl]
+	MyReplaySource* replay = nullptr;
+	MySyntheticSource* synthetic = nullptr;
+	MySyntheticSource::settings config = MySyntheticSource::Defaults();
+	bool useSynthetic = false;
+	const char* libraryPath = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replay = new MyReplaySource(argv[++i]);
+		else if (strcmp(argv[i], "--synthetic") == 0)
+			useSynthetic = true;
+		else if (strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+			config.bodies = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--hz") == 0 && i + 1 < argc)
+			config.hz = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc)
+			config.jitter = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc)
+		{
+			config.dropRate = (float)atof(argv[++i]);
+			config.dropJoints.fill(true);
+		}
+		else if (strcmp(argv[i], "--library") == 0 && i + 1 < argc)
+			libraryPath = argv[++i];
+		else if (strcmp(argv[i], "--fast") == 0)
+		{
+			config.realtime = false;
+			if (replay)
+				replay->setRealtime(false);
+		}
+		else if (strcmp(argv[i], "--loop") == 0 && replay)
+			replay->setLoop(true);
+		else
+		{
+			printf("usage: %s [--replay session.ktr [--fast] [--loop]]\n", argv[0]);
+			printf("       %s [--synthetic [--bodies n] [--hz f] [--jitter f] [--drop rate] [--fast]] [--library poses.kpl]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	// the generator moves between the poses of the library, if one is given
+	MyPoseLibrary library;
+	if (libraryPath && !library.Import(libraryPath))
+		printf("Can't import %s\n", libraryPath);
+	if (useSynthetic && !replay)
+		synthetic = new MySyntheticSource(config, &library);
+
 	glfwSetErrorCallback(glfw_error_callback);
 
 	if (!glfwInit())
 		return 1;
 
-	// GL 3.0 + GLSL 130
-	const char* glsl_version = "#version 130";
+	// GL 3.3 + GLSL 330, for instancing and texture buffers
+	const char* glsl_version = "#version 330";
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
 	// Create window with graphics context
 	GLFWwindow* window = glfwCreateWindow(1280, 720, "Kinect to Keyboard", nullptr, nullptr);
@@ -186,10 +240,17 @@ int main(int, char**)
 	glLinkProgram(shaderProgram);
 	glDeleteShader(vs);
 	glDeleteShader(fs);
+	const GLint uProj = glGetUniformLocation(shaderProgram, "uProj");
+	const GLint uView = glGetUniformLocation(shaderProgram, "uView");
 
 	// my skeleton class
 	MySkeleton* skeleton = new MySkeleton();
-	skeleton->Init(window);
+	if (synthetic)
+		skeleton->Init(window, synthetic);
+	else
+		skeleton->Init(window, replay);
+	if (libraryPath)
+		skeleton->Import(libraryPath);
 	skeleton->Start();
 
 	// Main loop
@@ -208,10 +269,19 @@ int main(int, char**)
 			static char str[128] = "";
 			static char input_path[128] = "";
 			static char output_path[128] = "";
-			static std::array<bool, JOINTS>& checkList = skeleton->getCheckList();
+			static char record_path[128] = "session.ktr";
+			static char subscribers[256] = "127.0.0.1:9001";
+			static std::array<bool, JOINTS> checkList = skeleton->getCheckList();
 			static float thresh = 0.5f;
+			static float hold = skeleton->getHoldTime();
+			static float gestureThresh = 0.3f;
 			static int guiMode = RECORD;
 			static const char* modeName[MODE_COUNT] = { "Record", "Execute" };
+			static MyPoseLibrary::binding bind = MyPoseLibrary::DefaultBinding();
+			static int bindMode = bind.mode;
+			static int repeatMs = bind.repeatMs;
+			static int cooldownMs = bind.cooldownMs;
+			static const char* bindName[BIND_MODE_COUNT] = { "Tap", "Hold", "Repeat" };
 
 			// setup gui
 			static const ImGuiWindowFlags windowsFlags =
@@ -236,15 +306,18 @@ int main(int, char**)
 					std::swap(input_path, output_path);
 					std::memset(input_path, 0, sizeof(input_path));
 				}
-				ImGui::SameLine(); ImGui::InputTextWithHint("Import Dir", "file.csv", input_path, sizeof(input_path));
+				ImGui::SameLine(); ImGui::InputTextWithHint("Import Dir", "file.csv or file.kpl", input_path, sizeof(input_path));
 
 				// row 2
 				const char* keyName = glfwGetKeyName(lastKey, 0);
 				snprintf(str, sizeof(str), "Bind to key[%s]", keyName);
 				if (ImGui::Button(str))
 				{
-					skeleton->Save(lastKey);
-					printf("Bind key: %s\n", keyName);
+					bind.mode = (uint32_t)bindMode;
+					bind.repeatMs = (uint16_t)repeatMs;
+					bind.cooldownMs = (uint16_t)cooldownMs;
+					skeleton->Save(lastKey, bind);
+					printf("Bind key: %s (%s)\n", keyName, bindName[bindMode]);
 				}
 				ImGui::SameLine();
 				if (ImGui::Button("Clear"))
@@ -254,77 +327,68 @@ int main(int, char**)
 				if (ImGui::Button(str))
 					skeleton->ClearAll();
 
+				// what the key of the next saved pose does, entering and leaving are relative to the threshold
+				ImGui::Combo("Key action", &bindMode, bindName, BIND_MODE_COUNT);
+				ImGui::SliderFloat("Enter under", &bind.enter, 0.1f, 1.0f, "%.2f x threshold");
+				ImGui::SliderFloat("Leave over", &bind.exit, bind.enter, 2.0f, "%.2f x threshold");
+				if (bindMode == BIND_REPEAT)
+					ImGui::SliderInt("Repeat (ms)", &repeatMs, 30, 2000);
+				ImGui::SliderInt("Cooldown (ms)", &cooldownMs, 0, 3000);
+
+				// saved poses drawn over the body, -1 for none
+				int ghosts[MySkeleton::MAX_GHOSTS];
+				for (int g = 0; g < MySkeleton::MAX_GHOSTS; ++g)
+					ghosts[g] = skeleton->getGhost(g);
+				if (ImGui::InputScalarN("Show poses", ImGuiDataType_S32, ghosts, MySkeleton::MAX_GHOSTS))
+				{
+					for (int g = 0; g < MySkeleton::MAX_GHOSTS; ++g)
+						skeleton->setGhost(g, std::max(-1, std::min(ghosts[g], (int)skeleton->getSavedAmount() - 1)));
+				}
+
+				// row 3, motion gestures
+				MyGestureMatcher& gestures = skeleton->getGestures();
+				if (gestures.getState() == GESTURE_READY)
+				{
+					snprintf(str, sizeof(str), "Bind gesture to key[%s]", keyName);
+					if (ImGui::Button(str))
+						skeleton->SaveGesture(lastKey);
+					ImGui::SameLine();
+					if (ImGui::Button("Discard"))
+						gestures.Discard();
+				}
+				else if (gestures.getState() == GESTURE_IDLE)
+				{
+					if (ImGui::Button("Record Gesture"))
+						gestures.StartRecording();
+				}
+				else
+				{
+					snprintf(str, sizeof(str), "Stop Gesture (%d frames)", gestures.getTakeLength());
+					if (ImGui::Button(str))
+						skeleton->StopGesture();
+				}
+				ImGui::SameLine();
+				snprintf(str, sizeof(str), "Clear Gestures %zu", skeleton->getGestureAmount());
+				if (ImGui::Button(str))
+					skeleton->ClearGestures();
+
+				// how long a pose must be held before it can be bound
+				ImGui::SliderFloat("Hold (ms)", &hold, 100.0f, 3000.0f, "%.0f");
+				skeleton->setHoldTime(hold);
+
 				if (ImGui::CollapsingHeader("Compare by orientation"))
 				{
 					ImGui::SliderFloat("Threshhold", &thresh, 0.0f, 2.0f);
-#if defined(K4A)
-					if (ImGui::BeginTable("split", 4))
-					{
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_PELVIS", &checkList[K4ABT_JOINT_PELVIS]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_SPINE_NAVEL", &checkList[K4ABT_JOINT_SPINE_NAVEL]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_SPINE_CHEST", &checkList[K4ABT_JOINT_SPINE_CHEST]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_NECK", &checkList[K4ABT_JOINT_NECK]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_CLAVICLE_LEFT", &checkList[K4ABT_JOINT_CLAVICLE_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_SHOULDER_LEFT", &checkList[K4ABT_JOINT_SHOULDER_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_ELBOW_LEFT", &checkList[K4ABT_JOINT_ELBOW_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_WRIST_LEFT", &checkList[K4ABT_JOINT_WRIST_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HAND_LEFT", &checkList[K4ABT_JOINT_HAND_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HANDTIP_LEFT", &checkList[K4ABT_JOINT_HANDTIP_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_THUMB_LEFT", &checkList[K4ABT_JOINT_THUMB_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_CLAVICLE_RIGHT", &checkList[K4ABT_JOINT_CLAVICLE_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_SHOULDER_RIGHT", &checkList[K4ABT_JOINT_SHOULDER_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_ELBOW_RIGHT", &checkList[K4ABT_JOINT_ELBOW_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_WRIST_RIGHT", &checkList[K4ABT_JOINT_WRIST_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HAND_RIGHT", &checkList[K4ABT_JOINT_HAND_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HANDTIP_RIGHT", &checkList[K4ABT_JOINT_HANDTIP_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_THUMB_RIGHT", &checkList[K4ABT_JOINT_THUMB_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HIP_LEFT", &checkList[K4ABT_JOINT_HIP_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_KNEE_LEFT", &checkList[K4ABT_JOINT_KNEE_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_ANKLE_LEFT", &checkList[K4ABT_JOINT_ANKLE_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_FOOT_LEFT", &checkList[K4ABT_JOINT_FOOT_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HIP_RIGHT", &checkList[K4ABT_JOINT_HIP_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_KNEE_RIGHT", &checkList[K4ABT_JOINT_KNEE_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_ANKLE_RIGHT", &checkList[K4ABT_JOINT_ANKLE_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_FOOT_RIGHT", &checkList[K4ABT_JOINT_FOOT_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_HEAD", &checkList[K4ABT_JOINT_HEAD]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_NOSE", &checkList[K4ABT_JOINT_NOSE]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_EYE_LEFT", &checkList[K4ABT_JOINT_EYE_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_EAR_LEFT", &checkList[K4ABT_JOINT_EAR_LEFT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_EYE_RIGHT", &checkList[K4ABT_JOINT_EYE_RIGHT]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("K4ABT_JOINT_EAR_RIGHT", &checkList[K4ABT_JOINT_EAR_RIGHT]);
-						ImGui::EndTable();
-			}
-#elif defined(K4W)
 					if (ImGui::BeginTable("split", 4))
 					{
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_SpineBase", &checkList[JointType_SpineBase]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_SpineMid", &checkList[JointType_SpineMid]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_Neck", &checkList[JointType_Neck]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_Head", &checkList[JointType_Head]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ShoulderLeft", &checkList[JointType_ShoulderLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ElbowLeft", &checkList[JointType_ElbowLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_WristLeft", &checkList[JointType_WristLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HandLeft", &checkList[JointType_HandLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ShoulderRight", &checkList[JointType_ShoulderRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ElbowRight", &checkList[JointType_ElbowRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_WristRight", &checkList[JointType_WristRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HandRight", &checkList[JointType_HandRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HipLeft", &checkList[JointType_HipLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_KneeLeft", &checkList[JointType_KneeLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_AnkleLeft", &checkList[JointType_AnkleLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_FootLeft", &checkList[JointType_FootLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HipRight", &checkList[JointType_HipRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_KneeRight", &checkList[JointType_KneeRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_AnkleRight", &checkList[JointType_AnkleRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_FootRight", &checkList[JointType_FootRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_SpineShoulder", &checkList[JointType_SpineShoulder]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HandTipLeft", &checkList[JointType_HandTipLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ThumbLeft", &checkList[JointType_ThumbLeft]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_HandTipRight", &checkList[JointType_HandTipRight]);
-						ImGui::TableNextColumn(); ImGui::Checkbox("JointType_ThumbRight", &checkList[JointType_ThumbRight]);
+						for (int i = 0; i < JOINTS; ++i)
+						{
+							ImGui::TableNextColumn();
+							if (ImGui::Checkbox(active_traits::names[i], &checkList[i]))
+								skeleton->setCheckList(checkList);
+						}
 						ImGui::EndTable();
 					}
-#endif
 		}
 				skeleton->setThresh(thresh);
 
@@ -333,16 +397,120 @@ int main(int, char**)
 				{
 					skeleton->Export(output_path);
 				}
-				ImGui::SameLine(); ImGui::InputTextWithHint("Export Dir", "file.csv", output_path, sizeof(output_path));
+				ImGui::SameLine(); ImGui::InputTextWithHint("Export Dir", "file.csv or file.kpl", output_path, sizeof(output_path));
 			}
 			else
 			{
 				ImGui::SliderFloat("Threshhold", &thresh, 0.0f, 2.0f);
 				skeleton->setThresh(thresh);
+
+				ImGui::SliderFloat("Gesture Threshhold", &gestureThresh, 0.0f, 1.0f);
+				skeleton->setGestureThresh(gestureThresh);
+
+				// how much of the DTW work the lower bounds saved
+				const MyGestureMatcher::stats gs = skeleton->getGestures().getStats();
+				const double windows = gs.windows ? (double)gs.windows : 1.0;
+				ImGui::Text("Gesture windows %llu: %.1f%% LB_Kim, %.1f%% LB_Keogh, %.1f%% abandoned, %.1f%% full DTW, %llu matches",
+					(unsigned long long)gs.windows, 100.0 * gs.kim / windows, 100.0 * gs.keogh / windows,
+					100.0 * gs.abandoned / windows, 100.0 * gs.full / windows, (unsigned long long)gs.matches);
+			}
+
+			// row
+			MyRecorder& recorder = skeleton->getRecorder();
+			if (!recorder.isRecording())
+			{
+				if (ImGui::Button("Record Session"))
+					recorder.Start(record_path);
+				ImGui::SameLine(); ImGui::InputTextWithHint("Session File", "session.ktr", record_path, sizeof(record_path));
+			}
+			else
+			{
+				if (ImGui::Button("Stop Recording"))
+					recorder.Stop();
+				ImGui::SameLine(); ImGui::Text("%llu frames, %.1f MB, %llu dropped",
+					(unsigned long long)recorder.getWritten(), recorder.getBytes() / (1024.0 * 1024.0), (unsigned long long)recorder.getDropped());
+			}
+
+			// row
+			MySharedRing& shared = skeleton->getShared();
+			if (!shared.isPublishing())
+			{
+				if (ImGui::Button("Share Frames"))
+					shared.Start();
+			}
+			else
+			{
+				if (ImGui::Button("Stop Sharing"))
+					shared.Stop();
+				ImGui::SameLine(); ImGui::Text("%llu frames published, %d readers, slowest %llu frames behind",
+					(unsigned long long)shared.getPublished(), shared.getReaders(), (unsigned long long)shared.getReaderLag());
+			}
+
+			// row
+			MyNetPublisher& network = skeleton->getNetwork();
+			if (!network.isRunning())
+			{
+				if (ImGui::Button("Stream"))
+					network.Start(subscribers);
+				ImGui::SameLine(); ImGui::InputTextWithHint("Subscribers", "host:port,host:port", subscribers, sizeof(subscribers));
+			}
+			else
+			{
+				if (ImGui::Button("Stop Streaming"))
+					network.Stop();
+				ImGui::SameLine(); ImGui::Text("%d subscribers, %llu frames in %llu datagrams, %.1f MB, %llu dropped",
+					network.getSubscribers(), (unsigned long long)network.getSentFrames(), (unsigned long long)network.getDatagrams(),
+					network.getBytes() / (1024.0 * 1024.0), (unsigned long long)network.getDroppedFrames());
+			}
+
+			// row
+			if (replay)
+			{
+				static bool realtime = replay->isRealtime();
+				static bool loop = replay->isLoop();
+				float position = replay->getPosition() / 1000000.0f;
+				if (ImGui::SliderFloat("Replay", &position, 0.0f, replay->getDuration() / 1000000.0f, "%.1f s"))
+					replay->Seek((uint64_t)(position * 1000000.0f));
+				if (ImGui::Checkbox("Real time", &realtime))
+					replay->setRealtime(realtime);
+				ImGui::SameLine();
+				if (ImGui::Checkbox("Loop", &loop))
+					replay->setLoop(loop);
+				ImGui::SameLine(); ImGui::Text("%llu frames played, %u loops%s",
+					(unsigned long long)replay->getPlayed(), replay->getLoops(), skeleton->isRunning() ? "" : ", finished");
 			}
 
 			// row 
 			ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+			ImGui::Text("Capture loop heap allocations: %llu", (unsigned long long)skeleton->getCaptureAllocations());
+			ImGui::Text("Joints evaluated of %d enabled: %.1f per library block, %.1f per held pose comparison",
+				skeleton->getEnabledJoints(), skeleton->getLibraryJoints(), skeleton->getCompareJoints());
+			ImGui::Text("Processed %llu frames, %.1f us/frame average, %.1f us slowest",
+				(unsigned long long)skeleton->getProcessedFrames(), skeleton->getAverageProcessTime(), skeleton->getMaxProcessTime());
+			ImGui::Text("Bodies tracked: %d, matched on %d threads", skeleton->getTrackedBodies(), skeleton->getWorkers());
+			bool dropOldest = skeleton->getDropPolicy() == DROP_OLDEST;
+			if (ImGui::Checkbox("Drop oldest frame when matching falls behind", &dropOldest))
+				skeleton->setDropPolicy(dropOldest ? DROP_OLDEST : DROP_NEWEST);
+			ImGui::SameLine(); ImGui::Text("%zu queued, %llu dropped", skeleton->getQueuedFrames(), (unsigned long long)skeleton->getDroppedFrames());
+
+			const char* sink = skeleton->getKeySink();
+			ImGui::Text("Keys sent through %s: %llu, %llu failed, %llu dropped, %zu queued (%zu at most)", sink ? sink : "nothing",
+				(unsigned long long)skeleton->getSentKeys(), (unsigned long long)skeleton->getFailedKeys(),
+				(unsigned long long)skeleton->getDroppedKeys(), skeleton->getQueuedKeys(), skeleton->getMaxQueuedKeys());
+
+			// latency per stage in us, from the moment the capture loop got the frame
+			ImGui::Text("Latency (us)   count      p50      p99      max");
+			for (int stage = 0; stage < LATENCY_COUNT; ++stage)
+			{
+				const MyLatencyHistogram& latency = skeleton->getLatency(stage);
+				ImGui::Text("%-8s %10llu %8.1f %8.1f %8.1f", MySkeleton::getLatencyName(stage), (unsigned long long)latency.getCount(),
+					latency.Percentile(50.0) / 1000.0, latency.Percentile(99.0) / 1000.0, latency.getMax() / 1000.0);
+			}
+			if (ImGui::Button("Reset latency"))
+				skeleton->ResetLatency();
+			ImGui::SameLine();
+			if (ImGui::Button("Export latency"))
+				skeleton->ExportLatency("latency.csv");
 			ImGui::End();
 
 			//ImGui::ShowDemoWindow();
@@ -374,13 +542,13 @@ int main(int, char**)
 
 		// - send mvp matrix
 		glUniformMatrix4fv(
-			glGetUniformLocation(shaderProgram, "uProj"),
+			uProj,
 			1,
 			GL_FALSE,
 			glm::value_ptr(projMatrix)
 		);
 		glUniformMatrix4fv(
-			glGetUniformLocation(shaderProgram, "uView"),
+			uView,
 			1,
 			GL_FALSE,
 			glm::value_ptr(viewMatrix)
@@ -417,6 +585,8 @@ int main(int, char**)
 
 	skeleton->Stop();
 	delete skeleton;
+	delete replay;
+	delete synthetic;
 
 	return 0;
 }
\ No newline at end of file